@@ -12,12 +12,14 @@ CONFFLAGS = -DKLH10_CPU_KLX=1	\
 		    -DKLH10_DEV_DPNI20=1 \
 		    -DKLH10_DEV_DPTM03=1 \
 		    -DKLH10_DEV_DPRPXX=1 \
+		    -DKLH10_DEV_DPTHREADS=1 \
 	    -DKLH10_MEM_SHARED=1	\
 	    -DKLH10_RTIME_OSGET=1	\
 	    -DKLH10_ITIME_INTRP=1	\
 	    -DKLH10_CTYIO_INT=1	\
 	    -DKLH10_APRID_SERIALNO=3600 \
 	    -DKLH10_CLIENT=\"MyKL\"
+LIBS += -lpthread
 
 all base-kl:	kn10-kl DPROCS_KL ALL_UTILS
 
@@ -34,7 +36,7 @@ OFILES_KL = klh10.o prmstr.o fecmd.o feload.o wfio.o osdsup.o \
 	infix.o  inflt.o  inbyte.o injrst.o \
 	inexts.o inio.o   kn10dev.o 	\
 	dvcty.o  dvdte.o	\
-	vdisk.o  dvrpxx.o dvrh20.o	\
+	vdisk.o  dvrpxx.o dprpxxth.o dvrh20.o	\
 	vmtape.o dvtm03.o	\
 	dvni20.o dpsup.o	\
 	dvhost.o dvlites.o
@@ -11,6 +11,7 @@ CONFFLAGS = -DKLH10_CPU_KS=1	\
 	    -DKLH10_EVHS_INT=1	\
 		    -DKLH10_DEV_DPTM03=1 \
 		    -DKLH10_DEV_DPRPXX=1 \
+		    -DKLH10_DEV_DPTHREADS=1 \
 		    -DKLH10_DEV_DPIMP=1 \
 	    -DKLH10_SIMP=0 \
 	    -DKLH10_MEM_SHARED=1 \
@@ -19,6 +20,7 @@ CONFFLAGS = -DKLH10_CPU_KS=1	\
 	    -DKLH10_APRID_SERIALNO=4097 \
 	    -DKLH10_CLIENT=\"MyITS\" \
 	    -DVMTAPE_ITSDUMP=1
+LIBS += -lpthread
 
 all base-ks-its:	kn10-ks-its DPROCS_KSITS ALL_UTILS
 
@@ -35,7 +37,7 @@ OFILES_KS = klh10.o prmstr.o fecmd.o feload.o wfio.o osdsup.o \
 	infix.o  inflt.o  inbyte.o injrst.o \
 	inexts.o inio.o   kn10dev.o dvuba.o  \
 	dvcty.o  			\
-	vdisk.o  dvrpxx.o dvrh11.o	\
+	vdisk.o  dvrpxx.o dprpxxth.o dvrh11.o	\
 	vmtape.o dvtm03.o	\
 	dvlhdh.o dvdz11.o dvch11.o \
 	dpsup.o \
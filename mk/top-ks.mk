@@ -11,11 +11,13 @@ CONFFLAGS = -DKLH10_CPU_KS=1	\
 	    -DKLH10_EVHS_INT=1	\
 		    -DKLH10_DEV_DPTM03=1 \
 		    -DKLH10_DEV_DPRPXX=1 \
+		    -DKLH10_DEV_DPTHREADS=1 \
 	    -DKLH10_MEM_SHARED=1 \
 	    $(TINTFLAGS) \
 	    $(DINTFLAGS) \
 	    -DKLH10_APRID_SERIALNO=4097 \
 	    -DKLH10_CLIENT=\"MyKS\"
+LIBS += -lpthread
 
 all base-ks:	kn10-ks DPROCS_KS ALL_UTILS
 
@@ -32,7 +34,7 @@ OFILES_KS = klh10.o prmstr.o fecmd.o feload.o wfio.o osdsup.o \
 	infix.o  inflt.o  inbyte.o injrst.o \
 	inexts.o inio.o   kn10dev.o dvuba.o  \
 	dvcty.o  			\
-	vdisk.o  dvrpxx.o dvrh11.o	\
+	vdisk.o  dvrpxx.o dprpxxth.o dvrh11.o	\
 	vmtape.o dvtm03.o	\
 	dvlhdh.o dvdz11.o dvch11.o \
 	dpsup.o \
@@ -381,12 +381,18 @@ dpchaos: dpchaos.o dpsup.o
 #
 dprpxx.o: $(SRC)/dprpxx.c $(SRC)/dprpxx.h $(SRC)/dpsup.h $(SRC)/vdisk.c \
 	    $(SRC)/klh10.h $(SRC)/rcsid.h $(SRC)/cenv.h $(SRC)/word10.h  \
-	    $(SRC)/osdsup.h $(SRC)/vdisk.h $(BLDSRC)/config.h
+	    $(SRC)/osdsup.h $(SRC)/vdisk.h $(SRC)/wfio.h $(BLDSRC)/config.h
 	$(BUILDMOD) $(SRC)/dprpxx.c
 
 dprpxx: dprpxx.o dpsup.o
 	$(LINKER) $(LDFLAGS) $(LDOUTF) dprpxx dprpxx.o dpsup.o $(LIBS)
 
+# Same, compiled as a module of the KLH10 to run as a DP thread
+dprpxxth.o: $(SRC)/dprpxx.c $(SRC)/dprpxx.h $(SRC)/dpsup.h \
+	    $(SRC)/klh10.h $(SRC)/rcsid.h $(SRC)/cenv.h $(SRC)/word10.h  \
+	    $(SRC)/osdsup.h $(SRC)/vdisk.h $(SRC)/wfio.h $(BLDSRC)/config.h
+	$(BUILDMOD) -DDPRPXX_THREAD=1 $(LDOUTF) dprpxxth.o $(SRC)/dprpxx.c
+
 
 # --------- TM03 tape drive subprocess
 #
@@ -444,7 +450,8 @@ tapedd: tapedd.o wfio.o prmstr.o
 
 ## VDKFMT - Virtual Disk Format & copy
 ##
-vdkfmt.o: $(SRC)/vdkfmt.c $(SRC)/vdisk.c $(SRC)/vdisk.h $(BLDSRC)/config.h
+vdkfmt.o: $(SRC)/vdkfmt.c $(SRC)/vdisk.c $(SRC)/vdisk.h $(SRC)/wfio.h \
+	    $(BLDSRC)/config.h
 	$(CC) $(CFLAGS) $(CPPFLAGS) $(CENVFLAGS) $(SRC)/vdkfmt.c
 
 vdkfmt: vdkfmt.o
@@ -615,7 +622,7 @@ osdsup.o: $(SRC)/osdsup.c $(SRC)/osdsup.h \
 prmstr.o: $(SRC)/prmstr.c $(SRC)/prmstr.h $(BLDSRC)/config.h
 	$(BUILDMOD) $(SRC)/prmstr.c
 
-vdisk.o: $(SRC)/vdisk.c $(SRC)/vdisk.h $(BLDSRC)/config.h
+vdisk.o: $(SRC)/vdisk.c $(SRC)/vdisk.h $(SRC)/wfio.h $(BLDSRC)/config.h
 	$(BUILDMOD) $(SRC)/vdisk.c
 
 vmtape.o: $(SRC)/vmtape.c $(SRC)/vmtape.h $(BLDSRC)/config.h
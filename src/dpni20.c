@@ -191,6 +191,7 @@ struct ether_addr ihost_ea;	/* Native host ether addr for selected ifc */
 
 int nmcats = 0;
 unsigned char ethmcat[DPNI_MCAT_SIZ][6]; /* Table of known MCAT addresses */
+unsigned char ethbcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
 
 
 /* Local predeclarations */
@@ -202,6 +203,10 @@ void net_init(struct dpni20_s *dpni);
 void eth_mcatset(struct dpni20_s *dpni);
 void eth_adrset(struct dpni20_s *dpni);
 void dumppkt(unsigned char *ucp, int cnt);
+#if KLH10_NET_PCAP || KLH10_NET_LNXBPF
+struct bpf_program *pfbuild(void *arg, struct in_addr *ipa);
+void pf_refilter(struct dpni20_s *dpni);
+#endif
 int arp_myreply(unsigned char *buf, int cnt, struct dpx_s *dpx);
 
 /* Error and diagnostic output */
@@ -515,10 +520,24 @@ void net_init(struct dpni20_s *dpni)
        the packetfilter open may use and/or change it.
     */
     ea_set(&npf.osnpf_ea, dpni->dpni_eth);	/* Set requested ea if any */
+    dpni->dpni_mcfilt = FALSE;			/* No MCAT from 10 yet */
     osn_pfinit(&pfdata, &npf, (void *)dpni);	/* Will abort if fails */
     ea_set(&ihost_ea, &npf.osnpf_ea);		/* Copy actual ea */
     tun_ip = npf.osnpf_tun.ia_addr;		/* Get actual tunnel addr */
 
+#if KLH10_NET_LNXBPF
+    /* A Linux tap device can run the same filter program in the kernel.
+    ** If that works, lnx_filter() is no longer needed.
+    */
+    if (!dpni->dpni_dedic && !pfdata.pf_can_filter
+      && (pfdata.pf_meth == PF_METH_TAP)
+      && osn_pfsetfilter(&pfdata, pfbuild((void *)dpni, &ehost_ip))) {
+	pfdata.pf_can_filter = TRUE;
+	if (DBGFLG)
+	    dbprint("Tap kernel filter set");
+    }
+#endif
+
 
     /* Now set any return info values in shared struct.
     */
@@ -547,7 +566,7 @@ void net_init(struct dpni20_s *dpni)
 
 /* BPF packetfilter initialization */
 
-#if KLH10_NET_PCAP
+#if KLH10_NET_PCAP || KLH10_NET_LNXBPF
 
 /*
 ** BPF filter program stuff.
@@ -564,7 +583,7 @@ void net_init(struct dpni20_s *dpni)
 */
 
 
-#define BPF_PFMAX 50		/* Max instructions in BPF filter */
+#define BPF_PFMAX (32+5*(1+DPNI_MCAT_SIZ)) /* Max instructions in BPF filter */
 struct bpf_insn    bpf_pftab[BPF_PFMAX];
 struct bpf_program bpf_pfilter = { 0,
 				   bpf_pftab };
@@ -621,6 +640,7 @@ struct bpf_insn bpf_jump(unsigned short code, bpf_u_int32 k,
 #define BPFI_RETWIN()  BPFI_RET((u_int)-1)		/* Success return */
 
 static void pfshow(struct bpf_program *);
+static struct bpf_insn *pfeadr(struct bpf_insn *, unsigned char *);
 
 struct bpf_program *
 pfbuild(void *arg, struct in_addr *ipa)
@@ -631,10 +651,26 @@ pfbuild(void *arg, struct in_addr *ipa)
 
     p = pfp->bf_insns;		/* Point to 1st instruction in BPF program  */
 
-    /* First check for broadcast/multicast bit in dest address */
+    /* First check for broadcast/multicast bit in dest address.
+    ** Once the 10 has loaded its multicast table, only broadcasts and
+    ** the multicasts in it are passed, as the NI20 would; until then,
+    ** all of them.
+    */
     *p++ = BPFI_LDB(PKBOFF_EDEST);	/* Get 1st byte of dest ether addr */
-    *p++ = BPFI_TDNE(01);		/* Skip if bit is zero */
-    *p++ = BPFI_RETWIN();		/* Bit set, succeed immediately! */
+    if (!dpni->dpni_mcfilt) {
+	*p++ = BPFI_TDNE(01);		/* Skip if bit is zero */
+	*p++ = BPFI_RETWIN();		/* Bit set, succeed immediately! */
+    } else {
+	int i, n;
+
+	if ((n = dpni->dpni_nmcats) > DPNI_MCAT_SIZ)
+	    n = DPNI_MCAT_SIZ;
+	*p++ = BPFI_JDZ(01, 5*(1+n)+1);	/* Skip checks if bit is zero */
+	p = pfeadr(p, ethbcast);	/* Win if broadcast */
+	for (i = 0; i < n; ++i)
+	    p = pfeadr(p, dpni->dpni_mcat[i]);	/* or in MCAT */
+	*p++ = BPFI_RETFAIL();		/* Other multicast, fail */
+    }
 
     /* Possibly insert check for DECNET protocol types.
     ** Doing this check is inefficient if most of the traffic is IP.
@@ -745,12 +781,37 @@ pfbuild(void *arg, struct in_addr *ipa)
 }
 
 
+/* Add filter instructions that win if the ethernet destination is EA.
+**	Always adds 5 instructions.
+*/
+static struct bpf_insn *
+pfeadr(struct bpf_insn *p, unsigned char *ea)
+{
+    *p++ = BPFI_LD(PKBOFF_EDEST);		/* Get 1st 4 bytes of dest */
+    *p++ = BPFI_JNE(((bpf_u_int32)ea[0] << 24) | (ea[1] << 16)
+			| (ea[2] << 8) | ea[3], 3);	/* No match, skip */
+    *p++ = BPFI_LDH(PKBOFF_EDEST+4);		/* Get last 2 bytes */
+    *p++ = BPFI_JNE((ea[4] << 8) | ea[5], 1);	/* No match, skip */
+    *p++ = BPFI_RETWIN();			/* Matched, win now! */
+    return p;
+}
+
+/* PF_REFILTER - Rebuild the kernel packetfilter and put it into effect,
+**	after something it depends on (the MCAT) has changed.
+*/
+void
+pf_refilter(struct dpni20_s *dpni)
+{
+    if (!osn_pfsetfilter(&pfdata, pfbuild((void *)dpni, &ehost_ip)))
+	error("Couldn't update kernel packetfilter");
+}
+
 /* Debug auxiliary to print out packetfilter we composed.
 */
 static void
 pfshow(struct bpf_program *pf)
 {
-    int i;
+    u_int i;
 
     fprintf(stderr, "[%s: kernel packetfilter pri <>, len %d:\r\n",
 	    progname,
@@ -764,7 +825,7 @@ pfshow(struct bpf_program *pf)
     fprintf(stderr, "]\r\n");
 }
 
-#endif /* KLH10_NET_PCAP */
+#endif /* KLH10_NET_PCAP || KLH10_NET_LNXBPF */
 
 /* LNX packetfilter initialization */
 
@@ -801,9 +862,22 @@ int lnx_filter(struct dpni20_s *dpni,
     unsigned short *sp = (unsigned short *)bp;
     unsigned short etyp;
 
-    /* First check for broadcast/multicast bit in dest address */
-    if (bp[PKBOFF_EDEST] & 01)
-        return TRUE;		/* Bit set, succeed immediately! */
+    /* First check for broadcast/multicast bit in dest address.
+       If the 10 has loaded its MCAT, it must be broadcast or in that.
+     */
+    if (bp[PKBOFF_EDEST] & 01) {
+	int i, n;
+
+	if (!dpni->dpni_mcfilt
+	  || ea_cmp(bp + PKBOFF_EDEST, ethbcast) == 0)
+	    return TRUE;	/* Succeed immediately! */
+	if ((n = dpni->dpni_nmcats) > DPNI_MCAT_SIZ)
+	    n = DPNI_MCAT_SIZ;
+	for (i = 0; i < n; ++i)
+	    if (ea_cmp(bp + PKBOFF_EDEST, dpni->dpni_mcat[i]) == 0)
+		return TRUE;
+	return FALSE;
+    }
 
     /* Now get ethernet protocol type for further checking.
        Could also test packet length, but for now assume higher level
@@ -948,6 +1022,18 @@ void eth_adrset(struct dpni20_s *dpni)
 
 void eth_mcatset(struct dpni20_s *dpni)
 {
+    /* Packet filtering now knows which multicasts the 10 wants.
+    ** Update the kernel's filter, if it has one.  Only PCAP and TAP
+    ** have one; TUN sets pf_can_filter because it only ever delivers
+    ** IP packets for us, not because it runs a filter.
+    */
+    dpni->dpni_mcfilt = TRUE;
+#if KLH10_NET_PCAP || KLH10_NET_LNXBPF
+    if (!dpni->dpni_dedic && pfdata.pf_can_filter
+      && (pfdata.pf_meth == PF_METH_PCAP || pfdata.pf_meth == PF_METH_TAP))
+	pf_refilter(dpni);
+#endif
+
 #if OSN_USE_IPONLY
     dbprintln("\"%s\" multicast table ignored - IP-only interface",
 		  dpni->dpni_ifnam);
@@ -1181,21 +1267,27 @@ int arp_myreply(unsigned char *buf, int cnt, struct dpx_s *dpx)
 /* ETHTOTEN - Main loop for thread pumping packets from Ethernet to 10.
 **	Reads packets from packetfilter and relays them to 10 using DPC
 **	mechanism.
+**	If the DPC buffer has room for more than one packet, any further
+**	packets already waiting after the first are picked up without
+**	blocking and handed over in the same DPNI_RPKTS message, so that a
+**	burst costs the 10 one handoff instead of one per packet.
 */
 
-#define MAXETHERLEN 1600	/* Actually 1519 but be generous */
+#define MAXETHERLEN DPNI_PKTSIZ	/* Actually 1519 but be generous */
 
 void ethtoten(struct dpni20_s *dpni)
 {
     struct dpx_s *dpx;
     int cnt;
-    unsigned char *buff;
-    size_t max;
+    unsigned char *buff, *bp;
+    size_t max, tot;
     int cmin = sizeof(struct ether_header);
     int stoploop = 50;
+    int batch, npkts, nreads;
 
     dpx = dp_dpxfr(&dp);		/* Get ptr to from-DP comm rgn */
     buff = dp_xsbuff(dpx, &max);	/* Set up buffer ptr & max count */
+    batch = (DPNI_RBATCH > 1) && (max >= 2*(MAXETHERLEN+2));
 
     /* Tell KLH10 we're initialized and ready by sending initial packet */
     dp_xswait(dpx);			/* Wait until buff free, in case */
@@ -1204,7 +1296,7 @@ void ethtoten(struct dpni20_s *dpni)
     if (DBGFLG)
 	dbprintln("sent INIT");
 
-    /* Standard algorithm, one packet per read call */
+    /* Standard algorithm, one blocking read per message */
     for (;;) {
 	/* Make sure that buffer is free before clobbering it */
 	dp_xswait(dpx);			/* Wait until buff free */
@@ -1212,8 +1304,11 @@ void ethtoten(struct dpni20_s *dpni)
 	if (DBGFLG)
 	    dbprintln("InWait");
 
-	/* OK, now do a blocking read on packetfilter input! */
-	cnt = osn_pfread(&pfdata, buff, max);
+	/* OK, now do a blocking read on packetfilter input!
+	** If batching, leave room for the first record's count.
+	*/
+	bp = batch ? buff+2 : buff;
+	cnt = osn_pfread(&pfdata, bp, max - (bp - buff));
 
 	if (cnt <= cmin) {		/* Must get enough for ether header */
 
@@ -1242,7 +1337,7 @@ void ethtoten(struct dpni20_s *dpni)
 	if (DBGFLG) {
 	    if (DBGFLG & 0x4) {
 		fprintf(stderr, "\r\n[%s: Read=%d\r\n", progname, cnt);
-		dumppkt(buff, cnt);
+		dumppkt(bp, cnt);
 		fprintf(stderr, "]");
 	    }
 	    else
@@ -1254,7 +1349,7 @@ void ethtoten(struct dpni20_s *dpni)
 	*/
 	if (!pfdata.pf_can_filter && !dpni->dpni_dedic) {
 	    /* Sharing interface.  Check for IP, DECNET, 802.3 */
-	    if (!lnx_filter(dpni, buff, cnt)) {
+	    if (!lnx_filter(dpni, bp, cnt)) {
 		if (DBGFLG)
 		    dbprint("Dropped");
 		continue;		/* Drop packet, continue reading */
@@ -1263,29 +1358,73 @@ void ethtoten(struct dpni20_s *dpni)
 
 #if 0
 	if (DBGFLG)
-	    if (((struct ether_header *)buff)->ether_type == htons(ETHERTYPE_ARP))
+	    if (((struct ether_header *)bp)->ether_type == htons(ETHERTYPE_ARP))
 		dbprintln("Got ARP");
 #endif
 
-	/* Normal packet, pass to 10 via DPC */
-	dp_xsend(dpx, DPNI_RPKT, cnt);
+	if (!batch) {
+	    /* Normal packet, pass to 10 via DPC */
+	    dp_xsend(dpx, DPNI_RPKT, cnt);
+	    if (DBGFLG)
+		dbprint("sent RPKT");
+	    continue;
+	}
+
+	/* Batching.  Record the first packet, then add any others that
+	** are already waiting, as long as another max-size one would fit.
+	** Bound the reads too, in case most of them get filtered out.
+	*/
+	buff[0] = (cnt >> 8) & 0377;
+	buff[1] = cnt & 0377;
+	tot = 2 + cnt;
+	for (npkts = 1, nreads = 0;
+	     npkts < DPNI_RBATCH && nreads < 2*DPNI_RBATCH
+		&& (max - tot) >= (MAXETHERLEN+2);
+	     ++nreads) {
+	    bp = buff + tot + 2;
+	    cnt = osn_pfreadnb(&pfdata, bp, MAXETHERLEN);
+	    if (cnt <= cmin)		/* Nothing more ready (or junk) */
+		break;
+	    if (DBGFLG) {
+		if (DBGFLG & 0x4) {
+		    fprintf(stderr, "\r\n[%s: Read=%d\r\n", progname, cnt);
+		    dumppkt(bp, cnt);
+		    fprintf(stderr, "]");
+		}
+		else
+		    dbprint("Read=%d", cnt);
+	    }
+	    if (!pfdata.pf_can_filter && !dpni->dpni_dedic
+	      && !lnx_filter(dpni, bp, cnt)) {
+		if (DBGFLG)
+		    dbprint("Dropped");
+		continue;
+	    }
+	    bp[-2] = (cnt >> 8) & 0377;
+	    bp[-1] = cnt & 0377;
+	    tot += 2 + cnt;
+	    ++npkts;
+	}
+	dp_xsend(dpx, DPNI_RPKTS, tot);
 	if (DBGFLG)
-	    dbprint("sent RPKT");
+	    dbprint("sent RPKTS %d", npkts);
     }	/* Infinite loop reading packetfilter input */
 }
-
+
 /* TENTOETH - Main loop for thread pumping packets from 10 to Ethernet.
 **	Reads DPC message from 10 and interprets it; if a regular
 **	data message, sends to ethernet.
+**	A DPNI_SPKTS message holds a batch of packets; each is written
+**	to the net straight out of the shared buffer.
 */
 
 void tentoeth(struct dpni20_s *dpni)
 {
     struct dpx_s *dpx;
     int cnt;
-    unsigned char *buff;
+    unsigned char *buff, *bp;
     size_t max;
-    int rcnt;
+    int rcnt, pcnt;
     int doarpchk;
     int stoploop = 50;
 
@@ -1342,6 +1481,38 @@ void tentoeth(struct dpni20_s *dpni)
 	    }
 	    break;
 
+	case DPNI_SPKTS:		/* Send batch of packets */
+	    rcnt = dp_xrcnt(dpx);
+	    if (DBGFLG)
+		dbprint("SPKTS %d", rcnt);
+	    for (bp = buff; (bp + 2) <= (buff + rcnt); bp += 2 + pcnt) {
+		pcnt = (bp[0] << 8) | bp[1];
+		if ((bp + 2 + pcnt) > (buff + rcnt)) {
+		    dbprintln("Bad SPKTS record %d", pcnt);
+		    break;
+		}
+		if (DBGFLG & 0x2) {
+		    fprintf(stderr, "\r\n[%s: Sending %d\r\n", progname, pcnt);
+		    dumppkt(bp+2, pcnt);
+		    fprintf(stderr, "]");
+		}
+		if (doarpchk			/* If must check ARPs */
+		  && arp_reqcheck(bp+2, pcnt)	/* and this is an ARP req */
+		  && arp_myreply(bp+2, pcnt, dpx)) /* and it fits, & is hacked */
+		    continue;			/* then drop this req pkt */
+
+		while ((cnt = osn_pfwrite(&pfdata, bp+2, pcnt)) != pcnt) {
+		    if ((cnt < 0) && (errno == EINTR))
+			continue;		/* Just try again */
+		    syserr(errno, "PF write %d != %d, errno %d",
+							cnt, pcnt, errno);
+		    if (--stoploop <= 0)
+			efatal(1, "Too many retries, aborting");
+		    break;			/* Give up on this one */
+		}
+	    }
+	    break;
+
 	case DPNI_SETETH:
 	    /* Attempt to change physical ethernet addr */
 	    if (DBGFLG)
@@ -32,9 +32,32 @@
 #define DPNI_MCAT_SIZ 16	/* Size of multicast table */
 #define DPNI_PTT_SIZ  16	/* Size of protocol type table */
 
+/* Packets may be passed several at a time in either direction, in a
+** DPNI_SPKTS or DPNI_RPKTS message.  Its buffer holds one record per
+** packet: a 2-byte count (high byte first) followed by that many bytes
+** of packet.
+*/
+#define DPNI_PKTSIZ	1600	/* Max bytes in one packet (generously) */
+#ifndef DPNI_RBATCH
+# define DPNI_RBATCH	16	/* Max # packets in one DPNI_RPKTS */
+#endif
+#if DPNI_RBATCH > 1		/* Size of DP->10 buffer */
+# define DPNI_RBUFSIZ	(DPNI_RBATCH * (DPNI_PKTSIZ+2))
+#else
+# define DPNI_RBUFSIZ	DPNI_PKTSIZ
+#endif
+#ifndef DPNI_SBATCH
+# define DPNI_SBATCH	16	/* Max # packets in one DPNI_SPKTS */
+#endif
+#if DPNI_SBATCH > 1		/* Size of 10->DP buffer */
+# define DPNI_SBUFSIZ	(DPNI_SBATCH * (DPNI_PKTSIZ+2))
+#else
+# define DPNI_SBUFSIZ	DPNI_PKTSIZ
+#endif
+
 /* Version of DPNI20-specific shared memory structure */
 
-#define DPNI20_VERSION DPC_VERSION(1,1,3)	/* 1.1.3 */
+#define DPNI20_VERSION DPC_VERSION(1,1,4)	/* 1.1.4 */
 #define IFNAM_LEN	PATH_MAX	/* at least IFNAMSIZ! */
 
 /* DPNI20-specific stuff */
@@ -58,6 +81,7 @@ struct dpni20_s {
     unsigned char dpni_rqeth[6];		/* C Requested ethernet addr */
     int dpni_nmcats;				/* C # of MCAT entries */
     unsigned char dpni_mcat[DPNI_MCAT_SIZ][6];	/* C Requested MCAT */
+    int dpni_mcfilt;		/* D TRUE if filtering multicasts by MCAT */
     int dpni_nptts;				/* C # of PTT entries */
     unsigned char dpni_ptt[DPNI_PTT_SIZ][6];	/* C Requested PTT */
 };
@@ -71,11 +95,13 @@ struct dpni20_s {
 #define DPNI_SETMCAT	3	/* Set hardware multicasts from MCAT table */
 #define DPNI_SETPTT	4	/* Set packetfilter using PTT */
 #define DPNI_QUIT   	5	/* Clean up and exit */
+#define DPNI_SPKTS	6	/* Send several data packets to ethernet */
 
 	/* From DP to 10 */
 #define DPNI_INIT	1	/* DP->10 Finished init */
 #define DPNI_RPKT	2	/* DP->10 Received data packet from net */
 #define DPNI_NEWETH	3	/* DP->10 Ethernet Address changed */
+#define DPNI_RPKTS	4	/* DP->10 Received several packets */
 
 
 	/* Feature bits in dpni_doarp */
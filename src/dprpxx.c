@@ -41,11 +41,21 @@ size, and configuration.
 
 #include "klh10.h"	/* For config params */
 
+/* DPRPXX_THREAD is set when this file is compiled a second time as a
+** module of the KLH10 itself, to be run as a DP_XT_THCV thread.
+*/
+#ifndef DPRPXX_THREAD
+# define DPRPXX_THREAD 0
+#endif
+
+#if !DPRPXX_THREAD || (KLH10_DEV_DPRPXX && KLH10_DEV_DPTHREADS)
+
 #include <stdio.h>
 #include <errno.h>
 #include <signal.h>
 #include <stdlib.h>	/* For malloc */
 #include <stdarg.h>
+#include <string.h>
 
 #include "word10.h"
 #include "dpsup.h"		/* General DP defs */
@@ -61,6 +71,32 @@ size, and configuration.
 # include <sys/ioctl.h>
 #endif
 
+/* DPRPXX_AIO - Queued (write-behind) disk writes.  The DP can hand a
+**	write to a separate I/O thread and tell the 10 it is done as soon
+**	as the data has been copied, so the 10 can get on with its next
+**	operation while the host does the write.  Anything else first
+**	waits for the queue to empty.  Only done when running as a thread,
+**	since that is always stopped in a way that lets the queue be
+**	flushed; a DP subprocess is simply killed.
+**	This is off unless the "dpaio" drive parameter asks for it, since
+**	the 10 has already been told a queued write succeeded by the time
+**	it fails; see dpaio_write.
+*/
+#ifndef DPRPXX_AIO
+# define DPRPXX_AIO DPRPXX_THREAD
+#endif
+
+#if DPRPXX_AIO
+# include <pthread.h>
+
+struct dpaio_s {		/* One queued write */
+	uint32 a_daddr;		/* Disk addr (sectors) */
+	int a_nsec;		/* # sectors */
+	w10_t *a_buf;		/* M Copy of data to write */
+	size_t a_bufwds;	/* # words allocated for a_buf */
+};
+#endif
+
 struct devdk {
 	struct dp_s d_dp;	/* Point to shared memory area */
 	struct dprpxx_s *d_rp;	/* Shorthand ptr to DPRPXX struct in area */
@@ -81,7 +117,24 @@ struct devdk {
 	size_t d_blen;		/* Actual buffer length */
 
 	struct vdk_unit d_vdk;	/* Virtual disk info */
-} devdk;
+	int d_wrerr;		/* Error from last devwrite/dmawrite */
+
+#if DPRPXX_AIO
+	int d_aiomax;		/* Max # writes to queue, 0 if none */
+	pthread_t d_aioth;	/* I/O thread doing queued writes */
+	pthread_mutex_t d_aiomtx;	/* Protects the following: */
+	pthread_cond_t d_aiocv;	/*   Broadcast on any change */
+	int d_aiohd;		/*   Index of oldest queued write */
+	int d_aiocnt;		/*   # writes queued (incl one in progress) */
+	int d_aioquit;		/*   TRUE to make I/O thread exit when idle */
+	int d_aioerr;		/*   Error from a queued write, not yet told */
+	struct dpaio_s d_aioq[DPRP_AIOMAX];
+#endif
+};
+
+#if !DPRPXX_THREAD
+struct devdk devdk;	/* Only one per process */
+#endif
 
 
 void rptoten(struct devdk *);
@@ -98,9 +151,23 @@ int devread(struct devdk *);
 int devwrite(struct devdk *);
 int dmaread(struct devdk *);
 int dmawrite(struct devdk *);
+int dmasgl(struct devdk *, int);
 
 void sscattn(struct devdk *d);
 void chkmntreq(struct devdk *d);
+static int dkwrite(struct devdk *d, w10_t *wp, uint32 daddr, int nsec);
+
+#if DPRPXX_THREAD
+static int  dprpxx_run(struct devdk *d, int argc, char **argv);
+static void dprpxx_free(void *arg);
+#endif
+#if DPRPXX_AIO
+static int  dpaio_start(struct devdk *d);
+static void dpaio_stop(void *arg);
+static void dpaio_drain(struct devdk *d);
+static struct dpaio_s *dpaio_room(struct devdk *d, int *errp);
+static int  dpaio_write(struct devdk *d, w10_t *wp, uint32 daddr, int nsec);
+#endif
 
 #if 0
 int os_dkopen(), os_dkread(), os_dkwrite(), os_dkclrerr();
@@ -109,17 +176,19 @@ int os_dkfsr(), os_dkshow();
 
 
 /* For now, include VDISK source directly, so as to avoid compile-time
-** switch conflicts (eg with KLH10).
+** switch conflicts (eg with KLH10).  A thread uses the KLH10's copy.
 */
-#include "vdisk.c"
+#if !DPRPXX_THREAD
+# include "vdisk.c"
+#endif
 
-#define DBGFLG (devdk.d_rp->dprp_dpc.dpc_debug)
+#define DBGFLG (d->d_rp->dprp_dpc.dpc_debug)	/* Needs "d" in scope */
 
 
 /* Low-level support */
 
 
-static void efatal(int num, char *fmt, ...)
+static void efatal(struct devdk *d, int num, char *fmt, ...)
 {
     fprintf(stderr, "\n%s: ", "dprpxx");
     {
@@ -130,10 +199,10 @@ static void efatal(int num, char *fmt, ...)
     }
     putc('\n', stderr);
 
-    dp_exit(&devdk.d_dp, num);
+    dp_exit(&d->d_dp, num);
 }
 
-static void esfatal(int num, char *fmt, ...)
+static void esfatal(struct devdk *d, int num, char *fmt, ...)
 {
     fprintf(stderr, "\n%s: ", "dprpxx");
     {
@@ -144,7 +213,7 @@ static void esfatal(int num, char *fmt, ...)
     }
     fprintf(stderr, " - %s\n", dp_strerror(errno));
 
-    dp_exit(&devdk.d_dp, num);
+    dp_exit(&d->d_dp, num);
 }
 
 static void error(char *fmt, ...)
@@ -170,14 +239,41 @@ static void syserr(int num, char *fmt, ...)
     fprintf(stderr, " - %s\n", dp_strerror(num));
 }
 
+#if DPRPXX_THREAD
+int
+dprpxx_main(int argc, char **argv)
+{
+    struct devdk *d;
+
+    if (!(d = (struct devdk *)calloc(1, sizeof(struct devdk)))) {
+	fprintf(stderr, "[dprpxx: no memory for thread]\r\n");
+	return 0;
+    }
+
+    /* dp_stop cancels this thread.  Only allow that while waiting for
+    ** a command (see tentorp), and on the way out close the disk and
+    ** free our state so a restart doesn't leak them.
+    */
+    (void) pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, (int *)NULL);
+    pthread_cleanup_push(dprpxx_free, (void *)d);
+    (void) dprpxx_run(d, argc, argv);
+    pthread_cleanup_pop(1);
+    return 1;
+}
+
+static int
+dprpxx_run(register struct devdk *d, int argc, char **argv)
+{
+#else
 int
 main(int argc, char **argv)
 {
     register struct devdk *d = &devdk;
+#endif
 
     /* General initialization */
     if (!dp_main(&d->d_dp, argc, argv)) {
-	efatal(1, "DP init failed!");
+	efatal(d, 1, "DP init failed!");
     }
     d->d_rp = (struct dprpxx_s *)d->d_dp.dp_adr;	/* Make refs easier */
 
@@ -187,6 +283,12 @@ main(int argc, char **argv)
 
     /* See if using DMA to 10 memory, and set up if so */
     d->d_10mem = NULL;
+#if DPRPXX_THREAD
+    if (d->d_rp->dprp_dma) {		/* Same address space, easy */
+	d->d_10mem = d->d_rp->dprp_10mem;
+	d->d_10siz = d->d_rp->dprp_10siz;
+    }
+#else
     if (d->d_rp->dprp_dma) {
 	/* Attempt to attach segment into our address space */
 	char *ptr = (char *)shmat(d->d_rp->dprp_shmid, (void *)0, SHM_RND);
@@ -215,6 +317,7 @@ main(int argc, char **argv)
 	    fprintf(stderr, "[dprpxx: Mapped 10 mem, %ld wds]",
 					(long)d->d_10siz);
     }
+#endif
 
     /* Find location and size of record buffer to use */
     d->d_buff = dp_xrbuff(dp_dpxto(&d->d_dp), &d->d_blen);
@@ -223,21 +326,53 @@ main(int argc, char **argv)
     ** For now this is done by DPSUP.
     */
 
+#if !DPRPXX_THREAD	/* Would change them for the KLH10 too! */
     /* Ignore TTY cruft so CTY hacking in 10 doesn't bother us */
     signal(SIGINT, SIG_IGN);	/* Ignore TTY cruft */
     signal(SIGQUIT, SIG_IGN);
+#endif
 
     /* Open disk drive initially specified, if one; initialize stuff */
     d->d_state = DPRPXX_STA_OFF;
 
     /* Initialize VDK code */
     if (!vdk_init(&(d->d_vdk), NULLPROC, (char *)NULL))
-	return 0;
+	efatal(d, 1, "VDK init failed!");
+
+#if DPRPXX_AIO
+    /* Start I/O thread for queued writes, if wanted.  The cleanup
+    ** handler lets it finish the queue when this thread is stopped.
+    */
+    d->d_aiomax = d->d_rp->dprp_aio;
+    if (d->d_aiomax > DPRP_AIOMAX)
+	d->d_aiomax = DPRP_AIOMAX;
+    if (d->d_aiomax > 0 && !dpaio_start(d))
+	d->d_aiomax = 0;		/* Do all writes directly */
 
+    pthread_cleanup_push(dpaio_stop, (void *)d);
     tentorp(d);			/* Start normal command/response process */
+    pthread_cleanup_pop(1);
+#else
+    tentorp(d);			/* Start normal command/response process */
+#endif
 
     return 1;			/* Never returns, but silence compiler */
 }
+
+#if DPRPXX_THREAD
+/* DPRPXX_FREE - Cleanup handler for the thread, run when it is
+**	cancelled or exits.  Any write-behind thread is already stopped.
+*/
+static void
+dprpxx_free(void *arg)
+{
+    register struct devdk *d = (struct devdk *)arg;
+
+    if (d->d_isdisk)
+	(void) devclose(d);
+    free((char *)d);
+}
+#endif
 
 /* RPTOTEN - Process to handle unexpected events and report them to the 10.
 **	Does nothing for now; later could be responsible for listening
@@ -273,7 +408,7 @@ void rptoten(register struct devdk *d)
 	    fprintf(stderr, "dprpxx: REQPKT read = %d, ", cnt);
 	    if (cnt < 0) {
 		if (--stoploop <= 0)
-		    efatal(1, "Too many retries, aborting");
+		    efatal(d, 1, "Too many retries, aborting");
 		fprintf(stderr, "errno %d = %s\r\n",
 				errno, dp_strerror(errno));
 	    } else if (cnt > 0)
@@ -335,14 +470,28 @@ void tentorp(register struct devdk *d)
     for (;;) {
 
 	/* Wait until 10 has a command for us */
+#if DPRPXX_THREAD
+	(void) pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, (int *)NULL);
+	dp_xrwait(dpx);
+	(void) pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, (int *)NULL);
+#else
 	dp_xrwait(dpx);
+#endif
 
 	/* Reset some stuff for every command */
 	d->d_rp->dprp_err = 0;
 	res = DPRP_RES_SUCC;		/* Default is successful op */
+	cmd = dp_xrcmd(dpx);
+
+#if DPRPXX_AIO
+	/* Only writes can be queued; all else waits for them to finish */
+	if (d->d_aiomax && cmd != DPRP_WRITE && cmd != DPRP_WRDMA
+	  && cmd != DPRP_WRSGL)
+	    dpaio_drain(d);
+#endif
 
 	/* Process command from 10! */
-	switch (cmd = dp_xrcmd(dpx)) {
+	switch (cmd) {
 
 	default:
 	    fprintf(stderr, "[dprpxx: Unknown cmd %o]\r\n", dp_xrcmd(dpx));
@@ -420,10 +569,22 @@ void tentorp(register struct devdk *d)
 	    }
 	    break;
 
+	case DPRP_WRSGL:	/* Write N sectors from mem segments */
+	case DPRP_RDSGL:	/* Read N sectors into mem segments */
+	    if (!dmasgl(d, (cmd == DPRP_WRSGL))) {
+		res = DPRP_RES_FAIL;
+	    }
+	    break;
+
 	}
 #if 0
 	dprpstat(d);		/* Update most status vars */
 #endif
+#if VDK_CACHE
+	d->d_rp->dprp_chits = d->d_vdk.dk_chits;
+	d->d_rp->dprp_cmiss = d->d_vdk.dk_cmiss;
+	d->d_rp->dprp_cwrbk = d->d_vdk.dk_cwrbk;
+#endif
 
 	/* Command done, return result and tell 10 we're done */
 	dp_xrdoack(dpx, res);
@@ -520,6 +681,12 @@ int devmount(register struct devdk *d, char *opath, int wrtf)
     d->d_vdk.dk_ntrks = dprp->dprp_ntrk;
     d->d_vdk.dk_nsecs = dprp->dprp_nsec;
     d->d_vdk.dk_nwds = dprp->dprp_nwds;
+    d->d_vdk.dk_mmap = dprp->dprp_mmap;
+    d->d_vdk.dk_msync = dprp->dprp_msync;
+#if VDK_CACHE
+    d->d_vdk.dk_csize = dprp->dprp_csize;
+    d->d_vdk.dk_cwback = dprp->dprp_cwback;
+#endif
     if (!vdk_mount(&d->d_vdk, path, wrtf)) {
 	fprintf(stderr, "[dprpxx: Cannot mount device \"%s\": %s]\r\n", 
 			    path, dp_strerror(d->d_vdk.dk_err));
@@ -615,14 +782,14 @@ int devwrite(struct devdk *d)
 	    (long)dprp->dprp_daddr, (long)d->d_buff,
 	    (int)(nsec * dprp->dprp_nwds), nsec);
 
-    dprp->dprp_scnt = vdk_write(&d->d_vdk, 
+    dprp->dprp_scnt = dkwrite(d,
 	    (w10_t *)d->d_buff,		/* Word buffer loc */
 	    (uint32) dprp->dprp_daddr,	/* Disk addr (sectors) */
 	    nsec);			/* # sectors */
-    if ((dprp->dprp_err = d->d_vdk.dk_err)
+    if ((dprp->dprp_err = d->d_wrerr)
       || (dprp->dprp_scnt != nsec)) {
 	fprintf(stderr, "[dprpxx: write error on %s: %s]\r\n",
-		    d->d_vdk.dk_filename, dp_strerror(d->d_vdk.dk_err));
+		    d->d_vdk.dk_filename, dp_strerror(d->d_wrerr));
 	return FALSE;
     }
     return TRUE;
@@ -718,22 +885,290 @@ int dmawrite(register struct devdk *d)
 		(long)dprp->dprp_daddr, (long)dprp->dprp_phyadr,
 		(int)(nsec * dprp->dprp_nwds), nsec);
 
-    res = vdk_write(&d->d_vdk, 
+    res = dkwrite(d,
 	    d->d_10mem +
 		dprp->dprp_phyadr,	/* Word buffer loc */
 	    (uint32) dprp->dprp_daddr,	/* Disk addr (sectors) */
 	    nsec);			/* # sectors */
 
     dprp->dprp_scnt = res;
-    dprp->dprp_err = d->d_vdk.dk_err;
+    dprp->dprp_err = d->d_wrerr;
 
     if (res == nsec && !dprp->dprp_err)
 	return TRUE;
 
     fprintf(stderr, "[dprpxx: write error on %s: %s]\r\n",
-		    d->d_vdk.dk_filename, dp_strerror(d->d_vdk.dk_err));
+		    d->d_vdk.dk_filename, dp_strerror(d->d_wrerr));
+    return FALSE;
+}
+
+/* Read or write DMA sectors for a scatter-gather list.
+**	The sectors are consecutive on the disk; each segment gets
+**	the next sg_nsec of them.
+*/
+int dmasgl(register struct devdk *d, int wrtf)
+{
+    register struct dprpxx_s *dprp = d->d_rp;
+    register int i;
+    uint32 daddr;
+    int nsec, res, err;
+
+    dprp->dprp_scnt = 0;
+    if (!d->d_isdisk) {
+	dprp->dprp_err = 1;
+	return FALSE;
+    }
+    if (!d->d_10mem || dprp->dprp_nsg <= 0 || dprp->dprp_nsg > DPRP_SGMAX) {
+	fprintf(stderr, "[dprpxx: Bad %s DMA list!]\r\n",
+				(wrtf ? "write" : "read"));
+	dprp->dprp_err = 1;
+	return FALSE;
+    }
+
+    daddr = (uint32) dprp->dprp_daddr;
+    for (i = 0, err = 0; i < dprp->dprp_nsg; ++i) {
+	nsec = dprp->dprp_sgl[i].sg_nsec;
+	if (dprp->dprp_sgl[i].sg_phyadr + ((unsigned long)nsec
+			* dprp->dprp_nwds) > d->d_10siz) {
+	    fprintf(stderr, "[dprpxx: Non-ex phys addr %#lo]\r\n",
+				(long)dprp->dprp_sgl[i].sg_phyadr);
+	    dprp->dprp_err = 1;
+	    return FALSE;
+	}
+	if (DBGFLG)
+	    fprintf(stderr,
+		"[dprpxx: %s daddr=%ld, mem=%#lo, nsec=%d (seg %d)]\r\n",
+		(wrtf ? "write" : "read"), (long)daddr,
+		(long)dprp->dprp_sgl[i].sg_phyadr, nsec, i);
+
+	if (wrtf) {
+	    res = dkwrite(d, d->d_10mem + dprp->dprp_sgl[i].sg_phyadr,
+				daddr, nsec);
+	    err = d->d_wrerr;
+	} else {
+	    res = vdk_read(&d->d_vdk, d->d_10mem + dprp->dprp_sgl[i].sg_phyadr,
+				daddr, nsec);
+	    err = d->d_vdk.dk_err;
+	}
+	dprp->dprp_scnt += res;
+	daddr += res;
+	if (res != nsec && !err)
+	    err = EIO;			/* Short, but no reason given */
+	if (err)
+	    break;
+    }
+    if (!(dprp->dprp_err = err))
+	return TRUE;
+
+    fprintf(stderr, "[dprpxx: %s error on %s: %s]\r\n",
+		    (wrtf ? "write" : "read"),
+		    d->d_vdk.dk_filename, dp_strerror(err));
     return FALSE;
 }
+
+/* DKWRITE - Write sectors for devwrite and dmawrite, queueing the
+**	write if possible.  Returns # sectors written (or queued) like
+**	vdk_write, with any error in d_wrerr rather than the VDK struct,
+**	which may belong to the I/O thread at the moment.
+*/
+static int
+dkwrite(register struct devdk *d,
+	w10_t *wp, uint32 daddr, int nsec)
+{
+    int res;
+
+#if DPRPXX_AIO
+    if (d->d_aiomax > 0 && !d->d_vdk.dk_mmbase)	/* No point if mapped */
+	return dpaio_write(d, wp, daddr, nsec);
+#endif
+    res = vdk_write(&d->d_vdk, wp, daddr, nsec);
+    d->d_wrerr = d->d_vdk.dk_err;
+    return res;
+}
+
+#if DPRPXX_AIO
+
+/* Queued write support.
+**	The DP thread adds writes at the tail of the ring of DPRP_AIOMAX
+**	entries; the I/O thread does them in order from the head, leaving
+**	each entry counted until it is done so that dpaio_drain can wait
+**	for the disk to be completely up to date.  Only the DP thread adds
+**	entries, so it can fill in the free entry at the tail without
+**	holding the lock.
+**	A queued write that fails can no longer be reported on the command
+**	that asked for it, which has already been acknowledged.  The best
+**	that can be done is to log which transfer was lost, refuse the
+**	next write so the 10 sees an error, and stop queueing so that any
+**	further errors are reported on the command that caused them.
+*/
+
+static void
+dpaio_unlock(void *arg)		/* Cleanup if cancelled in a wait */
+{
+    pthread_mutex_unlock((pthread_mutex_t *)arg);
+}
+
+static void *
+dpaio_thread(void *arg)
+{
+    register struct devdk *d = (struct devdk *)arg;
+    register struct dpaio_s *a;
+    int res;
+
+    pthread_mutex_lock(&d->d_aiomtx);
+    for (;;) {
+	while (d->d_aiocnt == 0 && !d->d_aioquit)
+	    pthread_cond_wait(&d->d_aiocv, &d->d_aiomtx);
+	if (d->d_aiocnt == 0)
+	    break;			/* Quitting and nothing left to do */
+	a = &d->d_aioq[d->d_aiohd];
+	pthread_mutex_unlock(&d->d_aiomtx);
+
+	res = vdk_write(&d->d_vdk, a->a_buf, a->a_daddr, a->a_nsec);
+
+	pthread_mutex_lock(&d->d_aiomtx);
+	if (res != a->a_nsec) {
+	    fprintf(stderr,
+		"[dprpxx: queued write error on %s, daddr=%ld nsec=%d: %s]\r\n",
+		    d->d_vdk.dk_filename, (long)a->a_daddr, a->a_nsec,
+		    dp_strerror(d->d_vdk.dk_err));
+	    if (!d->d_aioerr)
+		d->d_aioerr = d->d_vdk.dk_err ? d->d_vdk.dk_err : EIO;
+	}
+	d->d_aiohd = (d->d_aiohd + 1) % DPRP_AIOMAX;
+	d->d_aiocnt--;
+	pthread_cond_broadcast(&d->d_aiocv);
+    }
+    pthread_mutex_unlock(&d->d_aiomtx);
+    return NULL;
+}
+
+static int
+dpaio_start(register struct devdk *d)
+{
+    int err;
+
+    d->d_aiohd = d->d_aiocnt = 0;
+    d->d_aioquit = FALSE;
+    d->d_aioerr = 0;
+    if (pthread_mutex_init(&d->d_aiomtx, NULL)
+      || pthread_cond_init(&d->d_aiocv, NULL)) {
+	fprintf(stderr, "[dprpxx: Cannot init write queue]\r\n");
+	return FALSE;
+    }
+    if ((err = pthread_create(&d->d_aioth, NULL, dpaio_thread, (void *)d))) {
+	fprintf(stderr, "[dprpxx: Cannot start I/O thread - %s]\r\n",
+			dp_strerror(err));
+	pthread_mutex_destroy(&d->d_aiomtx);
+	pthread_cond_destroy(&d->d_aiocv);
+	return FALSE;
+    }
+    if (DBGFLG)
+	fprintf(stderr, "[dprpxx: Queueing up to %d writes]", d->d_aiomax);
+    return TRUE;
+}
+
+/* DPAIO_STOP - Let I/O thread finish the queue, then flush it.
+**	Also run as a cleanup handler when the DP thread is stopped.
+*/
+static void
+dpaio_stop(void *arg)
+{
+    register struct devdk *d = (struct devdk *)arg;
+    register int i;
+
+    if (d->d_aiomax <= 0)
+	return;
+    pthread_mutex_lock(&d->d_aiomtx);
+    d->d_aioquit = TRUE;
+    pthread_cond_broadcast(&d->d_aiocv);
+    pthread_mutex_unlock(&d->d_aiomtx);
+    pthread_join(d->d_aioth, (void **)NULL);
+
+    pthread_mutex_destroy(&d->d_aiomtx);
+    pthread_cond_destroy(&d->d_aiocv);
+    for (i = 0; i < DPRP_AIOMAX; ++i) {
+	if (d->d_aioq[i].a_buf) {
+	    free((char *)d->d_aioq[i].a_buf);
+	    d->d_aioq[i].a_buf = NULL;
+	}
+    }
+    d->d_aiomax = 0;
+}
+
+/* DPAIO_DRAIN - Wait until all queued writes are done.
+*/
+static void
+dpaio_drain(register struct devdk *d)
+{
+    pthread_mutex_lock(&d->d_aiomtx);
+    pthread_cleanup_push(dpaio_unlock, (void *)&d->d_aiomtx);
+    while (d->d_aiocnt > 0)
+	pthread_cond_wait(&d->d_aiocv, &d->d_aiomtx);
+    pthread_cleanup_pop(1);
+}
+
+/* DPAIO_ROOM - Wait for a free queue entry and return it, along with
+**	any error from an earlier queued write.
+*/
+static struct dpaio_s *
+dpaio_room(register struct devdk *d, int *errp)
+{
+    register struct dpaio_s *a;
+
+    pthread_mutex_lock(&d->d_aiomtx);
+    pthread_cleanup_push(dpaio_unlock, (void *)&d->d_aiomtx);
+    while (d->d_aiocnt >= d->d_aiomax)
+	pthread_cond_wait(&d->d_aiocv, &d->d_aiomtx);
+    a = &d->d_aioq[(d->d_aiohd + d->d_aiocnt) % DPRP_AIOMAX];
+    *errp = d->d_aioerr;		/* Pick up error from earlier write */
+    d->d_aioerr = 0;
+    pthread_cleanup_pop(1);
+    return a;
+}
+
+/* DPAIO_WRITE - Copy data and queue a write of it, waiting for room
+**	if necessary.
+*/
+static int
+dpaio_write(register struct devdk *d,
+	    w10_t *wp, uint32 daddr, int nsec)
+{
+    register struct dpaio_s *a;
+    size_t nwds = (size_t)nsec * VDK_NWDS(&d->d_vdk);
+    int err;
+
+    a = dpaio_room(d, &err);		/* Get free entry */
+    if ((d->d_wrerr = err)) {		/* Refuse this one to report it */
+	dpaio_stop(d);			/* and do no more queueing */
+	return 0;
+    }
+
+    /* Entry is ours until counted, so set it up without lock */
+    if (a->a_bufwds < nwds) {
+	if (a->a_buf)
+	    free((char *)a->a_buf);
+	a->a_bufwds = 0;
+	if (!(a->a_buf = (w10_t *)malloc(nwds * sizeof(w10_t)))) {
+	    dpaio_drain(d);		/* No memory, do it ourselves */
+	    err = vdk_write(&d->d_vdk, wp, daddr, nsec);
+	    d->d_wrerr = d->d_vdk.dk_err;
+	    return err;
+	}
+	a->a_bufwds = nwds;
+    }
+    memcpy((char *)a->a_buf, (char *)wp, nwds * sizeof(w10_t));
+    a->a_daddr = daddr;
+    a->a_nsec = nsec;
+
+    pthread_mutex_lock(&d->d_aiomtx);
+    d->d_aiocnt++;
+    pthread_cond_broadcast(&d->d_aiocv);
+    pthread_mutex_unlock(&d->d_aiomtx);
+    return nsec;
+}
+
+#endif /* DPRPXX_AIO */
 
 #if 0
 
@@ -869,6 +1304,8 @@ size_t len;
 
 #endif /* 0 */
 
+#if !DPRPXX_THREAD	/* Else the KLH10's OSDSUP versions are used */
+
 /* General-purpose System-level I/O.
 **	It is intended that this level of IO be in some sense the fastest
 **	or most efficient way to interact with the host OS, as opposed to
@@ -1016,3 +1453,74 @@ os_fdwrite(osfd_t fd, char *buf, size_t len, size_t *ares)
     if (ares) *ares = res;
     return TRUE;
 }
+
+/* Positional versions of the above, which do not use or change the
+**	file position, so a transfer is a single call and several threads
+**	may use the same fd.  Otherwise same as os_fdseek then os_fdread
+**	or os_fdwrite.
+*/
+int
+os_fdpread(osfd_t fd,
+	   char *buf,
+	   size_t len, osdaddr_t addr, size_t *ares)
+{
+#if CENV_SYS_UNIX
+    register ssize_t res = pread(fd, buf, len, addr);
+    if (res < 0) {
+	if (ares) *ares = 0;
+	return FALSE;
+    }
+    if (ares) *ares = res;
+    return TRUE;
+#else
+    if (!os_fdseek(fd, addr)) {
+	if (ares) *ares = 0;
+	return FALSE;
+    }
+    return os_fdread(fd, buf, len, ares);
+#endif
+}
+
+int
+os_fdpwrite(osfd_t fd,
+	    char *buf,
+	    size_t len, osdaddr_t addr, size_t *ares)
+{
+#if CENV_SYS_UNIX
+    register ssize_t res = pwrite(fd, buf, len, addr);
+    if (res < 0) {
+	if (ares) *ares = 0;
+	return FALSE;
+    }
+    if (ares) *ares = res;
+    return TRUE;
+#else
+    if (!os_fdseek(fd, addr)) {
+	if (ares) *ares = 0;
+	return FALSE;
+    }
+    return os_fdwrite(fd, buf, len, ares);
+#endif
+}
+
+/* Force data written to FD out to the disk itself, as far as the host
+**	allows, so it is known to be there before anything that depends
+**	on it is written.
+*/
+int
+os_fdsync(osfd_t fd)
+{
+#if CENV_SYS_UNIX
+# if defined(_POSIX_SYNCHRONIZED_IO) && (_POSIX_SYNCHRONIZED_IO > 0)
+    return fdatasync(fd) == 0;
+# else
+    return fsync(fd) == 0;
+# endif
+#else
+    return TRUE;
+#endif
+}
+
+#endif /* !DPRPXX_THREAD */
+
+#endif /* !DPRPXX_THREAD || (KLH10_DEV_DPRPXX && KLH10_DEV_DPTHREADS) */
@@ -37,19 +37,35 @@
 # define DPRP_NSECS_MAX 4	/* 4*128 = 512 wds */
 #endif
 
+#ifndef DPRP_AIOMAX		/* Max # writes a DP thread may have queued */
+# define DPRP_AIOMAX 16
+#endif
+
+#ifndef DPRP_SGMAX		/* Max # segments in a scatter-gather xfer */
+# define DPRP_SGMAX 32
+#endif
+
 /* DPRPXX-specific stuff */
 
 struct dprpxx_s {
     struct dpc_s dprp_dpc;	/* Standard DPC portion */
     int dprp_dma;		/* TRUE if want to use DMA */
     int dprp_shmid;		/* SHM ID for 10-memory, if DMA allowed */
+    w10_t *dprp_10mem;		/* 10-memory itself, if DP is a thread */
+    unsigned long dprp_10siz;	/* and its size in words */
     int dprp_debug;		/* TRUE if want subproc debug output */
+    int dprp_aio;		/* Max # writes DP may queue, 0 = none */
 
     int dprp_res;		/* Operation result */
     int dprp_err;		/* Non-zero if error */
     unsigned long dprp_scnt;	/* # sectors xferred */
     unsigned long dprp_daddr;	/* Disk address as # sectors */
     uint32 dprp_phyadr;		/* Memory word address for DMA */
+    int dprp_nsg;		/* # segments in list for RDSGL/WRSGL */
+    struct {
+	uint32 sg_phyadr;	/* Memory word address of segment */
+	int sg_nsec;		/* # sectors there */
+    } dprp_sgl[DPRP_SGMAX];
 
     /* Unused, maybe later */
     int dprp_cyl,	/* Desired cyl */
@@ -58,6 +74,10 @@ struct dprpxx_s {
 
     /* Disk format - set by 10, read by DP */
     int dprp_fmt;
+    int dprp_mmap;		/* TRUE to map RAW pack into memory */
+    int dprp_msync;		/* When to msync it, VDK_MSYNC_xxx */
+    int dprp_csize;		/* # sectors to cache, 0 = none */
+    int dprp_cwback;		/* TRUE to write back cached sectors */
     unsigned long dprp_totsec;
     int dprp_ncyl;
     int dprp_ntrk;
@@ -68,6 +88,11 @@ struct dprpxx_s {
     /* Disk status - set by DP.  Not really used. */
     int dprp_mol;
     int dprp_wrl;
+
+    /* Sector cache statistics - set by DP after each command */
+    unsigned long dprp_chits;	/* # sectors read from cache */
+    unsigned long dprp_cmiss;	/* # sectors read from disk */
+    unsigned long dprp_cwrbk;	/* # dirty sectors written back */
 };
 
 #define DPRP_RES_FAIL 0
@@ -97,8 +122,15 @@ enum {
 	DPRP_RDDCH,	/* Read N words directly to data channel */
 	DPRP_WRDCH,	/* Write N words directly from data channel */
 
-	DPRP_SNS	/* Sense? */
+	DPRP_SNS,	/* Sense? */
+
+	DPRP_RDSGL,	/* Read N sectors directly into scatter-gather list */
+	DPRP_WRSGL	/* Write N sectors directly from scatter-gather list */
 };
 
 
+#if KLH10_DEV_DPTHREADS
+extern int dprpxx_main(int, char **);	/* Entry when run as thread */
+#endif
+
 #endif /* ifndef DPRPXX_INCLUDED */
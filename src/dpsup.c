@@ -49,6 +49,11 @@ static int decosfcclossage;
 
 #include "dpsup.h"
 
+#if DPSUP_EVFD
+# include <sys/eventfd.h>
+# include <fcntl.h>		/* For F_SETFD */
+#endif
+
 #if CENV_SYS_DECOSF || CENV_SYS_SUN || CENV_SYS_SOLARIS || CENV_SYS_XBSD || CENV_SYS_LINUX
 # include <sys/types.h>
 # include <sys/ipc.h>		/* SysV stuff */
@@ -71,6 +76,9 @@ static int decosfcclossage;
 #endif
 
 static int dp_cxinit(struct dpc_s *, int, int, int, size_t, size_t);
+static void dp_cxfree(struct dpx_s *);
+
+#define DPSUP_SPINMIN 16	/* Min polls before a DP blocks on eventfd */
 
 /* DP_INIT - Called from superior (KLH10) to initialize device subprocess
 **	context and shared memory area.
@@ -114,22 +122,40 @@ int dp_init(register struct dp_s *dp, size_t dpcsiz,
 	return FALSE;
     }
 
-    /* Create a shared mem seg.  Set perms to owner-only RW. */
-    if ((shmid = shmget(IPC_PRIVATE, (u_int)totsiz, 0600)) == -1) {
-	fprintf(stderr, "[dp_init: shmget failed - %d]\r\n", errno);
-	return FALSE;
-    }
+#if KLH10_DEV_DPTHREADS
+    if (intyp == DP_XT_THCV || outtyp == DP_XT_THCV) {
+	if (intyp != outtyp) {
+	    fprintf(stderr, "[dp_init: THCV must be used both ways]\r\n");
+	    return FALSE;
+	}
+	/* DP thread shares our address space, so plain memory will do */
+	if (!(dpc = (struct dpc_s *)malloc(totsiz))) {
+	    fprintf(stderr, "[dp_init: malloc failed]\r\n");
+	    return FALSE;
+	}
+	shmid = -1;
+    } else
+#endif
+    {
+	/* Create a shared mem seg.  Set perms to owner-only RW. */
+	if ((shmid = shmget(IPC_PRIVATE, (u_int)totsiz, 0600)) == -1) {
+	    fprintf(stderr, "[dp_init: shmget failed - %d]\r\n", errno);
+	    return FALSE;
+	}
 
-    /* Attempt to attach segment into our address space */
-    dpc = (struct dpc_s *)shmat(shmid, (void *)0, SHM_RND);
-    if (dpc == (struct dpc_s *)-1) {
-	shmctl(shmid, IPC_RMID, (struct shmid_ds *)NULL);
-	fprintf(stderr, "[dp_init: shmat failed - %d]\r\n", errno);
-	return FALSE;
+	/* Attempt to attach segment into our address space */
+	dpc = (struct dpc_s *)shmat(shmid, (void *)0, SHM_RND);
+	if (dpc == (struct dpc_s *)-1) {
+	    shmctl(shmid, IPC_RMID, (struct shmid_ds *)NULL);
+	    fprintf(stderr, "[dp_init: shmat failed - %d]\r\n", errno);
+	    return FALSE;
+	}
     }
 
     /* Won, init the shared DPC struct */
     memset((char *)dpc, 0, totsiz);
+    dpc->dpc_todp.dpx_wakfd = dpc->dpc_todp.dpx_donfd = DPX_DBSIG;
+    dpc->dpc_frdp.dpx_wakfd = dpc->dpc_frdp.dpx_donfd = DPX_DBSIG;
     strncpy(dpc->dpc_magic, DPC_MAGIC, sizeof(dpc->dpc_magic));
     dpc->dpc_fmtver = DPSUP_VERSION;	/* Set to current version */
 
@@ -137,16 +163,25 @@ int dp_init(register struct dp_s *dp, size_t dpcsiz,
     if (!dp_cxinit(dpc, 1, outtyp, outarg, dpcsiz, outsiz)
       || !dp_cxinit(dpc, 0, intyp, inarg, dpcsiz+outsiz, insiz)) {
 
-	shmdt((caddr_t)dpc);		/* Detach attached segment */
-	shmctl(shmid, IPC_RMID, (struct shmid_ds *)NULL);
+	dp_cxfree(&dpc->dpc_todp);	/* Flush any eventfds */
+	dp_cxfree(&dpc->dpc_frdp);
+	if (shmid == -1)
+	    free((char *)dpc);
+	else {
+	    shmdt((caddr_t)dpc);	/* Detach attached segment */
+	    shmctl(shmid, IPC_RMID, (struct shmid_ds *)NULL);
+	}
 	fprintf(stderr, "[dp_init: xinit failed]\r\n");
 	return FALSE;
     }
 
     /* Finally init the DP struct itself */
-    dp->dp_type = DP_XT_MSIG;
+    dp->dp_type = (shmid == -1) ? DP_XT_THCV : DP_XT_MSIG;
     dp->dp_adr = dpc;
     dp->dp_shmid = shmid;
+#if KLH10_DEV_DPTHREADS
+    dp->dp_thact = FALSE;
+#endif
 
     return TRUE;
 }
@@ -155,14 +190,52 @@ static int dp_cxinit(register struct dpc_s *dpc,
 		     int dir, int type, int arg, size_t off, size_t siz)
 {
     register struct dpx_s *dx;
+    int fd = DPX_DBSIG;
 
-    if (type != DP_XT_MSIG)
+    switch (type) {
+    case DP_XT_MSIG:
+    case DP_XT_MSEM:
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+#endif
+	break;
+    default:
 	return FALSE;			/* Unknown xfer type */
+    }
 
-    /* Arg is signal # to use for this direction */
+    /* Arg is signal # to use for this direction.  Still needed for
+    ** MSEM and THCV, since the 10 end of either direction is always
+    ** signalled.
+    */
     if (arg <= 0 || SIGMAX <= arg)
 	return FALSE;			/* Bad signal # */
 
+    if (type == DP_XT_MSEM) {
+#if DPSUP_EVFD
+	/* Make eventfd for the DP end.  Close-on-exec, so that DPs
+	** started later don't inherit it; dp_start clears the flag in
+	** the child for the DP's own pair only.
+	*/
+	if ((fd = eventfd(0, EFD_CLOEXEC)) < 0) {
+	    fprintf(stderr, "[dp_init: eventfd failed, using signals - %s]\r\n",
+			dp_strerror(-1));
+	    type = DP_XT_MSIG;
+	}
+#else
+	type = DP_XT_MSIG;		/* No eventfd, fall back */
+#endif
+    }
+#if KLH10_DEV_DPTHREADS
+    if (type == DP_XT_THCV) {
+	dx = dir ? &dpc->dpc_todp : &dpc->dpc_frdp;
+	if (pthread_mutex_init(&dx->dpx_dbmtx, NULL)
+	  || pthread_cond_init(&dx->dpx_dbcv, NULL))
+	    return FALSE;
+	dx->dpx_th10 = pthread_self();	/* 10 is us, the creator */
+	fd = DPX_DBTHCV;
+    }
+#endif
+
     if (dir) {
 	dx = &dpc->dpc_todp;	/* Output to DP */
 	dx->dpx_dontyp = type;
@@ -182,6 +255,12 @@ static int dp_cxinit(register struct dpc_s *dpc,
 
     dx->dpx_type = type;	/* Is this necessary? */
 
+    /* DP end is R for output, S for input */
+    dx->dpx_wakfd = dir ? fd : DPX_DBSIG;
+    dx->dpx_donfd = dir ? DPX_DBSIG : fd;
+    dx->dpx_wakslp = dx->dpx_donslp = 0;
+    dx->dpx_spin = DPSUP_SPINMIN;
+
     dx->dpx_len = siz;		/* Size of buffer */
     dx->dpx_off = off;		/* Offset of buffer from start of seg */
 
@@ -191,6 +270,21 @@ static int dp_cxinit(register struct dpc_s *dpc,
     return TRUE;
 }
 
+static void dp_cxfree(register struct dpx_s *dx)
+{
+#if KLH10_DEV_DPTHREADS
+    if (dx->dpx_type == DP_XT_THCV) {
+	pthread_mutex_destroy(&dx->dpx_dbmtx);
+	pthread_cond_destroy(&dx->dpx_dbcv);
+    }
+#endif
+    if (dx->dpx_wakfd >= 0)
+	close(dx->dpx_wakfd);
+    if (dx->dpx_donfd >= 0)
+	close(dx->dpx_donfd);
+    dx->dpx_wakfd = dx->dpx_donfd = DPX_DBSIG;
+}
+
 
 int dp_start(register struct dp_s *dp, char *prog)
 {
@@ -229,6 +323,15 @@ int dp_start(register struct dp_s *dp, char *prog)
 	fprintf(stderr, "[dp_start: Forked %d]\r\n", pid);
     if (pid == 0) {
 	/* We're the child process, start up specified program */
+#if DPSUP_EVFD
+	/* Keep this DP's own eventfds across the exec.  Any others,
+	** belonging to other DPs, are close-on-exec.
+	*/
+	if (dp->dp_adr->dpc_todp.dpx_wakfd >= 0)
+	    (void) fcntl(dp->dp_adr->dpc_todp.dpx_wakfd, F_SETFD, 0);
+	if (dp->dp_adr->dpc_frdp.dpx_donfd >= 0)
+	    (void) fcntl(dp->dp_adr->dpc_frdp.dpx_donfd, F_SETFD, 0);
+#endif
 	if (debug) {
 	    fprintf(stderr,
 		    "[dp_start: execing \"%s\" \"%s\" \"-debug\"]\r\n",
@@ -255,6 +358,60 @@ int dp_start(register struct dp_s *dp, char *prog)
 }
 
 
+#if KLH10_DEV_DPTHREADS
+
+/* DP_THSTART - Start a DP as a thread within the KLH10 (DP_XT_THCV),
+**	calling RTN as if it were the DP program's main() with the
+**	same arguments dp_start would give it.  All signals are blocked
+**	in the new thread so that they keep going to the 10.
+*/
+static void *dp_thmain(void *arg)
+{
+    register struct dp_s *dp = (struct dp_s *)arg;
+
+    (void) (*dp->dp_thrtn)((dp->dp_thargv[2] ? 3 : 2), dp->dp_thargv);
+    return NULL;
+}
+
+int dp_thstart(register struct dp_s *dp, char *name,
+	       int (*rtn)(int, char **))
+{
+    int err;
+    sigset_t allmask, oldmask;
+    int debug = (dp->dp_adr ? dp->dp_adr->dpc_debug : 0);
+
+    if (dp->dp_type != DP_XT_THCV || dp->dp_thact) {
+	fprintf(stderr, "[dp_thstart: Not THCV or already running]\r\n");
+	return FALSE;
+    }
+    sprintf(dp->dp_tharg, "-DPT:%p", (void *)dp->dp_adr);
+    dp->dp_thargv[0] = name;
+    dp->dp_thargv[1] = dp->dp_tharg;
+    dp->dp_thargv[2] = debug ? "-debug" : NULL;
+    dp->dp_thargv[3] = NULL;
+    dp->dp_thrtn = rtn;
+
+    sigfillset(&allmask);		/* Leave async signals to the 10 */
+    sigdelset(&allmask, SIGSEGV);	/* but not our own faults */
+    sigdelset(&allmask, SIGBUS);
+    sigdelset(&allmask, SIGFPE);
+    sigdelset(&allmask, SIGILL);
+    (void) pthread_sigmask(SIG_SETMASK, &allmask, &oldmask);
+    err = pthread_create(&dp->dp_thid, NULL, dp_thmain, (void *)dp);
+    (void) pthread_sigmask(SIG_SETMASK, &oldmask, (sigset_t *)NULL);
+    if (err) {
+	fprintf(stderr, "[dp_thstart: Cannot create thread for \"%s\" - %s]\r\n",
+			name, dp_strerror(err));
+	return FALSE;
+    }
+    if (debug)
+	fprintf(stderr, "[dp_thstart: Started \"%s\" thread]\r\n", name);
+    dp->dp_thact = TRUE;
+    return TRUE;
+}
+
+#endif /* KLH10_DEV_DPTHREADS */
+
 int dp_reset(register struct dp_s *dp)
 {
 
@@ -274,6 +431,8 @@ int dp_term(register struct dp_s *dp, int timeout)
 
     /* Try to kill shared mem segment */
     if (dp->dp_type == DP_XT_MSIG) {
+	dp_cxfree(&dp->dp_adr->dpc_todp);	/* Close any eventfds */
+	dp_cxfree(&dp->dp_adr->dpc_frdp);
 	shmdt((caddr_t)(dp->dp_adr));		/* Detach attached segment */
 	shmctl(dp->dp_shmid, IPC_RMID,		/* then try to flush it */
 			(struct shmid_ds *)NULL);
@@ -281,6 +440,15 @@ int dp_term(register struct dp_s *dp, int timeout)
 	dp->dp_shmid = 0;
 	dp->dp_type = 0;
     }
+#if KLH10_DEV_DPTHREADS
+    else if (dp->dp_type == DP_XT_THCV) {
+	dp_cxfree(&dp->dp_adr->dpc_todp);
+	dp_cxfree(&dp->dp_adr->dpc_frdp);
+	free((char *)dp->dp_adr);
+	dp->dp_adr = NULL;
+	dp->dp_type = 0;
+    }
+#endif
     return 1;
 }
 
@@ -326,6 +494,17 @@ int dp_stop(register struct dp_s *dp, int timeout)
 	    dp->dp_adr->dpc_frdp.dpx_donpid = 0;
 	}
 	break;
+
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+	/* Thread only accepts cancellation while waiting for a command */
+	if (dp->dp_thact) {
+	    pthread_cancel(dp->dp_thid);
+	    pthread_join(dp->dp_thid, (void **)NULL);
+	    dp->dp_thact = FALSE;
+	}
+	break;
+#endif
     }
 
     /* Clear up all xfer stuff from this side */
@@ -365,6 +544,32 @@ int dp_main(register struct dp_s *dp, int argc, char **argv)
     int tosig, frsig;
     sigset_t mask;
 
+#if KLH10_DEV_DPTHREADS
+    if ((argc >= 2) && (strncmp(argv[1], "-DPT:", 5) == 0)) {
+	/* Running as a thread in the KLH10; area is already ours */
+	void *ptr;
+
+	dp->dp_type = DP_XT_THCV;	/* So dp_exit only kills thread */
+	dp->dp_shmid = -1;
+	dp->dp_chpid = 0;
+	dp->dp_thact = FALSE;
+	if (1 != sscanf(&argv[1][5], "%p", &ptr)) {
+	    fprintf(stderr, "[%s: Couldn't parse \"%s\"]\r\n",
+				argv[0], argv[1]);
+	    return 0;
+	}
+	dpc = (struct dpc_s *)ptr;
+	if (strncmp(dpc->dpc_magic, DPC_MAGIC, sizeof(dpc->dpc_magic)) != 0
+	  || dpc->dpc_fmtver != DPSUP_VERSION) {
+	    fprintf(stderr, "[%s: Invalid DPT area]\r\n", argv[0]);
+	    return 0;
+	}
+	dp->dp_adr = dpc;
+	dpc->dpc_frdp.dpx_sbuf = (unsigned char *)dpc + dpc->dpc_frdp.dpx_off;
+	dpc->dpc_todp.dpx_rbuf = (unsigned char *)dpc + dpc->dpc_todp.dpx_off;
+	return 1;
+    }
+#endif
     if ((argc < 2) || (strncmp(argv[1], "-DPM:", 5) != 0)) {
 	fprintf(stderr, "[%s: need -DPM: arg]\r\n",
 		(argc > 0 ? argv[0] : "(?) dp_main"));
@@ -502,6 +707,10 @@ int dp_main(register struct dp_s *dp, int argc, char **argv)
 
 void dp_exit(register struct dp_s *dp, int res)
 {
+#if KLH10_DEV_DPTHREADS
+    if (dp->dp_type == DP_XT_THCV)	/* Just this thread, not the 10! */
+	pthread_exit((void *)NULL);
+#endif
     if (dp->dp_chpid) {
 	kill(dp->dp_chpid, SIGKILL);
 	/* Perhaps later wait for that specific child */
@@ -516,9 +725,141 @@ static void dp_subsighan(int junk)
 
 /* Called from both KLH10 and device subprocess */
 
+/* DP_XT_MSEM and DP_XT_THCV doorbells.
+**	The DP end's doorbell (DB, an eventfd or DPX_DBTHCV) is only rung
+**	when that end has said it is asleep on it by setting the flag at
+**	AFLG; the flag store and the check of the other side's state are
+**	fenced so that one of the two always sees the other.  For THCV the
+**	flag is cleared and rechecked under the mutex, so the ring cannot
+**	slip in between the sleeper's last check and its cond wait.
+*/
+#if KLH10_DEV_DPTHREADS
+static void dp_thunlock(void *arg)	/* Cleanup if cancelled in wait */
+{
+    pthread_mutex_unlock((pthread_mutex_t *)arg);
+}
+#endif
+
+static void dp_dbring(register struct dpx_s *dx, int db, volatile int *aflg)
+{
+#if KLH10_DEV_DPTHREADS
+    if (db == DPX_DBTHCV) {
+	pthread_mutex_lock(&dx->dpx_dbmtx);
+	*aflg = 0;
+	pthread_cond_broadcast(&dx->dpx_dbcv);
+	pthread_mutex_unlock(&dx->dpx_dbmtx);
+	return;
+    }
+#endif
+    *aflg = 0;
+#if DPSUP_EVFD
+    (void) eventfd_write(db, (eventfd_t)1);
+#endif
+}
+
+static void dp_dbwait(register struct dpx_s *dx, int db, volatile int *aflg)
+{
+#if KLH10_DEV_DPTHREADS
+    if (db == DPX_DBTHCV) {
+	pthread_mutex_lock(&dx->dpx_dbmtx);
+	pthread_cleanup_push(dp_thunlock, (void *)&dx->dpx_dbmtx);
+	while (*aflg)
+	    pthread_cond_wait(&dx->dpx_dbcv, &dx->dpx_dbmtx);
+	pthread_cleanup_pop(1);
+	return;
+    }
+#endif
+#if DPSUP_EVFD
+    {
+	eventfd_t v;
+	(void) eventfd_read(db, &v);	/* EINTR is just a spurious wakeup */
+    }
+#endif
+}
+
+/* Signal the 10.  A DP thread must aim at the 10's thread, since any
+** other thread in the process could otherwise take the signal.
+*/
+static void dp_sig10(register struct dpx_s *dx, int pid, int sig)
+{
+#if KLH10_DEV_DPTHREADS
+    if (dx->dpx_type == DP_XT_THCV) {
+	pthread_kill(dx->dpx_th10, sig);
+	return;
+    }
+#endif
+    kill(pid, sig);
+}
+
+static void dp_xtmsem_swake(register struct dpx_s *dx)	/* Say msg ready */
+{
+    dx->dpx_rdyf = 1;
+    if (dx->dpx_wakfd == DPX_DBSIG) {	/* R is the 10, must signal */
+	dx->dpx_wakflg = 1;
+	dp_sig10(dx, dx->dpx_wakpid, dx->dpx_waksig);
+	return;
+    }
+    DP_MEMBAR();
+    if (dx->dpx_wakslp)			/* Only ring if R went to sleep */
+	dp_dbring(dx, dx->dpx_wakfd, &dx->dpx_wakslp);
+}
+
+static void dp_xtmsem_rdone(register struct dpx_s *dx)	/* Say msg done */
+{
+    dx->dpx_rdyf = 0;
+    if (dx->dpx_donfd == DPX_DBSIG) {	/* S is the 10, must signal */
+	dx->dpx_donflg = 1;
+	dp_sig10(dx, dx->dpx_donpid, dx->dpx_donsig);
+	return;
+    }
+    DP_MEMBAR();
+    if (dx->dpx_donslp)			/* Only ring if S went to sleep */
+	dp_dbring(dx, dx->dpx_donfd, &dx->dpx_donslp);
+}
+
+/* DP_XTMSEM_BLOCK - Block for a later test of the ready flag (RDY is
+**	the value being waited for).  Polls the flag for a while first,
+**	adapting the limit to whether polling has been paying off, before
+**	announcing that it is asleep and blocking on its doorbell DB.
+**	If DB is the signal this end is the 10, which just waits for it.
+**	Used for THCV as well as MSEM.
+*/
+static void dp_xtmsem_block(register struct dpx_s *dx, int rdy,
+			    int db, volatile int *aslp)
+{
+    register int i;
+
+    if (db == DPX_DBSIG) {
+	dp_sigwait();
+	return;
+    }
+    for (i = dx->dpx_spin; --i >= 0; ) {
+	if ((dx->dpx_rdyf != 0) == rdy) {
+	    if (dx->dpx_spin < DPSUP_SPINMAX)	/* Polling paid off */
+		dx->dpx_spin <<= 1;
+	    return;
+	}
+	DP_CPURELAX();
+    }
+    if (dx->dpx_spin > DPSUP_SPINMIN)		/* Didn't, back off */
+	dx->dpx_spin >>= 1;
+
+    *aslp = 1;
+    DP_MEMBAR();			/* Asleep before final check */
+    if ((dx->dpx_rdyf != 0) == rdy) {
+	*aslp = 0;
+	return;
+    }
+    dp_dbwait(dx, db, aslp);
+}
+
 int dp_xstest(register struct dpx_s *dx)	/* TRUE if can send */
 {
     switch (dx->dpx_type) {
+    case DP_XT_MSEM:
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+#endif
     case DP_XT_MSIG:
 	return dp_xtmsig_stest(dx);
     }
@@ -531,6 +872,12 @@ void dp_xsblock(register struct dpx_s *dx)	/* Block for a later test */
     case DP_XT_MSIG:
 	dp_xtmsig_sblock(dx);
 	return;
+    case DP_XT_MSEM:
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+#endif
+	dp_xtmsem_block(dx, 0, dx->dpx_donfd, &dx->dpx_donslp);
+	return;
     }
     return;
 }
@@ -541,6 +888,13 @@ int dp_xswait(register struct dpx_s *dx)	/* Wait until can send */
     case DP_XT_MSIG:
 	dp_xtmsig_swait(dx);
 	return TRUE;
+    case DP_XT_MSEM:
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+#endif
+	while (!dp_xtmsem_stest(dx))
+	    dp_xtmsem_block(dx, 0, dx->dpx_donfd, &dx->dpx_donslp);
+	return TRUE;
     }
     return FALSE;
 }
@@ -550,6 +904,10 @@ unsigned char *dp_xsbuff(register struct dpx_s *dx,
 			 register size_t *asiz)	/* Get buffer for send data */
 {
     switch (dx->dpx_type) {
+    case DP_XT_MSEM:
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+#endif
     case DP_XT_MSIG:
 	return dp_xtmsig_sbuff(dx, asiz);
     }
@@ -564,6 +922,12 @@ void dp_xswake(register struct dpx_s *dx)	/* Send; say message ready */
     case DP_XT_MSIG:
 	dp_xtmsig_swake(dx);
 	return;
+    case DP_XT_MSEM:
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+#endif
+	dp_xtmsem_swake(dx);
+	return;
     }
 }
 
@@ -574,6 +938,14 @@ void dp_xsend(register struct dpx_s *dx,
     case DP_XT_MSIG:
 	dp_xtmsig_send(dx, cmd, cnt);
 	return;
+    case DP_XT_MSEM:
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+#endif
+	dx->dpx_cmd = cmd;
+	dx->dpx_cnt = cnt;
+	dp_xtmsem_swake(dx);
+	return;
     }
 }
 
@@ -581,6 +953,10 @@ void dp_xsend(register struct dpx_s *dx,
 int dp_xrtest(register struct dpx_s *dx)	/* TRUE if can receive */
 {
     switch (dx->dpx_type) {
+    case DP_XT_MSEM:
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+#endif
     case DP_XT_MSIG:
 	return dp_xtmsig_rtest(dx);
     }
@@ -593,6 +969,12 @@ void dp_xrblock(register struct dpx_s *dx)	/* Block for a later test */
     case DP_XT_MSIG:
 	dp_xtmsig_rblock(dx);
 	return;
+    case DP_XT_MSEM:
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+#endif
+	dp_xtmsem_block(dx, 1, dx->dpx_wakfd, &dx->dpx_wakslp);
+	return;
     }
     return;
 }
@@ -604,6 +986,13 @@ int dp_xrwait(register struct dpx_s *dx) /* Wait until can definitely recv */
     case DP_XT_MSIG:
 	dp_xtmsig_rwait(dx);
 	return TRUE;
+    case DP_XT_MSEM:
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+#endif
+	while (!dp_xtmsem_rtest(dx))
+	    dp_xtmsem_block(dx, 1, dx->dpx_wakfd, &dx->dpx_wakslp);
+	return TRUE;
     }
     return FALSE;
 }
@@ -613,6 +1002,10 @@ unsigned char *dp_xrbuff(register struct dpx_s *dx,
 			 register size_t *asiz)	/* Get buffer for recv data */
 {
     switch (dx->dpx_type) {
+    case DP_XT_MSEM:
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+#endif
     case DP_XT_MSIG:
 	return dp_xtmsig_rbuff(dx, asiz);
     }
@@ -627,6 +1020,12 @@ void dp_xrdone(register struct dpx_s *dx)	/* Done, ready for next msg */
     case DP_XT_MSIG:
 	dp_xtmsig_rdone(dx);
 	return;
+    case DP_XT_MSEM:
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+#endif
+	dp_xtmsem_rdone(dx);
+	return;
     }
 }
 
@@ -637,12 +1036,23 @@ void dp_xrdoack(register struct dpx_s *dx,	/* Done, ready for next msg */
     case DP_XT_MSIG:
 	dp_xtmsig_rdoack(dx, res);
 	return;
+    case DP_XT_MSEM:
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+#endif
+	dx->dpx_res = res;
+	dp_xtmsem_rdone(dx);
+	return;
     }
 }
 
 int dp_xrcmd(register struct dpx_s *dx)		/* Get command */
 {
     switch (dx->dpx_type) {
+    case DP_XT_MSEM:
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+#endif
     case DP_XT_MSIG:
 	return dp_xtmsig_rcmd(dx);
     }
@@ -652,6 +1062,10 @@ int dp_xrcmd(register struct dpx_s *dx)		/* Get command */
 size_t dp_xrcnt(register struct dpx_s *dx)	/* Get data count */
 {
     switch (dx->dpx_type) {
+    case DP_XT_MSEM:
+#if KLH10_DEV_DPTHREADS
+    case DP_XT_THCV:
+#endif
     case DP_XT_MSIG:
 	return dp_xtmsig_rcnt(dx);
     }
@@ -70,7 +70,10 @@ any of:
 	Output always blocks; input is polled.
 	DP reset done directly.
 
-Only one mechanism (DP_XT_MSIG) is actually implemented at present.
+Two variants of (1) are implemented at present: DP_XT_MSIG, and
+DP_XT_MSEM where the OS semaphore is an eventfd (Linux) and the 10
+is still signalled.  (2) is DP_XT_THCV, available if built with
+KLH10_DEV_DPTHREADS, for DPs that can be compiled into the KLH10.
 
 */
 
@@ -113,11 +116,24 @@ For now, keep everything in one mutually R/W region for simplicity.
 #ifndef OSDSUP_INCLUDED
 # include "osdsup.h"	/* For osintf_t etc */
 #endif
+#if KLH10_DEV_DPTHREADS
+# include <pthread.h>
+#endif
 
 #define DP_XT_MSIG 1	/* Shared mem, use signal for doorbell */
 #define DP_XT_MSEM 2	/* Shared mem, use semaphore for doorbell */
 #define DP_XT_THCV 3	/* Same mem, use thread condition var */
 
+/* DP_XT_MSEM needs eventfd(2); without it a request for MSEM quietly
+** falls back to MSIG.
+*/
+#ifndef DPSUP_EVFD
+# define DPSUP_EVFD CENV_SYS_LINUX
+#endif
+#ifndef DPSUP_SPINMAX		/* Max polls before a DP blocks */
+# define DPSUP_SPINMAX 4096
+#endif
+
 #if 0
 union dpcxmech {
     struct dpc_xt_msig {
@@ -129,6 +145,31 @@ union dpcxmech {
 };
 #endif
 
+/* Ordering barrier for the doorbells.  A waiter's sleep flag must be
+** visible before it rechecks the ready flag, and the ready flag before
+** the waker looks to see whether anyone is asleep.
+*/
+#if defined(__GNUC__)
+# define DP_MEMBAR() __sync_synchronize()
+#else
+# define DP_MEMBAR()
+#endif
+
+/* Hint to the CPU that we are in a spin-wait loop */
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+# define DP_CPURELAX() __builtin_ia32_pause()
+#else
+# define DP_CPURELAX()
+#endif
+
+/* Doorbell types for the DP end of a region (dpx_wakfd, dpx_donfd).
+**	With MSIG, and at the 10's end for MSEM and THCV, the doorbell is
+**	the signal; otherwise it is an eventfd (MSEM) or condition var (THCV).
+*/
+#define DPX_DBSIG  (-1)		/* Signal given by dpx_waksig/dpx_donsig */
+#define DPX_DBTHCV (-2)		/* dpx_dbcv */
+				/* Else an eventfd */
+
 /* DP one-way transfer region
 **	Ready flag is set to -1 when sender has deposited a message for
 **		the reader.  It is cleared to 0 when receiver has
@@ -155,6 +196,16 @@ struct dpx_s {
     int dpx_donpid;
     unsigned char *dpx_sbuf;	/* S: S's ptr into same buffer */
 #endif
+    int dpx_wakfd;		/* C: Doorbell to wake R, see DPX_DB */
+    int dpx_donfd;		/* C: Doorbell to ack S, see DPX_DB */
+    volatile int dpx_wakslp;	/* R: R is asleep on its doorbell */
+    volatile int dpx_donslp;	/* S: S is asleep on its doorbell */
+    int dpx_spin;		/* R or S: Current spin limit */
+#if KLH10_DEV_DPTHREADS
+    pthread_t dpx_th10;		/* C: THCV: thread to signal for the 10 */
+    pthread_mutex_t dpx_dbmtx;	/* C: THCV: doorbell for DP thread */
+    pthread_cond_t dpx_dbcv;
+#endif
 
     size_t dpx_len;		/* C: Buffer length */
     size_t dpx_off;		/* C: Buffer offset from beg of segment */
@@ -202,7 +253,7 @@ struct dpc_s {
 #define DPC_GV_MIN(a) (((a)>>5)&037)
 #define DPC_GV_PAT(a) (((a)>>0)&037)
 
-#define DPSUP_VERSION DPC_VERSION(1,2,0)	/* This version of DPSUP */
+#define DPSUP_VERSION DPC_VERSION(1,3,0)	/* This version of DPSUP */
 
 #define DPCF_MEMLOCK	0x1	/* M wants DP to lock its mem if possible */
 
@@ -213,6 +264,13 @@ struct dp_s {
     long dp_shmid;		/* Change to osmid_t later */
     struct dpc_s *dp_adr;
     int dp_chpid;		/* Change to ospid_t */
+#if KLH10_DEV_DPTHREADS
+    int dp_thact;		/* THCV: TRUE if thread running */
+    pthread_t dp_thid;		/* THCV: DP thread */
+    int (*dp_thrtn)(int, char **);	/* THCV: DP main routine */
+    char dp_tharg[32];		/* THCV: "-DPT:" arg for dp_main */
+    char *dp_thargv[4];
+#endif
 };
 typedef struct dp_s dp_t;
 
@@ -223,6 +281,9 @@ typedef struct dp_s dp_t;
 int dp_init (dp_t *dp, size_t, int, int, size_t in,
 				int, int, size_t out);
 int dp_start(dp_t *dp, char *pgm);
+#if KLH10_DEV_DPTHREADS
+int dp_thstart(dp_t *dp, char *name, int (*)(int, char **));
+#endif
 int dp_stop (dp_t *dp, int timeout);
 int dp_reset(dp_t *dp);		/* What would this do? */
 int dp_term (dp_t *dp, int timeout);
@@ -291,6 +352,21 @@ void dp_sleep(int);			/* Sleep for N seconds */
 #define dp_xtmsig_rcmd(dpx) ((dpx)->dpx_cmd)
 #define dp_xtmsig_rcnt(dpx) ((dpx)->dpx_cnt)
 
+/* Facilities for DP_XT_MSEM
+**	Same flags and buffers as MSIG; only the doorbells differ.  The
+**	direction that wakes the DP uses an eventfd, and is only written
+**	if the DP has actually gone to sleep on it after spinning a while,
+**	so a busy DP costs the sender no syscall at all.  The direction
+**	that wakes the 10 still uses the signal, since the 10 must be
+**	broken out of its instruction loop and cannot poll a semaphore.
+*/
+#define dp_xtmsem_stest(dpx) dp_xtmsig_stest(dpx)
+#define dp_xtmsem_sbuff(dpx, asiz) dp_xtmsig_sbuff(dpx, asiz)
+#define dp_xtmsem_rtest(dpx) dp_xtmsig_rtest(dpx)
+#define dp_xtmsem_rbuff(dpx, asiz) dp_xtmsig_rbuff(dpx, asiz)
+#define dp_xtmsem_rcmd(dpx) dp_xtmsig_rcmd(dpx)
+#define dp_xtmsem_rcnt(dpx) dp_xtmsig_rcnt(dpx)
+
 #if 0
 /* For device to register its dp with 10 via device vector */
 int dpcxt_msig_register(struct dpc_s *dpc, struct device *d);
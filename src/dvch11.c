@@ -1217,8 +1217,8 @@ chaos_init(register struct ch11 *ch, FILE *of)
 
     ch->ch_dpstate = FALSE;
     if (!dp_init(&ch->ch_dp, sizeof(struct dpchaos_s),
-			DP_XT_MSIG, SIGUSR1, (size_t)CHAOSBUFSIZ,	   /* in */
-			DP_XT_MSIG, SIGUSR1, (size_t)CHAOSBUFSIZ)) { /* out */
+			DP_XT_MSEM, SIGUSR1, (size_t)CHAOSBUFSIZ,	   /* in */
+			DP_XT_MSEM, SIGUSR1, (size_t)CHAOSBUFSIZ)) { /* out */
 	if (of) fprintf(of, "CH11 subproc init failed!\n");
 	return FALSE;
     }
@@ -1063,8 +1063,8 @@ imp_init(register struct lhdh *lh, FILE *of)
 
     lh->lh_dpstate = FALSE;
     if (!dp_init(&lh->lh_dp, sizeof(struct dpimp_s),
-			DP_XT_MSIG, SIGUSR1, (size_t)IMPBUFSIZ,	   /* in */
-			DP_XT_MSIG, SIGUSR1, (size_t)IMPBUFSIZ)) { /* out */
+			DP_XT_MSEM, SIGUSR1, (size_t)IMPBUFSIZ,	   /* in */
+			DP_XT_MSEM, SIGUSR1, (size_t)IMPBUFSIZ)) { /* out */
 	if (of) fprintf(of, "IMP subproc init failed!\n");
 	return FALSE;
     }
@@ -114,10 +114,13 @@ struct niptt {
 
 /* Internal echo check buffer entry */
 struct niecbe {
-    int niec_deathtmo;		/* .5-sec ticks left to live */
+    unsigned long niec_deathtick;	/* Reap when ni_ectick reaches this */
     unsigned char niec_hdr[ETHER_HDRSIZ];	/* Ether header */
     uint32 niec_digest;		/* Checksum/hash of data */
+    int niec_hnext;		/* Hash chain links (ring indices, -1 ends) */
+    int niec_hprev;
 };
+#define NI_ECHASH(ni, dig) ((((dig) >> 16) ^ (dig)) & (ni)->ni_echmsk)
 
 struct ni20 {
     struct device ni_dv;	/* Generic 10 device structure */
@@ -162,6 +165,9 @@ struct ni20 {
     unsigned char ni_tunadr[4];	/* Tunnel IP address (if masquerading) */
     int32 ni_c3dly;		/* Initial-cmd delay in ticks */
     int32 ni_c3dlyct;		/* Countdown (no delay if 0) */
+    int ni_evdrv;	/* TRUE to poll only when blocked by the 10 */
+    int ni_pimax;	/* Max # responses to queue before RQA PI */
+    int32 ni_pidly;	/* Max usecs to hold back RQA PI (0 = don't) */
 
     /* Cached port control block data */
     paddr_t ni_pcba;	/* Phys addr of PCB */
@@ -195,8 +201,13 @@ struct ni20 {
     struct dp_s ni_dp;	/* Handle on dev process */
     char *ni_dpname;	/* Pointer to dev process pathname */
     unsigned char *ni_sbuf;	/* Pointers to shared memory buffers */
+    unsigned char *ni_sbnxt;	/* Where next packet of a batch goes */
+    int ni_sbcnt;		/* # packets in batch not yet sent */
     unsigned char *ni_rbuf;
     int ni_rcnt;	/* # chars in received packet input buffer */
+    unsigned char *ni_rbase;	/* Start of DP->10 buffer */
+    unsigned char *ni_rbnxt;	/* Next record in a DPNI_RPKTS batch */
+    unsigned char *ni_rbend;	/* End of batch */
     int ni_dpidly;	/* # secs to sleep when starting NI DP */
     int ni_dpdbg;	/* Initial DP debug flag */
 #endif
@@ -204,6 +215,10 @@ struct ni20 {
     /* New clock timer stuff */
     struct clkent *ni_chktmr;	/* Timer for periodic run re-checks */
     int ni_docheck;		/* TRUE if timer active */
+    struct clkent *ni_pitmr;	/* Timer for held-back RQA PI */
+    int ni_pitact;		/* TRUE if timer active */
+    int ni_rqheld;		/* TRUE if RQA being held back */
+    int ni_rqcnt;		/* # responses queued while held back */
 
     /* Ugly echo packet checking, to emulate NI's half-duplex lossage */
     int ni_ecchk;	/* TRUE to check for (and flush) echoed packets */
@@ -214,6 +229,11 @@ struct ni20 {
     int ni_ecbffree;		/* Index of first free entry */
     struct clkent *ni_ectmr;	/* Timer for periodic buffer reaping */
     int ni_ectact;		/* TRUE if timer active */
+    unsigned long ni_ectick;	/* # half-sec reaping ticks so far */
+    int *ni_echash;		/* Hash chain heads, indexed by NI_ECHASH */
+    unsigned int ni_echmsk;	/* # hash chains - 1 (power of 2 - 1) */
+    unsigned long ni_echits;	/* # echo packets recognized and flushed */
+    unsigned long ni_ecmiss;	/* # packets from us not found in buffer */
 };
 
 static int nni20s = 0;
@@ -240,6 +260,7 @@ static int   ni20_init(struct device *d, FILE *of);
 static void  ni20_reset(struct device *d);
 static void  ni20_powoff(struct device *d);
 static int   ni20_cmd(struct device *d, FILE *of, char *cmdline);
+static int   ni20_status(struct device *d, FILE *of);
 #if KLH10_DEV_DPNI20
 static void  ni20_evhsdon(struct device *d, struct dvevent_s *evp);
 static void  ni20_evhrwak(struct device *d, struct dvevent_s *evp);
@@ -257,7 +278,13 @@ static void ni20_stop(struct ni20 *ni);
 static void ni20_enable(struct ni20 *ni);
 static void ni20_disable(struct ni20 *ni);
 static void ni20_run(struct ni20 *ni);
+#if KLH10_DEV_DPNI20
+static int  ni20_rpknext(struct ni20 *ni);
+static void ni20_sflush(struct ni20 *ni);
+#endif
 static int  ni20_runclk(void *arg);
+static int  ni20_piclk(void *arg);
+static void ni20_rqavail(struct ni20 *ni);
 static void ni_ethtodw(dw10_t *da, unsigned char *ea);
 static int  ni20_cmdchk(struct ni20 *ni);
 #if KLH10_DEV_DPNI20
@@ -288,6 +315,7 @@ static int  ni20_ecpclk(void *arg);
 static void ni_ecpstore(struct ni20 *ni, unsigned char *ucp, unsigned int len);
 static int  ni_ecpcheck(struct ni20 *ni, unsigned char *ucp, unsigned int len);
 static uint32 ni_ecpdigest(unsigned char *ucp, int len);
+static void ni_ecpflush(struct ni20 *ni, int newuse);
 
 /* Configuration Parameters */
 
@@ -307,6 +335,9 @@ static uint32 ni_ecpdigest(unsigned char *ucp, int len);
     prmdef(NIP_ECBUF,"echobuf"), /* # echoed pkts to remember */\
     prmdef(NIP_ECTMO,"echotmo"), /* # secs to remember them */\
     prmdef(NIP_C3DLY,"c3dly"),  /* # ticks to use for NI cmd #3 (LDPTT)*/\
+    prmdef(NIP_EVDRV,"evdriven"),/* TRUE= no polling while DP busy */\
+    prmdef(NIP_PIMAX,"pimax"),  /* # rcvd pkts to queue per RQA PI */\
+    prmdef(NIP_PIDLY,"pidelay"),/* Max # usecs to hold back RQA PI */\
     prmdef(NIP_RDTMO,"rdtmo"),  /* # secs to timeout on packetfilter read */\
     prmdef(NIP_DPDLY,"dpdelay"),/* # secs to sleep when starting DP */\
     prmdef(NIP_DPDBG,"dpdebug"),/* Initial DP debug value */\
@@ -349,6 +380,9 @@ ni20_conf_clear(struct ni20 *ni)
     ni->ni_rdtmo = 0;
     ni->ni_c3dly = 5;		/* Conservative 5-millisec timeout for T10 */
     ni->ni_c3dlyct = 0;
+    ni->ni_evdrv = TRUE;
+    ni->ni_pimax = 1;		/* No PI coalescing */
+    ni->ni_pidly = 0;
 #if KLH10_DEV_DPNI20
     ni->ni_dpname = "dpni20";	/* Pathname of device subproc */
     ni->ni_dpidly = 5;		/* Conservative 5-second timeout for T10/T20 */
@@ -478,6 +512,33 @@ ni20_conf(FILE *f, char *s, struct ni20 *ni)
 	    ni->ni_c3dly = lval;
 	    continue;
 
+	case NIP_EVDRV:		/* Parse as true/false boolean */
+	    if (!prm.prm_val)
+		break;
+	    if (!s_tobool(prm.prm_val, &ni->ni_evdrv))
+		break;
+	    continue;
+
+	case NIP_PIMAX:		/* Parse as decimal number */
+	    if (!prm.prm_val || !s_todnum(prm.prm_val, &lval))
+		break;
+	    if (lval < 1) {
+		fprintf(f, "NI20 pimax must be at least 1\n");
+		break;
+	    }
+	    ni->ni_pimax = lval;
+	    continue;
+
+	case NIP_PIDLY:		/* Parse as decimal number */
+	    if (!prm.prm_val || !s_todnum(prm.prm_val, &lval))
+		break;
+	    if (lval < 0) {
+		fprintf(f, "NI20 pidelay must not be negative\n");
+		break;
+	    }
+	    ni->ni_pidly = lval;
+	    continue;
+
 	case NIP_ECCHK:		/* Parse as true/false boolean */
 	    if (!prm.prm_val)
 		break;
@@ -541,6 +602,12 @@ ni20_conf(FILE *f, char *s, struct ni20 *ni)
 	return FALSE;
     }
 
+    /* PI coalescing is off without a pidelay, so pimax alone does nothing */
+    if (ni->ni_pimax > 1 && ni->ni_pidly <= 0) {
+	fprintf(f, "NI20 param \"pimax\" needs a nonzero \"pidelay\"\n");
+	return FALSE;
+    }
+
     /* If necessary, make a guess as to whether to do echo checking.  Although
     ** setting it TRUE is the safe default for accurate emulation, the overhead
     ** may sometimes be questionable.
@@ -628,6 +695,7 @@ dvni20_create(FILE *f, char *s)
     ni->ni_dv.dv_datao = ni20_datao;
     ni->ni_dv.dv_datai = ni20_datai;
     ni->ni_dv.dv_cmd = ni20_cmd;
+    ni->ni_dv.dv_status = ni20_status;
 
     ni->ni_dv.dv_bind = NULL;		/* Not a controller!! */
     ni->ni_dv.dv_init = ni20_init;	/* Set up own post-bind init */
@@ -676,16 +744,37 @@ ni20_init(struct device *d,
     clk_tmrquiet(ni->ni_chktmr);	/* Immediately make it quiescent */
     ni->ni_docheck = FALSE;
 
+    /* Set up timer for holding back response queue PIs.
+    ** Its interval is set from ni_pidly each time it's activated.
+    */
+    if (!ni->ni_pitmr)
+	ni->ni_pitmr = clk_tmrget(ni20_piclk, (void *)ni,
+				CLK_USECS_PER_MSEC);
+    clk_tmrquiet(ni->ni_pitmr);		/* Immediately make it quiescent */
+    ni->ni_pitact = FALSE;
+    ni->ni_rqheld = FALSE;
+    ni->ni_rqcnt = 0;
+
     /* Initialize gross echo packet checking if necessary */
     if (ni->ni_ecchk && !(ni->ni_dedic) && (ni->ni_ecblen > 0)) {
 	/* Echo check for shared interface, must use buffer, ugh! */
+	register unsigned int i;
+
 	ni->ni_ecb = (struct niecbe *)malloc(ni->ni_ecblen
 						* sizeof(struct niecbe));
-	if (!(ni->ni_ecb)) {
+	/* Hash table has a power of 2 chain heads, at least one per entry */
+	for (i = 1; i < (unsigned int)ni->ni_ecblen; i <<= 1) ;
+	ni->ni_echmsk = i - 1;
+	ni->ni_echash = (int *)malloc(i * sizeof(int));
+	if (!(ni->ni_ecb) || !(ni->ni_echash)) {
 	    if (of) fprintf(of, "NI20 couldn't alloc echo check buffer\n");
 	    return FALSE;
 	}
+	while (i > 0)
+	    ni->ni_echash[--i] = -1;	/* All chains empty */
 	ni->ni_ecbfuse = ni->ni_ecbffree = 0;
+	ni->ni_ectick = 0;
+	ni->ni_echits = ni->ni_ecmiss = 0;
 	if (ni->ni_ectmo) {	/* Use slow half-sec clock? */
 	    ni->ni_ectmr = clk_tmrget(ni20_ecpclk, (void *)ni,
 						(CLK_USECS_PER_SEC/2));
@@ -701,13 +790,17 @@ ni20_init(struct device *d,
 
     ni->ni_dpstate = FALSE;
     if (!dp_init(&ni->ni_dp, sizeof(struct dpni20_s),
-			DP_XT_MSIG, SIGUSR1, (size_t)1600,	/* in */
-			DP_XT_MSIG, SIGUSR1, (size_t)1600)) {	/* out */
+			DP_XT_MSEM, SIGUSR1, (size_t)DPNI_RBUFSIZ, /* in */
+			DP_XT_MSEM, SIGUSR1, (size_t)DPNI_SBUFSIZ)) { /* out */
 	if (of) fprintf(of, "NI20 subproc init failed!\n");
 	return FALSE;
     }
-    ni->ni_sbuf = dp_xsbuff(&(ni->ni_dp.dp_adr->dpc_todp), &junk);
-    ni->ni_rbuf = dp_xrbuff(&(ni->ni_dp.dp_adr->dpc_frdp), &junk);
+    ni->ni_sbuf = ni->ni_sbnxt =
+		dp_xsbuff(&(ni->ni_dp.dp_adr->dpc_todp), &junk);
+    ni->ni_sbcnt = 0;
+    ni->ni_rbuf = ni->ni_rbase =
+		dp_xrbuff(&(ni->ni_dp.dp_adr->dpc_frdp), &junk);
+    ni->ni_rbnxt = ni->ni_rbend = NULL;
 
     ni->ni_dv.dv_dpp = &(ni->ni_dp);	/* Tell CPU where our DP struct is */
 
@@ -817,8 +910,10 @@ ni20_powoff(struct device *d)
 		NULL,		/* No event handler proc */
 		(struct dvevent_s *)NULL);
     dp_term(&(ni->ni_dp), 0);	/* Flush all subproc overhead */
-    ni->ni_sbuf = NULL;		/* Clear pointers no longer meaningful */
-    ni->ni_rbuf = NULL;
+    ni->ni_sbuf = ni->ni_sbnxt = NULL; /* Clear ptrs no longer meaningful */
+    ni->ni_sbcnt = 0;
+    ni->ni_rbuf = ni->ni_rbase = NULL;
+    ni->ni_rbnxt = ni->ni_rbend = NULL;
 #endif
 }
 
@@ -1243,6 +1338,9 @@ ni20_clear(register struct ni20 *ni)
     ni->ni_qepa = 0;		/* Active queue entry (needs relinking) */
     ni->ni_qhpa = 0;		/* Active queue header (relink here) */
     ni->ni_pktinf = FALSE;	/* TRUE if have packet input waiting */
+#if KLH10_DEV_DPNI20
+    ni->ni_sbcnt = 0;		/* Forget any unsent output batch */
+#endif
 
     ni->ni_nptts = 0;		/* # of valid entries in PTT */
     ni->ni_nmcats = 0;		/* # of valid entries in MCAT */
@@ -1251,6 +1349,10 @@ ni20_clear(register struct ni20 *ni)
 
     clk_tmrquiet(ni->ni_chktmr);	/* Force timer to be quiescent */
     ni->ni_docheck = FALSE;
+    clk_tmrquiet(ni->ni_pitmr);		/* Ditto for held-back RQA */
+    ni->ni_pitact = FALSE;
+    ni->ni_rqheld = FALSE;
+    ni->ni_rqcnt = 0;
 }
 
 /* NI20_PICHECK - Check NI20 conditions to see if PI should be attempted.
@@ -1826,6 +1928,17 @@ ni20_cmdchk(register struct ni20 *ni)
 		i, (long)LHGET(w), (long)RHGET(w), (long)qe);
     }
 
+#if KLH10_DEV_DPNI20
+    /* Anything but another send may want the DP itself, so first send
+    ** off any batch built so far, and leave the command for later.
+    */
+    if (ni->ni_sbcnt && (i != NI20_OP_SND)) {
+	ni20_sflush(ni);
+	(void) ni_qeunget(ni, (ni->ni_pcba + NI20_PB_CQI), qe);
+	return 0;		/* Return incomplete */
+    }
+#endif
+
     qh = ni->ni_pcba + NI20_PB_UQI;	/* Unk-Ptcl is default relink queue */
     switch (i) {
     case NI20_OP_SND:		/* Send Datagram */
@@ -1930,6 +2043,7 @@ static int
 nicmd_snddg(register struct ni20 *ni, register vmptr_t qep)
 {
     register unsigned char *ucp;
+    unsigned char *pkp;		/* Start of packet */
     int lhcmd;			/* LH of cmd word (flags) */
     unsigned int tlen;		/* Data length */
     unsigned int ptyp;		/* Protocol type */
@@ -1974,7 +2088,16 @@ nicmd_snddg(register struct ni20 *ni, register vmptr_t qep)
 	    fprintf(NIDBF(ni), "[nicmd_snddg: DP overrun!]");
 	return ni_errbyte(1, NI20_ERR_DOV);
     }
+# if DPNI_SBATCH > 1
+    /* Add to the batch, leaving room for the record's count.
+    ** ni20_sflush ensures there's always room for a max-size packet.
+    */
+    if (!ni->ni_sbcnt)
+	ni->ni_sbnxt = ni->ni_sbuf;
+    ucp = ni->ni_sbnxt + 2;
+# else
     ucp = ni->ni_sbuf;
+# endif
 
 #else
     /* Set up raw packet buffer.  For now, simply clobber static area
@@ -1990,6 +2113,7 @@ nicmd_snddg(register struct ni20 *ni, register vmptr_t qep)
     }
     ucp = ni20_sbuf;
 #endif /* ! KLH10_DEV_DPNI20 */
+    pkp = ucp;
 
     /* Set up header */
     ni_dwtoeth(ucp + ETHER_PX_DST, dest);	/* First goes dest addr */
@@ -2076,19 +2200,28 @@ nicmd_snddg(register struct ni20 *ni, register vmptr_t qep)
       && (op10m_tlnn(dest.w[0], 02000)		/* If multicast, or to */
 	  || ( op10m_came(ni->ni_dwethadr.w[0], dest.w[0])	/* self */
 	    && op10m_came(ni->ni_dwethadr.w[1], dest.w[1])))) {
-	ni_ecpstore(ni, 		/* Remember the packet! */
-#if KLH10_DEV_DPNI20
-		ni->ni_sbuf,
-#else
-		ni20_sbuf,
-#endif
-		tlen);
+	ni_ecpstore(ni, pkp, tlen);	/* Remember the packet! */
     }
 
 #if KLH10_DEV_DPNI20
+# if DPNI_SBATCH > 1
+    /* Finish the record; send the batch now only if it's full.
+    ** Otherwise ni20_run sends it once it runs out of commands.
+    */
+    pkp[-2] = (tlen >> 8) & 0377;
+    pkp[-1] = tlen & 0377;
+    ni->ni_sbnxt = pkp + tlen;
+    if (NIDEBUG(ni))
+	fprintf(NIDBF(ni), "[nicmd_snddg: DP batch %d: %d]",
+					ni->ni_sbcnt + 1, tlen);
+    if (++(ni->ni_sbcnt) >= DPNI_SBATCH
+      || (ni->ni_sbuf + DPNI_SBUFSIZ) - ni->ni_sbnxt < DPNI_PKTSIZ+2)
+	ni20_sflush(ni);
+# else
     if (NIDEBUG(ni))
 	fprintf(NIDBF(ni), "[nicmd_snddg: DP send: %d]", tlen);
     dp_xsend(&(ni->ni_dp.dp_adr->dpc_todp), DPNI_SPKT, (size_t)tlen);
+# endif
 #else
     /* For now, set up something to pretend received it on loopback?? */
 
@@ -2904,14 +3037,31 @@ ni_qeput(register struct ni20 *ni,
     vm_pset(qhp + NI20_QH_BLI, w);	/* Set QH backlink -> QE */
 
     /* Linked, now check to see whether to set CSR Resp-Queue-Avail bit */
-    if ((qtp == vm_padd(qhp, NI20_QH_FLI))	/* If Q was empty before */
+    if (((qtp == vm_padd(qhp, NI20_QH_FLI))	/* If Q was empty before */
+	 || ni->ni_rqheld)			/* or RQA being held back */
       && (qh == (ni->ni_pcba + NI20_PB_RQI))) {	/* and Q is Response Q */
 
-	ni->ni_cond |= NI20CI_RQA;	/* Say response Q available! */
-	if (NIDEBUG(ni))
-	    fprintf(NIDBF(ni), "[ni_qeput: Q=%lo E=%lo #=1 Set_RQA]",
+	/* If coalescing, hold off the PI until enough responses are
+	** queued or the timer runs out.  A timer still pending from an
+	** earlier hold-back is left alone; it just ends this one sooner.
+	*/
+	if (ni->ni_pidly > 0 && ni->ni_pitmr
+	  && ++(ni->ni_rqcnt) < ni->ni_pimax) {
+	    ni->ni_rqheld = TRUE;
+	    if (!ni->ni_pitact) {
+		clk_tmrset(ni->ni_pitmr, ni->ni_pidly);
+		clk_tmractiv(ni->ni_pitmr);
+		ni->ni_pitact = TRUE;
+	    }
+	    if (NIDEBUG(ni))
+		fprintf(NIDBF(ni), "[ni_qeput: Q=%lo E=%lo #=%d Held_RQA]",
+			(long)qh, (long)qe, ni->ni_rqcnt);
+	} else {
+	    if (NIDEBUG(ni))
+		fprintf(NIDBF(ni), "[ni_qeput: Q=%lo E=%lo Set_RQA]",
 			(long)qh, (long)qe);
-	ni20_pi(ni);
+	    ni20_rqavail(ni);
+	}
 
     } else
 	if (NIDEBUG(ni))
@@ -3022,10 +3172,11 @@ ni20_evhrwak(struct device *d,
 	** user (via NI%).  Another example of emulating hardware bogosity.
 	*/
 	case DPNI_RPKT:
+	    ni->ni_rbuf = ni->ni_rbase;
+	    ni->ni_rbnxt = ni->ni_rbend = NULL;
 	    ni->ni_cnts[NI20_RC_BR] += (ni->ni_rcnt = dp_xrcnt(dpx)) + 4;
 	    ni->ni_cnts[NI20_RC_FR]++;		/* Update # bytes & frames */
 	    if (ni->ni_state == NI20_ST_RUNENA) { /* If running enabled */
-		/* ni->ni_rbuf = ;  Already set up */
 		ni->ni_pktinf = TRUE;
 		ni20_run(ni);			/* Go process it */
 	    } else {
@@ -3036,11 +3187,74 @@ ni20_evhrwak(struct device *d,
 		ni->ni_pktinf = FALSE;		/* Ensure flushed */
 	    }
 	    break;
+
+	case DPNI_RPKTS:		/* Several packets, one per record */
+	    ni->ni_rbnxt = ni->ni_rbase;
+	    ni->ni_rbend = ni->ni_rbase + dp_xrcnt(dpx);
+	    if (ni->ni_state == NI20_ST_RUNENA	/* If running enabled */
+	      && ni20_rpknext(ni)) {		/* and got the first one */
+		ni->ni_pktinf = TRUE;
+		ni20_run(ni);			/* Go process them */
+	    } else {
+		if (NIDEBUG(ni))
+		    fprintf(NIDBF(ni), "[ni20_evhrwak: R flushed]");
+		dp_xrdone(dpx);			/* Else just ACK it */
+		ni->ni_pktinf = FALSE;		/* Ensure flushed */
+	    }
+	    break;
 	}
     }
 }
 #endif /* KLH10_DEV_DPNI20 */
 
+#if KLH10_DEV_DPNI20
+
+/* NI20_RPKNEXT - Set up the next packet of a DPNI_RPKTS batch as the
+**	received packet, counting it as the hardware would.
+**	Returns FALSE if the batch is used up.
+*/
+static int
+ni20_rpknext(register struct ni20 *ni)
+{
+    register unsigned char *ucp = ni->ni_rbnxt;
+    register int cnt;
+
+    if (!ucp || (ni->ni_rbend - ucp) < 2)
+	return FALSE;
+    cnt = (ucp[0] << 8) | ucp[1];
+    if (cnt > (ni->ni_rbend - ucp) - 2) {	/* Paranoia */
+	ni->ni_rbnxt = ni->ni_rbend = NULL;
+	return FALSE;
+    }
+    ni->ni_rbuf = ucp + 2;
+    ni->ni_rcnt = cnt;
+    ni->ni_rbnxt = ucp + 2 + cnt;
+
+    /* See kludge note in ni20_evhrwak re extra 4 bytes */
+    ni->ni_cnts[NI20_RC_BR] += cnt + 4;
+    ni->ni_cnts[NI20_RC_FR]++;		/* Update # bytes & frames */
+    return TRUE;
+}
+#endif /* KLH10_DEV_DPNI20 */
+
+#if KLH10_DEV_DPNI20
+
+/* NI20_SFLUSH - Send the DP any batch of output packets built up by
+**	nicmd_snddg.
+*/
+static void
+ni20_sflush(register struct ni20 *ni)
+{
+    if (ni->ni_sbcnt) {
+	if (NIDEBUG(ni))
+	    fprintf(NIDBF(ni), "[ni20_sflush: DP send %d pkts]", ni->ni_sbcnt);
+	dp_xsend(&(ni->ni_dp.dp_adr->dpc_todp), DPNI_SPKTS,
+				(size_t)(ni->ni_sbnxt - ni->ni_sbuf));
+	ni->ni_sbcnt = 0;
+    }
+}
+#endif /* KLH10_DEV_DPNI20 */
+
 /* NI20_RUNCLK - invoked by clock timeout code to "run" the NI20
 **	if needed.
 */
@@ -3057,13 +3271,49 @@ ni20_runclk(void *arg)
 		: CLKEVH_RET_QUIET;		/* No recheck */
 }
 
+/* NI20_PICLK - invoked by clock timeout code when a held-back
+**	response queue PI has waited ni_pidly usecs.
+*/
+static int
+ni20_piclk(void *arg)
+{
+    register struct ni20 *ni = (struct ni20 *)arg;
+
+    if (NIDEBUG(ni))
+	fprintf(NIDBF(ni), "[ni20_piclk: %d]", ni->ni_rqcnt);
+    ni->ni_pitact = FALSE;		/* Timer goes quiet on return */
+    if (ni->ni_rqheld)
+	ni20_rqavail(ni);
+    return CLKEVH_RET_QUIET;
+}
+
+/* NI20_RQAVAIL - Set Response Queue Available and trigger PI, ending
+**	any hold-back.  The timer, if active, is left to run out on its own
+**	since this may be called from within another clock callout.
+*/
+static void
+ni20_rqavail(register struct ni20 *ni)
+{
+    ni->ni_rqheld = FALSE;
+    ni->ni_rqcnt = 0;
+    ni->ni_cond |= NI20CI_RQA;	/* Say response Q available! */
+    ni20_pi(ni);
+}
+
 /* NI20_RUN - Invoked whenever the NI20 needs to "run".
 **	Synchronously, invoked by clock timeout via ni20_rundef().
 **	Asynchronously, invoked by insbreak event handling.
+**
+**	The recheck timer is only needed while the 10 is holding a queue
+**	locked or a command must be delayed.  If ni_evdrv is set and all
+**	that's holding things up is the DP not having taken the last
+**	output yet, ni20_evhsdon will run us again when it does.
 */
 static void
 ni20_run(register struct ni20 *ni)
 {
+    register int dpwait = FALSE;	/* TRUE if waiting only for DP */
+
     if (NIDEBUG(ni))
 	fprintf(NIDBF(ni), "[ni20_run:]");
 
@@ -3086,11 +3336,17 @@ ni20_run(register struct ni20 *ni)
 	    if (res == DGRCV_WONFLS || res == DGRCV_BLKFLS) {
 		ni->ni_pktinf = FALSE;
 #if KLH10_DEV_DPNI20
-		/* Tell DP that we're done with what it sent us */
-		if (NIDEBUG(ni))
-		    fprintf(NIDBF(ni), "[ni20_run: R done]");
-
-		dp_xrdone(&(ni->ni_dp.dp_adr->dpc_frdp));
+		/* If rest of a batch is pending, go on to its next packet.
+		** Otherwise tell DP that we're done with what it sent us.
+		*/
+		if (ni20_rpknext(ni))
+		    ni->ni_pktinf = TRUE;
+		else {
+		    if (NIDEBUG(ni))
+			fprintf(NIDBF(ni), "[ni20_run: R done]");
+
+		    dp_xrdone(&(ni->ni_dp.dp_adr->dpc_frdp));
+		}
 #endif
 	    }
 	    if (res != DGRCV_WONFLS)
@@ -3104,12 +3360,19 @@ ni20_run(register struct ni20 *ni)
 	    ** an ethernet datagram.  Yes, this is kludgy; should only
 	    ** block on actual sending, not on commands in general.
 	    */
-	    if (!dp_xstest(&(ni->ni_dp.dp_adr->dpc_todp)))
+	    if (!dp_xstest(&(ni->ni_dp.dp_adr->dpc_todp))) {
+		dpwait = TRUE;
 		break;
+	    }
 #endif
 	    if (!ni20_cmdchk(ni))
 		break;
 	} else {
+#if KLH10_DEV_DPNI20
+	    ni20_sflush(ni);		/* Send any output batch */
+#endif
+	    if (ni->ni_pktinf && ni->ni_evdrv)
+		break;			/* Input blocked on a locked queue */
 	    ni->ni_docheck = FALSE;	/* Nothing left to do */
 	    if (NIDEBUG(ni))
 		fprintf(NIDBF(ni), "[ni20_run: Done]");
@@ -3117,6 +3380,20 @@ ni20_run(register struct ni20 *ni)
 	}
 
     }
+#if KLH10_DEV_DPNI20
+    ni20_sflush(ni);		/* Don't hold output while blocked */
+#endif
+
+    if (dpwait && ni->ni_evdrv
+      && !ni->ni_pktinf && !ni->ni_qhpa) {
+	/* Nothing to poll for; wait for the DP's "done" event.
+	** If the timer is active it'll go quiet next time it fires.
+	*/
+	ni->ni_docheck = FALSE;
+	if (NIDEBUG(ni))
+	    fprintf(NIDBF(ni), "[ni20_run: wait for DP]");
+	return;
+    }
 
     /* Now what?  Re-schedule self? */
     if (!ni->ni_docheck) {
@@ -3129,6 +3406,12 @@ ni20_run(register struct ni20 *ni)
 
 /* Echo Packet Check grossness.
     See comment page with note on "Loopback" for explanation of all this.
+
+    Remembered packets live in a ring buffer, oldest first, which gives
+    the order for flushing on a match and for reaping on timeout.  Each
+    active entry is also threaded onto a hash chain selected by its data
+    digest, so a received packet is compared only against entries with
+    the same hash instead of against the whole ring.
 */
 
 /* Remember datagram for later checking.
@@ -3139,35 +3422,43 @@ ni_ecpstore(register struct ni20 *ni,
 	    unsigned int len)		/* # bytes in datagram */
 {
     register struct niecbe *be;
+    register int i, h;
 
     /* Always grab next "free" in ring.  This will clobber oldest entry
     ** if buffer is full.
     */
     if (!(be = ni->ni_ecb))
 	return;			/* Sanity check */
-    be += ni->ni_ecbffree;	/* Point to first free */
+    be += (i = ni->ni_ecbffree);	/* Point to first free */
 
     /* Stuff data into entry */
     memcpy(be->niec_hdr, ucp, sizeof(be->niec_hdr));	/* Remember header */
     be->niec_digest = ni_ecpdigest(ucp + sizeof(be->niec_hdr),
 				len - sizeof(be->niec_hdr));
-    be->niec_deathtmo = ni->ni_ectmo;
+    be->niec_deathtick = ni->ni_ectick + ni->ni_ectmo;
+
+    /* Link at head of its hash chain */
+    h = NI_ECHASH(ni, be->niec_digest);
+    be->niec_hprev = -1;
+    if ((be->niec_hnext = ni->ni_echash[h]) >= 0)
+	ni->ni_ecb[be->niec_hnext].niec_hprev = i;
+    ni->ni_echash[h] = i;
 
     if (NIDEBUG(ni))
-	fprintf(NIDBF(ni), "[ni_ecpstore: added #%d]", ni->ni_ecbffree);
+	fprintf(NIDBF(ni), "[ni_ecpstore: added #%d]", i);
 
     /* Now bump index */
-    if (++(ni->ni_ecbffree) >= ni->ni_ecblen)
-	ni->ni_ecbffree = 0;		/* Wrap to start of ring buffer */
-    if (ni->ni_ecbffree == ni->ni_ecbfuse) {
+    if (++i >= ni->ni_ecblen)
+	i = 0;				/* Wrap to start of ring buffer */
+    ni->ni_ecbffree = i;
+    if (i == ni->ni_ecbfuse) {
 	/* We've used up last buffer slot!  Flush oldest one in order to
 	    always maintain a gap of one.
 	*/
 	if (NIDEBUG(ni))
 	    fprintf(NIDBF(ni), "[ni_ecpstore: buffer overflow, flushed #%d]",
-			ni->ni_ecbfuse);
-	if (++(ni->ni_ecbfuse) >= ni->ni_ecblen)
-	    ni->ni_ecbfuse = 0;
+			i);
+	ni_ecpflush(ni, ((++i < ni->ni_ecblen) ? i : 0));
     }
 
     /* Tickle timer if necessary */
@@ -3186,42 +3477,72 @@ ni_ecpcheck(register struct ni20 *ni,
 	    unsigned int len)			/* # bytes in datagram */
 {
     register struct niecbe *be;
-    register int i;
+    register int i, m;
     register uint32 digest;
     register int cnt = 0;		/* For debugging */
 
-    if (!(be = ni->ni_ecb)		/* Do nothing if no buffer */
-      || (ni->ni_ecbfuse == ni->ni_ecbffree))	/* or nothing active */
+    if (!(ni->ni_ecb)			/* Do nothing if no buffer */
+      || (ni->ni_ecbfuse == ni->ni_ecbffree)) {	/* or nothing active */
+	ni->ni_ecmiss++;
 	return FALSE;
-    digest = ni_ecpdigest(ucp + sizeof(be->niec_hdr),
-				len - sizeof(be->niec_hdr));
-    for (be += (i = ni->ni_ecbfuse); i != ni->ni_ecbffree; ++cnt) {
+    }
+    digest = ni_ecpdigest(ucp + ETHER_HDRSIZ, len - ETHER_HDRSIZ);
+
+    /* Chains are newest-first; the oldest match is the one the ring scan
+    ** would have found, so keep going to the end.
+    */
+    for (m = -1, i = ni->ni_echash[NI_ECHASH(ni, digest)];
+	    i >= 0; i = be->niec_hnext, ++cnt) {
+	be = &ni->ni_ecb[i];
 	if ((be->niec_digest == digest)
-	  && (memcmp(be->niec_hdr, ucp, sizeof(be->niec_hdr))==0)) {
-	    /* MATCHED!!!
-		Flush not only this entry but any others prior to it, on
-		assumption that packet ordering will be preserved.
-	    */
-	    ni->ni_ecbfuse =		/* Set new active start pos */
-		((++i < ni->ni_ecblen) ? i : 0);
-	    if (NIDEBUG(ni))
-		fprintf(NIDBF(ni),
-			"[ni_ecpcheck: echo-flushed %ld up to #%d]",
-			(long) cnt, i);
-	    return TRUE;
-	}
-	if (++i < ni->ni_ecblen)	/* Bump to next entry */
-	    ++be;
-	else				/* Wrap in ring buf */
-	    i = 0, be = ni->ni_ecb;
+	  && (memcmp(be->niec_hdr, ucp, sizeof(be->niec_hdr))==0))
+	    m = i;
+    }
+    if (m >= 0) {
+	/* MATCHED!!!
+	    Flush not only this entry but any others prior to it, on
+	    assumption that packet ordering will be preserved.
+	*/
+	ni_ecpflush(ni, ((++m < ni->ni_ecblen) ? m : 0));
+	ni->ni_echits++;
+	if (NIDEBUG(ni))
+	    fprintf(NIDBF(ni),
+		    "[ni_ecpcheck: echo-flushed up to #%d, chain %d]",
+		    m, cnt);
+	return TRUE;
     }
 
+    ni->ni_ecmiss++;
     if (NIDEBUG(ni))
-	fprintf(NIDBF(ni), "[ni_ecpcheck: no match in %ld]", (long) cnt);
+	fprintf(NIDBF(ni), "[ni_ecpcheck: no match in chain %d]", cnt);
 
     return FALSE;		/* Not an echoed packet */
 }
 
+/* Flush active entries from the oldest up to (not including) index newuse,
+    unlinking each from its hash chain.
+*/
+static void
+ni_ecpflush(register struct ni20 *ni,
+	    int newuse)
+{
+    register struct niecbe *be;
+    register int i;
+
+    for (i = ni->ni_ecbfuse; i != newuse; ) {
+	be = &ni->ni_ecb[i];
+	if (be->niec_hprev >= 0)
+	    ni->ni_ecb[be->niec_hprev].niec_hnext = be->niec_hnext;
+	else
+	    ni->ni_echash[NI_ECHASH(ni, be->niec_digest)] = be->niec_hnext;
+	if (be->niec_hnext >= 0)
+	    ni->ni_ecb[be->niec_hnext].niec_hprev = be->niec_hprev;
+	if (++i >= ni->ni_ecblen)	/* Bump to next entry */
+	    i = 0;
+    }
+    ni->ni_ecbfuse = newuse;	/* Set new active start pos */
+}
+
 /* Grind datagram data and return a digest/checksum value
 */
 static uint32
@@ -3246,31 +3567,27 @@ ni20_ecpclk(void *arg)
     if (NIDEBUG(ni))
 	fprintf(NIDBF(ni), "[ni20_ecpclk:]");
 
+    ++(ni->ni_ectick);
     if (ni->ni_ectact) {
 	register int i;
-	register int cnt, dcnt;		/* For debugging */
+	register int dcnt;		/* For debugging */
 
-	/* Scan starting at first active entry and flush those that
-	** have timed out.  This is gross, but simpler than maintaining
-	** delta values for now.
+	/* Entries are stored in time order and all live equally long,
+	** so only the oldest few can have timed out.
 	*/
-	cnt = dcnt = 0;
-	for (i = ni->ni_ecbfuse; i != ni->ni_ecbffree; ++cnt) {
-	    if (--(ni->ni_ecb[i].niec_deathtmo) <= 0) {
-		if (++i >= ni->ni_ecblen)	/* Bump to next entry */
-		    i = 0;
-		ni->ni_ecbfuse = i;	/* Set new active start pos */
-		++dcnt;
-		continue;
-	    }
+	dcnt = 0;
+	for (i = ni->ni_ecbfuse; i != ni->ni_ecbffree; ++dcnt) {
+	    if ((long)(ni->ni_ecb[i].niec_deathtick - ni->ni_ectick) > 0)
+		break;
 	    if (++i >= ni->ni_ecblen)	/* Bump to next entry */
 		i = 0;
 	}
 	if (dcnt) {
+	    ni_ecpflush(ni, i);
 	    if (NIDEBUG(ni))
 		fprintf(NIDBF(ni),
-			"[ni_ecptmo: flushed %d of %d, left #%d-#%d]",
-			dcnt, cnt, ni->ni_ecbfuse, ni->ni_ecbffree);
+			"[ni_ecptmo: flushed %d, left #%d-#%d]",
+			dcnt, ni->ni_ecbfuse, ni->ni_ecbffree);
 	}
 	if (ni->ni_ecbfuse == ni->ni_ecbffree) {
 	    ni->ni_ectact = FALSE;		/* No more, silence timer */
@@ -3279,7 +3596,7 @@ ni20_ecpclk(void *arg)
     return ni->ni_ectact ? CLKEVH_RET_REPEAT	/* Repeat again later */
 		: CLKEVH_RET_QUIET;		/* No recheck */
 }
-
+
 #if 0
 /* NI20_IOBEG - Called by drive to set up data channel just prior to
 **	starting an I/O xfer.
@@ -3476,6 +3793,8 @@ CMDDEF(cd_powoff,fc_powoff, CMRF_NOARG,	NULL,
 				"Power the NI20 unit off", "")
 CMDDEF(cd_set,   fc_set,    CMRF_TLIN,	NULL,
 				"Dynamically change config settings (not all will work!)", "")
+CMDDEF(cd_status,fc_status, CMRF_NOARG,	NULL,
+				"Show NI20 echo check statistics", "")
 #if KLH10_DEV_DPNI20
 CMDDEF(cd_dpquit,fc_dpquit, CMRF_NOARG,	NULL,
 				"Tell the Device Proc to quit", "")
@@ -3491,6 +3810,7 @@ KEYSBEGIN(ni20keys)
     KEYDEF("stop",	cd_stop)
     KEYDEF("powoff",	cd_powoff)
     KEYDEF("set",	cd_set)
+    KEYDEF("status",	cd_status)
 #if KLH10_DEV_DPNI20
     KEYDEF("dpstart",	cd_dpstart)
     KEYDEF("dpquit",	cd_dpquit)
@@ -3565,6 +3885,34 @@ fc_set(struct cmd_s *cm0)
     ni20_conf(cm->ni20_of, cm0->cmd_arglin, cm->ni20_dev);
 }
 
+static void
+fc_status(struct cmd_s *cm0)
+{
+    struct cmd_ni20_s *cm = (struct cmd_ni20_s *)cm0;
+
+    (void) ni20_status(&cm->ni20_dev->ni_dv, cm->ni20_of);
+}
+
+static int
+ni20_status(struct device *d, FILE *of)
+{
+    register struct ni20 *ni = (struct ni20 *)d;
+    register int n;
+
+    if (!ni->ni_ecb) {
+	fprintf(of, "No echo check buffer.\n");
+	return TRUE;
+    }
+    n = ni->ni_ecbffree - ni->ni_ecbfuse;
+    if (n < 0)
+	n += ni->ni_ecblen;
+    fprintf(of, "Echo check buffer: %d of %d entries in use, %lu hash chains\n",
+		n, ni->ni_ecblen - 1, (unsigned long)ni->ni_echmsk + 1);
+    fprintf(of, "  Echo packets flushed: %lu, own packets passed: %lu\n",
+		ni->ni_echits, ni->ni_ecmiss);
+    return TRUE;
+}
+
 #if KLH10_DEV_DPNI20
 
 static void
@@ -117,6 +117,8 @@ static void rh11_attn(struct device *drv, int on);
 static void rh11_drerr(struct device *drv);
 static int  rh11_iobeg(struct device *drv, int wflg);
 static int  rh11_iobuf(struct device *drv, int wc, vmptr_t *avp);
+static int  rh11_iosgl(struct device *drv, long maxwc,
+		       struct dviosg_s *sg, int nsg);
 static void rh11_ioend(struct device *drv, int bc);
 
 /* Completely internal functions */
@@ -321,6 +323,7 @@ rh11_bind(register struct device *d,
     slv->dv_iobeg = rh11_iobeg;	/* IO xfer beg */
     slv->dv_iobuf = rh11_iobuf;	/* IO xfer buffer setup */
     slv->dv_ioend = rh11_ioend;	/* IO xfer end */
+    slv->dv_iosgl = rh11_iosgl;	/* IO xfer scatter-gather list */
 
     rh->rh_drive[num] = slv;
     rh->rh_dt[num] = 0;		/* Drive not yet inited, so can't ask it */
@@ -810,6 +813,8 @@ rh11_iobeg(struct device *drv, int wflg)
 **	Caller must provide # of words used from the last call (0 if none).
 **	In particular, final transfer MUST invoke this to tell the channel
 **	how many words were actually used.
+**	The # of words may run past the current segment if the drive used
+**	a scatter-gather list from rh11_iosgl.
 **
 **	If returns 0, no data or space left.
 **	If returns +, OK, *avp NULL if skipping, else vmptr to mem.
@@ -837,9 +842,12 @@ rh11_iobuf(struct device *drv,
 	*/
 	ba = rh->rh_ba + (wc << 2);	/* Get updated BA value (byte addr) */
 	if (ba > MASK16) {		/* Overflowed 16 bits? */
-	    /* Add overflow bit in-place into extension bits */
+	    /* Add overflow in-place into extension bits.  A count for a
+	    ** whole scatter-gather list can carry more than once.
+	    */
 	    rh->rh_cs1 = (rh->rh_cs1 & ~(RH_XA17|RH_XA16))
-			| ((rh->rh_cs1 + RH_XA16) & (RH_XA17|RH_XA16));
+			| ((rh->rh_cs1 + (ba >> 16) * RH_XA16)
+				& (RH_XA17|RH_XA16));
 	    ba &= MASK16;
 	}
 	rh->rh_ba = ba;
@@ -850,7 +858,7 @@ rh11_iobuf(struct device *drv,
 	    wc = -wc;			/* Make positive */
 	} else if (rh->rh_dcrev)
 		panic("rh11_iobuf: Pos wc for rev xfer!");
-	if (wc > rh->rh_dcwcnt)		/* Verify not too big */
+	if (wc > (int)((-(rh->rh_wc | ~MASK16))>>1))	/* Verify not too big */
 	    panic("rh11_iobuf: drive overran chan!");
 
 	rh->rh_wc = (rh->rh_wc + (wc << 1)) & MASK16;	/* Add to 11-wd cnt */
@@ -885,6 +893,61 @@ rh11_iobuf(struct device *drv,
 }
 
 
+/* RH11_IOSGL - Called by drive to get a scatter-gather list for as much
+**	of the transfer as possible, up to MAXWC words, without advancing
+**	it.  The current segment already covers all the Unibus map pages
+**	that are contiguous in memory; this goes on through the rest of
+**	the map, merging pages where it can.
+**	Returns # segments in list, 0 if none.
+*/
+static int
+rh11_iosgl(struct device *drv,
+	   long maxwc,
+	   register struct dviosg_s *sg,
+	   int nsg)
+{
+    register struct rh11 *rh = (struct rh11 *)(drv->dv_ctlr);
+    register int wc, n;
+    register paddr_t mem;
+    register h10_t map;
+    register unsigned pagno, pagoff;
+    struct ubctl *ub = rh->rh_dv.dv_uba;
+    long left;
+    vmptr_t vp;
+
+    if (!rh->rh_dcwcnt || rh->rh_dcrev)
+	return 0;
+
+    /* Find remaining word count, and bus word address after current seg */
+    left = (-(rh->rh_wc | ~MASK16))>>1;
+    if (left > maxwc)
+	left = maxwc;
+    mem = ((rh->rh_ba | ((paddr_t)(rh->rh_cs1 & (RH_XA17|RH_XA16)) << 8))
+		>> 2) + rh->rh_dcwcnt;
+
+    wc = (rh->rh_dcwcnt < left) ? rh->rh_dcwcnt : left;
+    sg[0].sg_vp = vm_physmap(rh->rh_dcbuf);
+    sg[0].sg_wc = wc;
+    for (n = 1; (left -= wc) > 0; mem += wc) {
+	pagno = (mem>>9);
+	pagoff = mem & 0777;
+	if (pagno >= UBA_UBALEN || !((map = ub->ubpmap[pagno]) & UBA_QVAL))
+	    break;			/* Let iobuf report the map error */
+	wc = 01000 - pagoff;		/* Rest of this page */
+	if (wc > left)
+	    wc = left;
+	vp = vm_physmap(((paddr_t)(map & UBA_QPAG) << 9) | pagoff);
+	if (sg[n-1].sg_vp + sg[n-1].sg_wc == vp)
+	    sg[n-1].sg_wc += wc;	/* Contiguous, merge with last */
+	else if (n < nsg) {
+	    sg[n].sg_vp = vp;
+	    sg[n++].sg_wc = wc;
+	} else
+	    break;			/* List full */
+    }
+    return n;
+}
+
 
 /* RH11_IOEND - Called by drive when I/O finished, terminate data channel
 **	I/O xfer.  Assumes that rh11_iobuf has been called to update
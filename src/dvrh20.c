@@ -119,6 +119,8 @@ static void rh20_drerr(struct device *drv);
 static int  rh20_iobeg(struct device *drv, int wflg);
 static int  rh20_iobuf(struct device *drv, register int wc, vmptr_t *avp);
 static void rh20_ioend(struct device *drv, int bc);
+static int  rh20_iosgl(struct device *drv, long maxwc,
+		       struct dviosg_s *sg, int nsg);
 
 /* Completely internal functions */
 
@@ -185,6 +187,7 @@ rh20_bind(struct device *d,		/* Our device (controller) */
     slv->dv_iobeg = rh20_iobeg;	/* IO xfer beg */
     slv->dv_iobuf = rh20_iobuf;	/* IO xfer buffer setup */
     slv->dv_ioend = rh20_ioend;	/* IO xfer end */
+    slv->dv_iosgl = rh20_iosgl;	/* IO xfer scatter-gather list */
 
     rh->rh_drive[num] = slv;
 
@@ -902,6 +905,8 @@ rh20_iobeg(struct device *drv, int wflg)
 **	Caller must provide # of words used from the last call (0 if none).
 **	In particular, final transfer MUST invoke this to tell the channel
 **	how many words were actually used.
+**	The # of words may run past the current CCW if the drive used a
+**	scatter-gather list from rh20_iosgl.
 **
 **	If returns 0, no data or space left.
 **	If returns +, OK, *avp NULL if skipping, else vmptr to mem.
@@ -928,10 +933,7 @@ rh20_iobuf(struct device *drv,
 
     if (wc) {
 	/* If drive is updating our IO xfer status, do it. */
-
-	/* Update buffer pointer, assuming wc has correct direction sign */
-	if (rh->rh_dcbuf)
-	    rh->rh_dcbuf += wc;
+	register int n;
 
 	if (wc < 0) {			/* Verify direction consistent */
 	    if (!rh->rh_dcrev)
@@ -940,19 +942,30 @@ rh20_iobuf(struct device *drv,
 	} else if (rh->rh_dcrev)
 		panic("rh20_iobuf: Pos wc for rev xfer!");
 
-	if ((rh->rh_dcwcnt -= wc) < 0)	/* Update remaining wd cnt */
-	    panic("rh20_iobuf: drive overran chan!");
+	for (;;) {
+	    n = (wc < rh->rh_dcwcnt) ? wc : rh->rh_dcwcnt;
 
-	/* See if word count ran out */
-	if (rh->rh_dcwcnt == 0) {
-	    /* Yep, was this the last cmd (halt or last xfer?)
-	    ** If not, try to get another data xfer CCW.
-	    */
-	    if (rh->rh_dchlt || !rhdc_ccwget(rh)) {
-	        if (RHDEBUG(rh))
-		    fprintf(RHDBF(rh), "0]\r\n");
-		return 0;		/* Done, or no more */
+	    /* Update buffer pointer in direction of xfer */
+	    if (rh->rh_dcbuf)
+		rh->rh_dcbuf += (rh->rh_dcrev ? -n : n);
+	    rh->rh_dcwcnt -= n;		/* Update remaining wd cnt */
+	    wc -= n;
+
+	    /* See if word count ran out */
+	    if (rh->rh_dcwcnt == 0) {
+		/* Yep, was this the last cmd (halt or last xfer?)
+		** If not, try to get another data xfer CCW.
+		*/
+		if (rh->rh_dchlt || !rhdc_ccwget(rh)) {
+		    if (wc)
+			panic("rh20_iobuf: drive overran chan!");
+		    if (RHDEBUG(rh))
+			fprintf(RHDBF(rh), "0]\r\n");
+		    return 0;		/* Done, or no more */
+		}
 	    }
+	    if (!wc)
+		break;
 	}
     }
 
@@ -983,6 +996,69 @@ rh20_iobuf(struct device *drv,
 }
 
 
+/* RH20_IOSGL - Called by drive to get a scatter-gather list for as much
+**	of the transfer as the channel can see, up to MAXWC words, without
+**	advancing the channel.  Reads ahead in the command list, merging
+**	buffers that are contiguous in memory.  Only plain forward
+**	transfers are listed; the list stops before a reverse or skip/fill
+**	CCW, which the drive must do with rh20_iobuf as usual.
+**	Returns # segments in list, 0 if the current CCW can't be listed.
+*/
+static int
+rh20_iosgl(struct device *drv,
+	   long maxwc,
+	   register struct dviosg_s *sg,
+	   int nsg)
+{
+    register struct rh20 *rh = (struct rh20 *)(drv->dv_ctlr);
+    register w10_t w;
+    register int wc, n = 0;
+    paddr_t pa, clp;
+    int hlt, njmp;
+    vmptr_t vp;
+
+    if (!rh->rh_dcwcnt || rh->rh_dcrev || !rh->rh_dcbuf)
+	return 0;
+    pa = rh->rh_dcbuf;
+    wc = rh->rh_dcwcnt;
+    hlt = rh->rh_dchlt;
+    clp = rh->rh_clp;
+    for (;;) {
+	if (wc > maxwc)
+	    wc = maxwc;
+	vp = vm_physmap(pa);
+	if (n && (sg[n-1].sg_vp + sg[n-1].sg_wc == vp))
+	    sg[n-1].sg_wc += wc;	/* Contiguous, merge with last */
+	else if (n < nsg) {
+	    sg[n].sg_vp = vp;
+	    sg[n++].sg_wc = wc;
+	} else
+	    break;			/* List full */
+	if ((maxwc -= wc) <= 0 || hlt)
+	    break;
+
+	/* Peek at next CCW, following any jumps (but not forever) */
+	for (njmp = 0; ; ) {
+	    w = vm_pget(vm_physmap(clp));
+	    if ((LHGET(w) & CCW_OP) != CCW_JMP || ++njmp > 8)
+		break;
+	    clp = W10_U32(w) & MASK22;
+	}
+	switch (LHGET(w) & CCW_OP) {
+	case CCW_XFR:		hlt = FALSE;	break;
+	case CCW_XFR|CCW_XHLT:	hlt = TRUE;	break;
+	default:
+	    return n;		/* Halt, reverse, or a jump loop */
+	}
+	pa = W10_U32(w) & MASK22;
+	wc = (LHGET(w) & CCW_CNT) >> (22-18);
+	if (!pa || !wc)
+	    break;		/* Skip/fill or empty, let iobuf do it */
+	clp = (clp + 1) & MASK22;
+    }
+    return n;
+}
+
 
 /* RH20_IOEND - Called by drive when I/O finished, terminate data channel
 **	I/O xfer.  Assumes that rh20_iobuf has been called to update
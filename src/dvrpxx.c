@@ -83,6 +83,12 @@ int rp_format = VDK_FMT_RAW;	/* VDK_DFxxx value */
 # define DPRP_MAXRECSIZ (sizeof(w10_t)*128*DPRP_NSECS_MAX)
 #endif
 
+#if KLH10_DEV_DPRPXX	/* Max # segments in a scatter-gather xfer */
+# define RP_SGMAX DPRP_SGMAX
+#else
+# define RP_SGMAX 32
+#endif
+
 /* Disk type configuration params.
 **	All of these numbers assume drives using 18-bit formatting.
 **	(16-bit formatting has more sectors per track)
@@ -145,6 +151,10 @@ struct rpdev {
     int rp_isdyn;		/* TRUE if dynamically sized */
     int rp_fmt;			/* Data format on real disk, VDK_FMT_xxx */
     int rp_iswrite;		/* TRUE if writable, else RO */
+    int rp_mmap;		/* TRUE to map RAW pack into memory */
+    int rp_msync;		/* When to msync it, VDK_MSYNC_xxx */
+    int rp_csize;		/* # sectors to cache, 0 = none */
+    int rp_cwback;		/* TRUE to write back cached sectors */
 
     /* I/O transfer vars, updated to track progress */
     int rp_blkcnt;		/* # sectors in total transfer */
@@ -156,6 +166,8 @@ struct rpdev {
     long rp_blkadr;		/* Disk loc as a sector number */
     int rp_isdirect;		/* TRUE if current xfer is direct */
     vmptr_t rp_xfrvp;		/* If direct, holds ptr to 10-mem */
+    int rp_nsg;			/* # segments in rp_sgl */
+    struct dviosg_s rp_sgl[RP_SGMAX];	/* Scatter-gather list for xfer */
 
     int rp_bufwds;		/* Size of buffer in words */
     int rp_bufsec;		/* Size of buffer in sectors */
@@ -167,6 +179,8 @@ struct rpdev {
 #if KLH10_DEV_DPRPXX
     char *rp_dpname;		/* Pathname of executable subproc */
     int rp_dpdma;		/* TRUE to use DP DMA if possible */
+    int rp_dpthr;		/* TRUE to run DP as a thread (DP_XT_THCV) */
+    int rp_dpaio;		/* Max # writes DP thread may queue */
     struct dp_s rp_dp;		/* Handle on dev subprocess */
     struct dprpxx_s *rp_sdprp;	/* Ptr to shared memory segment */
 
@@ -200,6 +214,7 @@ static uint32 rpxx_rdreg(struct device *d, int reg);
 static int  rpxx_wrreg(struct device *d, int reg, dvureg_t val);
 static void rpxx_powoff(struct device *d);
 static int  rpxx_mount(struct device *d, FILE *f, char *path, char *argstr);
+static int  rpxx_status(struct device *d, FILE *f);
 
 /* Other exported vectors */
 
@@ -223,6 +238,8 @@ static void rp_ioend(struct rpdev *);
 static int rp_updxfr(struct rpdev *);
 static int rp_wrfilbuf(struct rpdev *);
 static int rp_rdflsbuf(struct rpdev *);
+static int rp_sglist(struct rpdev *, long);
+static void rp_sgxfr(struct rpdev *, int, int);
 static void rp_showbuf(struct rpdev *, unsigned char *, vmptr_t, int, int);
 
 #if KLH10_DEV_DPRPXX
@@ -244,10 +261,16 @@ static void rp_dpcmddon(struct rpdev *);
     prmdef(RPP_FMT,  "format"),	/* Pack format */\
     prmdef(RPP_RO,   "ro"),	/* Pack is Read-Only */\
     prmdef(RPP_RW,   "rw"),	/* Pack is Read/Write (default) */\
+    prmdef(RPP_MMAP, "mmap"),	/* Map RAW pack into memory (risky) */\
+    prmdef(RPP_MSYNC,"msync"),	/* When to msync mapped pack */\
+    prmdef(RPP_CACHE,"cache"),	/* # sectors to cache in memory */\
+    prmdef(RPP_CWB,  "cachewb"), /* True to write back cached sectors */\
     prmdef(RPP_BUF,  "bufsiz"),	/* Buffer size in words */\
     prmdef(RPP_IODLY,"iodly"),	/* Usec to delay I/O operations */\
     prmdef(RPP_DPDBG,"dpdebug"), /* Initial DP debug value */\
     prmdef(RPP_DMA,  "dpdma"),	/* True to use subproc DMA if possible */\
+    prmdef(RPP_THR,  "dpthread"), /* True to run DP as thread if possible */\
+    prmdef(RPP_AIO,  "dpaio"),	/* Max # writes DP thread may queue (risky) */\
     prmdef(RPP_DP,   "dppath")	/* Device subproc pathname */
 
 enum {
@@ -267,6 +290,10 @@ static char *rpprmtab[] = {
 static int partyp(struct rpdev *, char *);	/* Local parsing routines */
 static int parfmt(char *cp, int *afmt);
 
+static char *msynctab[] = {	/* Indexed by VDK_MSYNC_xxx */
+	"none", "async", "sync", NULL
+};
+
 /* RP_CONF - Parse configuration string and set defaults.
 **	At this point, device has just been created, but not yet bound
 **	or initialized.
@@ -285,6 +312,10 @@ rp_conf(FILE *f, char *s, struct rpdev *rp)
     DVDEBUG(rp) = FALSE;
     rp->rp_fmt = rp_format;		/* For now, use external default */
     rp->rp_iswrite = TRUE;
+    rp->rp_mmap = FALSE;
+    rp->rp_msync = VDK_MSYNC_NONE;
+    rp->rp_csize = 0;
+    rp->rp_cwback = FALSE;
     partyp(rp, DVRP_DEFAULT_DISK);	/* Default disk config */
     RPREG(rp, RHR_SN) =			/* Serial Number register (BCD) */
 		  (((1600 / 1000)%10) << 12)
@@ -306,6 +337,8 @@ rp_conf(FILE *f, char *s, struct rpdev *rp)
     rp->rp_dpdma = TRUE;		/* Default is DO use DMA if possible */
     rp->rp_dpname = "dprpxx";		/* Subproc executable */
     rp->rp_dpdbg = FALSE;
+    rp->rp_dpthr = KLH10_DEV_DPTHREADS;	/* Use thread if supported */
+    rp->rp_dpaio = 0;			/* but not queue writes */
 #endif
 
     prm_init(&prm, buff, sizeof(buff),
@@ -403,6 +436,42 @@ rp_conf(FILE *f, char *s, struct rpdev *rp)
 	    rp->rp_iswrite = TRUE;
 	    continue;
 
+	case RPP_MMAP:		/* Parse as true/false boolean */
+	    if (!prm.prm_val)	/* No arg => default to TRUE */
+		rp->rp_mmap = TRUE;
+	    else if (!s_tobool(prm.prm_val, &rp->rp_mmap))
+		break;
+	    continue;
+
+	case RPP_MSYNC:		/* Parse as msync policy string */
+	    if (!prm.prm_val)
+		break;
+	    for (i = 0; msynctab[i]; ++i)
+		if (s_match(prm.prm_val, msynctab[i]) == 2)
+		    break;
+	    if (!msynctab[i])
+		break;
+	    rp->rp_msync = i;		/* Index is VDK_MSYNC_xxx */
+	    continue;
+
+	case RPP_CACHE:		/* Parse as decimal number */
+	    if (!prm.prm_val || !s_todnum(prm.prm_val, &lval))
+		break;
+	    if ((lval < 0) || (lval > VDK_CACHEMAX)) {
+		fprintf(f, "RPXX cache size invalid: %ld (max %d)\n",
+				lval, VDK_CACHEMAX);
+		ret = FALSE;
+	    } else
+		rp->rp_csize = lval;
+	    continue;
+
+	case RPP_CWB:		/* Parse as true/false boolean */
+	    if (!prm.prm_val)	/* No arg => default to TRUE */
+		rp->rp_cwback = TRUE;
+	    else if (!s_tobool(prm.prm_val, &rp->rp_cwback))
+		break;
+	    continue;
+
 	case RPP_BUF:		/* Parse as decimal number */
 	    if (!prm.prm_val || !s_todnum(prm.prm_val, &lval))
 		break;
@@ -455,6 +524,28 @@ rp_conf(FILE *f, char *s, struct rpdev *rp)
 #endif
 	    continue;
 
+	case RPP_THR:		/* Parse as true/false boolean */
+#if KLH10_DEV_DPRPXX
+	    if (!prm.prm_val)
+		break;
+	    if (!s_tobool(prm.prm_val, &rp->rp_dpthr))
+		break;
+#endif
+	    continue;
+
+	case RPP_AIO:		/* Parse as decimal number */
+#if KLH10_DEV_DPRPXX
+	    if (!prm.prm_val || !s_todnum(prm.prm_val, &lval))
+		break;
+	    if ((lval < 0) || (lval > DPRP_AIOMAX)) {
+		fprintf(f, "RPXX DP write queue invalid: %ld (max %d)\n",
+				lval, DPRP_AIOMAX);
+		ret = FALSE;
+	    } else
+		rp->rp_dpaio = lval;
+#endif
+	    continue;
+
 	case RPP_DP:		/* Parse as simple string */
 #if KLH10_DEV_DPRPXX
 	    if (!prm.prm_val)
@@ -473,8 +564,11 @@ rp_conf(FILE *f, char *s, struct rpdev *rp)
 
     /* Param string all done, do followup checks or cleanup */
 #if KLH10_DEV_DPRPXX
-    if (!cpu.mm_shared)		/* If no shared 10 mem, */
-	rp->rp_dpdma = FALSE;	/* force no DMA. */
+# if !KLH10_DEV_DPTHREADS
+    rp->rp_dpthr = FALSE;	/* Can't do threads, force subproc */
+# endif
+    if (!cpu.mm_shared && !rp->rp_dpthr)	/* If no shared 10 mem, */
+	rp->rp_dpdma = FALSE;			/* force no DMA. */
 #endif
 
     /* Set default path for diskfile if none given */
@@ -619,6 +713,7 @@ dvrp_create(FILE *f, char *s)
     rp->rp_dv.dv_wrreg  = rpxx_wrreg;
     rp->rp_dv.dv_powoff = rpxx_powoff;
     rp->rp_dv.dv_mount  = rpxx_mount;
+    rp->rp_dv.dv_status = rpxx_status;
 
     /* Configure drive internals from parsed string and remember for
     ** setting up disk during init.
@@ -660,8 +755,10 @@ rpxx_init(struct device *d, FILE *of)
     rp->rp_state = RPXX_ST_OFF;
 
     if (!dp_init(&rp->rp_dp, sizeof(struct dprpxx_s),
-		DP_XT_MSIG, SIGUSR1, 0,				/* in fr dp */
-		DP_XT_MSIG, SIGUSR1,				/* out to dp */
+		(rp->rp_dpthr ? DP_XT_THCV : DP_XT_MSEM),
+			SIGUSR1, 0,					/* in fr dp */
+		(rp->rp_dpthr ? DP_XT_THCV : DP_XT_MSEM),
+			SIGUSR1,					/* out to dp */
 				(size_t)rp->rp_bufwds*sizeof(w10_t))) {
 	if (of) fprintf(of, "RPXX subproc init failed!\n");
 	return FALSE;
@@ -673,7 +770,14 @@ rpxx_init(struct device *d, FILE *of)
     /* Set up RPXX-specific part of shared DP memory */
     dprp = (struct dprpxx_s *) rp->rp_dp.dp_adr;
     rp->rp_sdprp = dprp;
-    if (rp->rp_dpdma) {			/* If have shared mem and want DMA, */
+    dprp->dprp_10mem = NULL;
+    dprp->dprp_10siz = 0;
+    if (rp->rp_dpdma && rp->rp_dpthr) {	/* Thread can use 10 mem directly */
+	dprp->dprp_shmid = 0;
+	dprp->dprp_10mem = cpu.physmem;
+	dprp->dprp_10siz = (unsigned long)PAG_SIZE * PAG_MAXPHYSPGS;
+	dprp->dprp_dma = TRUE;
+    } else if (rp->rp_dpdma) {		/* If have shared mem and want DMA, */
 	dprp->dprp_shmid = cpu.mm_physegid;	/* tell DP where it is */
 	dprp->dprp_dma = TRUE;
     } else {
@@ -681,11 +785,16 @@ rpxx_init(struct device *d, FILE *of)
 	dprp->dprp_dma = FALSE;
     }
     dprp->dprp_dpc.dpc_debug = rp->rp_dv.dv_debug;	/* Init debug flag */
+    dprp->dprp_aio = rp->rp_dpthr ? rp->rp_dpaio : 0;	/* Only if thread */
     if (cpu.mm_locked)				/* Lock DP mem if CPU is */
 	dprp->dprp_dpc.dpc_flags |= DPCF_MEMLOCK;
 
     /* Set up config vars */
     dprp->dprp_fmt = rp->rp_fmt;
+    dprp->dprp_mmap = rp->rp_mmap;
+    dprp->dprp_msync = rp->rp_msync;
+    dprp->dprp_csize = rp->rp_csize;
+    dprp->dprp_cwback = rp->rp_cwback;
     strncpy(dprp->dprp_devname, rp->rp_dcf.dcf_name,
 			sizeof(dprp->dprp_devname)-1);
     dprp->dprp_ncyl = rp->rp_dcf.dcf_ncyl;
@@ -734,6 +843,12 @@ rpxx_init(struct device *d, FILE *of)
     rp->rp_vdk.dk_ntrks = rp->rp_dcf.dcf_ntrk;
     rp->rp_vdk.dk_nsecs = rp->rp_dcf.dcf_nsec;
     rp->rp_vdk.dk_nwds = rp->rp_dcf.dcf_nwds;
+    rp->rp_vdk.dk_mmap = rp->rp_mmap;
+    rp->rp_vdk.dk_msync = rp->rp_msync;
+#if VDK_CACHE
+    rp->rp_vdk.dk_csize = rp->rp_csize;
+    rp->rp_vdk.dk_cwback = rp->rp_cwback;
+#endif
 
 #endif
 
@@ -789,8 +904,18 @@ rpxx_powoff(struct device *d)
 
     /* Later could add stuff to pretend controller/slave is off, but for
     ** now it suffices just to clean up.
+    ** Writes held in a write-back cache must reach the disk first; a DP
+    ** does that when told to unload the pack.
     */
 #if KLH10_DEV_DPRPXX
+    if (rp->rp_csize && rp->rp_cwback && rp->rp_state != RPXX_ST_OFF) {
+	register struct dpx_s *dpx = &(rp->rp_dp.dp_adr->dpc_todp);
+
+	if (dp_xswait(dpx)) {		/* Wait for any command to finish */
+	    dp_xsend(dpx, DPRP_UNL, (size_t)0);
+	    dp_xswait(dpx);
+	}
+    }
     (*rp->rp_dv.dv_evreg)(	/* Flush all event handlers for device */
 		(struct device *)rp,
 		NULL,		/* No event handler proc */
@@ -800,6 +925,8 @@ rpxx_powoff(struct device *d)
     rp->rp_state = RPXX_ST_OFF;
     rp->rp_sdprp = NULL;	/* Clear pointers no longer meaningful */
     rp->rp_buff = NULL;
+#else
+    (void) vdk_flush(&rp->rp_vdk);
 #endif
 }
 
@@ -969,6 +1096,44 @@ rpxx_mount(struct device *d,
     return res;
 }
 
+/* RPXX_STATUS - Show pack and sector cache status
+*/
+static int
+rpxx_status(struct device *d, FILE *f)
+{
+    register struct rpdev *rp = (struct rpdev *)d;
+    unsigned long hits, miss, wrbk;
+
+    (void) rpxx_mount(d, f, "", (char *)NULL);	/* Pack status */
+
+    if (!rp->rp_csize) {
+	fprintf(f, "No sector cache.\n");
+	return TRUE;
+    }
+#if KLH10_DEV_DPRPXX
+    if (!rp->rp_sdprp) {
+	fprintf(f, "Sector cache not active.\n");
+	return TRUE;
+    }
+    hits = rp->rp_sdprp->dprp_chits;
+    miss = rp->rp_sdprp->dprp_cmiss;
+    wrbk = rp->rp_sdprp->dprp_cwrbk;
+#elif VDK_CACHE
+    hits = rp->rp_vdk.dk_chits;
+    miss = rp->rp_vdk.dk_cmiss;
+    wrbk = rp->rp_vdk.dk_cwrbk;
+#else
+    hits = miss = wrbk = 0;
+#endif
+    fprintf(f, "Sector cache: %d sectors, write-%s\n", rp->rp_csize,
+			(rp->rp_cwback ? "back" : "through"));
+    fprintf(f, "  Reads: %lu hits, %lu misses (%lu%% hits)\n", hits, miss,
+			((hits + miss) ? (hits * 100) / (hits + miss) : 0));
+    if (rp->rp_cwback)
+	fprintf(f, "  Dirty sectors written back: %lu\n", wrbk);
+    return TRUE;
+}
+
 static int
 rp_xmount(register struct rpdev *rp)
 {
@@ -1096,7 +1261,13 @@ rp_dpstart(register struct rpdev *rp)
     if (DVDEBUG(rp))
 	fprintf(DVDBF(rp), "[rp_dpstart: Starting DP \"%s\"...",
 				rp->rp_dpname);
+#if KLH10_DEV_DPTHREADS
+    if (rp->rp_dpthr
+      ? !dp_thstart(&rp->rp_dp, "dprpxx", dprpxx_main)
+      : !dp_start(&rp->rp_dp, rp->rp_dpname)) {
+#else
     if (!dp_start(&rp->rp_dp, rp->rp_dpname)) {
+#endif
 	if (DVDEBUG(rp))
 	    fprintf(DVDBF(rp), " failed!]\r\n");
 	else
@@ -1715,6 +1886,7 @@ rp_ioxfr(register struct rpdev *rp, int wrtf)
 
     rp->rp_xfrcnt = 0;		/* Init # of subtransfers */
     rp->rp_isdirect = FALSE;	/* Not direct xfer (yet) */
+    rp->rp_nsg = 0;		/* No scatter-gather list (yet) */
     if (wrtf) {
 	rp->rp_scmd = RH_MWRT;
 #if KLH10_DEV_DPRPXX
@@ -1877,7 +2049,12 @@ rp_wrfilbuf(register struct rpdev *rp)
     if (wc > rp->rp_dcf.dcf_nwds) {
 #endif
 	/* Direct!  At least one sector's worth.
+	** Do all of it at once if channel has a list of buffers.
 	*/
+	if ((totw = rp_sglist(rp, rp->rp_blklim))) {
+	    rp_sgxfr(rp, TRUE, (int)totw);
+	    return 1;
+	}
 	totw = (wc < rp->rp_blklim)		/* Truncate if needed */
 			? wc : rp->rp_blklim;
 	wc = (totw / rp->rp_dcf.dcf_nwds);	/* Find # sectors */
@@ -2042,7 +2219,8 @@ rp_rdflsbuf(register struct rpdev *rp)
 	    ** Can simply update channel vars.
 	    */
 	    if (DVDEBUG(rp) & DVDBF_DATSHO)
-		rp_showbuf(rp, (unsigned char *)NULL, rp->rp_xfrvp, (int)totw, 0);
+		rp_showbuf(rp, (unsigned char *)NULL, rp->rp_xfrvp,
+			   (rp->rp_nsg ? rp->rp_sgl[0].sg_wc : (int)totw), 0);
 	    wc = (*rp->rp_dv.dv_iobuf)(&rp->rp_dv, (int)totw, &vp);
 
 	} else {
@@ -2122,7 +2300,13 @@ rp_rdflsbuf(register struct rpdev *rp)
 	&& rp->rp_dpdma
 #endif
 					) {
-	/* Yup, at least one sector's worth. */
+	/* Yup, at least one sector's worth.
+	** Do all of it at once if channel has a list of buffers.
+	*/
+	if ((totw = rp_sglist(rp, bwcnt))) {
+	    rp_sgxfr(rp, FALSE, (int)totw);
+	    return 1;
+	}
 	rp->rp_isdirect = TRUE;
 	wc = (wc < bwcnt) ? wc : bwcnt;		/* Truncate if needed */
 	wc = (wc / rp->rp_dcf.dcf_nwds);	/* Find # sectors */
@@ -2169,6 +2353,99 @@ rp_rdflsbuf(register struct rpdev *rp)
     return 1;	
 }
 
+/* RP_SGLIST - See whether the channel can describe more than one buffer
+**	of the current transfer at once.  Builds rp_sgl from the controller's
+**	scatter-gather list, keeping only whole sectors; a segment that
+**	doesn't end on a sector boundary is truncated and ends the list,
+**	since the next sector would straddle two buffers.
+**	Returns # sectors the list covers, or 0 if it is no better than the
+**	single buffer the caller already has.
+*/
+static int
+rp_sglist(register struct rpdev *rp,
+	  long maxw)
+{
+    register int i, n, nsec, totsec;
+    register int nwds = rp->rp_dcf.dcf_nwds;
+
+    rp->rp_nsg = 0;
+    n = (*rp->rp_dv.dv_iosgl)(&rp->rp_dv, maxw, rp->rp_sgl, RP_SGMAX);
+    for (i = totsec = 0; i < n; ++i) {
+	if ((nsec = rp->rp_sgl[i].sg_wc / nwds) == 0)
+	    break;
+	totsec += nsec;
+	if (rp->rp_sgl[i].sg_wc != nsec * nwds) {
+	    rp->rp_sgl[i++].sg_wc = nsec * nwds;
+	    break;
+	}
+    }
+    if (i < 2)
+	return 0;
+    rp->rp_nsg = i;
+    return totsec;
+}
+
+/* RP_SGXFR - Start a direct transfer of NSEC sectors using the list
+**	set up by rp_sglist.  Completion is handled exactly as for a
+**	single-buffer direct transfer; the channel's iobuf routine accepts
+**	a count that spans several of its buffers.
+*/
+static void
+rp_sgxfr(register struct rpdev *rp,
+	 int wflg,
+	 int nsec)
+{
+    register int i;
+
+    rp->rp_isdirect = TRUE;
+    rp->rp_xfrvp = rp->rp_sgl[0].sg_vp;
+
+    if (DVDEBUG(rp))
+	for (i = 0; i < rp->rp_nsg; ++i)
+	    fprintf(DVDBF(rp), "[RP %ssgl: %d sec, %ld %s %#lo (seg %d/%d)]\r\n",
+			(wflg ? "wr" : "rd"),
+			rp->rp_sgl[i].sg_wc / rp->rp_dcf.dcf_nwds,
+			(long)rp->rp_blkadr, (wflg ? "<-" : "->"),
+			(long)(rp->rp_sgl[i].sg_vp - vm_physmap(0)),
+			i+1, rp->rp_nsg);
+
+#if KLH10_DEV_DPRPXX
+    for (i = 0; i < rp->rp_nsg; ++i) {
+	rp->rp_sdprp->dprp_sgl[i].sg_phyadr =
+				rp->rp_sgl[i].sg_vp - vm_physmap(0);
+	rp->rp_sdprp->dprp_sgl[i].sg_nsec =
+				rp->rp_sgl[i].sg_wc / rp->rp_dcf.dcf_nwds;
+    }
+    rp->rp_sdprp->dprp_nsg = rp->rp_nsg;
+    rp->rp_sdprp->dprp_scnt = nsec;
+    rp->rp_sdprp->dprp_daddr = rp->rp_blkadr;
+    rp_dpcmd(rp, (wflg ? DPRP_WRSGL : DPRP_RDSGL), (size_t)0);
+#else
+    {
+	register int n, res;
+	uint32 daddr = (uint32)rp->rp_blkadr;
+
+	rp->rp_rescnt = 0;
+	for (i = 0; i < rp->rp_nsg; ++i) {
+	    n = rp->rp_sgl[i].sg_wc / rp->rp_dcf.dcf_nwds;
+	    res = (wflg ? vdk_write(&rp->rp_vdk, rp->rp_sgl[i].sg_vp, daddr, n)
+			: vdk_read(&rp->rp_vdk, rp->rp_sgl[i].sg_vp, daddr, n));
+	    rp->rp_rescnt += res;
+	    daddr += res;
+	    if ((rp->rp_reserr = rp->rp_vdk.dk_err) || res != n)
+		break;
+	}
+
+	/* Check for error -- if ran out of space, go offline! */
+	if (wflg && rp->rp_reserr == ENOSPC) {
+	    vdk_unmount(&(rp->rp_vdk));		/* Take offline */
+	    RPREG(rp, RHR_ER1) |= RH_1UNS;	/* Unsafe */
+	    RPREG(rp, RHR_STS) |= RH_SERR;	/* Error summary */
+	}
+    }
+#endif
+}
+
 
 static void
 rp_showbuf(register struct rpdev *rp,
@@ -363,6 +363,102 @@ cbpget(register struct canbp *bp, register vaddr_t e, int inc)
     return TRUE;
 }
 #endif /* KLH10_USE_CANBP */
+
+#if KLH10_BPCACHE
+
+/* BPC_STEP - ILDB/IDPB fast path using the BP stream cache.
+**	If the BP at E is the one cached and nothing has changed, increments
+**	it in memory exactly as IBP would and returns the physical location
+**	of the byte's word, with P and S set.  Returns NULL if the normal
+**	code must be used, in which case nothing has been changed.
+**	Moving to the next word stays in the cache only if that word is
+**	in the same page; otherwise the normal code re-maps it.
+*/
+static vmptr_t
+bpc_step(register vaddr_t e,
+	 pment_t acc,		/* VMF_READ or VMF_WRITE */
+	 int *pp, int *sp)
+{
+    register struct bpcent *bc = BPCACHE_ENT(e);
+    register vmptr_t vp, dvp;
+    register w10_t w;
+    register int p, s;
+
+    if (!bc->bc_bpvp
+      || bc->bc_e != e
+      || !(bc->bc_acc & acc)
+      || bc->bc_map != cpu.vmap.xbrw
+      || bc->bc_gen != pag_mapgen(bc->bc_map)
+      || cpu.mr_inpxct || PCFTEST(PCF_FPD)
+#if KLH10_CPU_KL
+      || cpu.mr_abk_pagno != (pagno_t)-1
+#endif
+	)
+	return NULL;
+
+    vp = vm_modmap(e);			/* Get pointer to BP, may pagefail */
+    w = vm_pget(vp);
+    if (vp != bc->bc_bpvp || op10m_camn(w, bc->bc_bp))
+	return NULL;
+
+    p = LHGET(w) >> 12;			/* P in high 6 bits */
+    s = (LHGET(w) >> 6) & 077;		/* S in next 6 */
+    dvp = bc->bc_vp;
+    if ((p -= s) < 0) {			/* Find new P */
+	if (!((RHGET(w)+1) & PAG_MASK))	/* Next word in new page? */
+	    return NULL;		/* Yes, let normal code map it */
+	p = (W10BITS - s) & 077;	/* Moving to next word */
+	RHSET(w, RHGET(w)+1);
+	++dvp;
+    }
+    op10m_tlz(w, 0770000);		/* Put back new P */
+    op10m_tlo(w, ((h10_t)(p) << 12));
+    vm_pset(vp, w);			/* Store updated BP */
+    bc->bc_bp = w;
+    bc->bc_vp = dvp;
+    *pp = p;
+    *sp = s;
+    return dvp;
+}
+
+/* BPC_FILL - Enter BP at E in the BP stream cache, after a normal
+**	ILDB/IDPB has successfully used it (so no mapping below can fail).
+*/
+static void
+bpc_fill(register vaddr_t e,
+	 pment_t acc)		/* VMF_READ or VMF_WRITE */
+{
+    register struct bpcent *bc = BPCACHE_ENT(e);
+    register vmptr_t vp;
+    register w10_t w;
+    vaddr_t y;
+
+    bc->bc_bpvp = NULL;			/* Assume can't cache */
+    if (cpu.mr_inpxct)
+	return;
+    if (!(vp = vm_xrwmap(e, VMF_WRITE|VMF_NOTRAP)))
+	return;
+    w = vm_pget(vp);
+    if ((LHGET(w) & 077)		/* No I, X, or 2-word flag */
+      || (LHGET(w) >> 12) > W10BITS	/* No OWGBP or odd P */
+      || !(RHGET(w) & (H10MASK & ~AC_MASK)))	/* No AC ref */
+	return;
+#if KLH10_EXTADR
+    y = va_Vmake(VAF_LOCAL, va_sect(e), RHGET(w));
+#else
+    va_lmake(y, 0, RHGET(w));
+#endif
+    if (!(bc->bc_vp = vm_xbrwmap(y, acc|VMF_NOTRAP)))
+	return;
+    bc->bc_e = e;
+    bc->bc_bp = w;
+    bc->bc_map = cpu.vmap.xbrw;
+    bc->bc_gen = pag_mapgen(bc->bc_map);
+    bc->bc_acc = acc;
+    bc->bc_bpvp = vp;
+}
+#endif /* KLH10_BPCACHE */
+
 
 insdef(i_adjbp);	/* Forward decl for adjbp */
 
@@ -402,9 +498,11 @@ insdef(i_ibp)
 insdef(i_ldb)
 {
 # define LDBMACRO(p, s, y) \
+	LDBVPMACRO(p, s, vm_xbrwmap(y, VMF_READ))  /* Fetch word (byte map) */
+# define LDBVPMACRO(p, s, vp) \
   {			\
     register w10_t w;	\
-    w = vm_pget(vm_xbrwmap(y, VMF_READ));	/* Fetch word (byte map) */\
+    w = vm_pget(vp);		/* Fetch word */\
     op10m_rshift(w, p);		/* Shift word to right-align byte */\
     op10m_and(w, wbytemask[s]);	/* Mask out byte */\
     ac_set(ac, w);		/* Store byte in AC */\
@@ -432,6 +530,18 @@ insdef(i_ldb)
 
 insdef(i_ildb)
 {
+#if KLH10_BPCACHE
+  {
+    register vmptr_t bvp;
+    int p, s;
+
+    if ((bvp = bpc_step(e, VMF_READ, &p, &s))) {	/* Try cache first */
+	LDBVPMACRO(p, s, bvp)
+	return PCINC_1;
+    }
+  }
+#endif
+  {
 #if KLH10_USE_CANBP
     struct canbp cbp;
 
@@ -458,7 +568,11 @@ insdef(i_ildb)
     }
 #endif
 
+  }
     PCFCLEAR(PCF_FPD);		/* Won, clear flag */
+#if KLH10_BPCACHE
+    bpc_fill(e, VMF_READ);	/* Remember for next ILDB */
+#endif
     return PCINC_1;
 }
 
@@ -466,12 +580,14 @@ insdef(i_ildb)
 insdef(i_dpb)
 {
 #define DPBMACRO(p, s, y) \
+	DPBVPMACRO(p, s, vm_xbrwmap(y, VMF_WRITE)) /* Use special byte map */
+#define DPBVPMACRO(p, s, vp) \
   {		\
     register w10_t w;		\
     register w10_t bmask, byte;	\
     register vmptr_t bvp;	\
 				\
-    bvp = vm_xbrwmap(y, VMF_WRITE);	/* Use special byte data map */\
+    bvp = (vp);			/* Find dest word */\
     byte = ac_get(ac);		/* Fetch source byte */\
     bmask = wbytemask[s];	/* Get & shift byte-sized mask */\
     op10m_lshift(bmask, p);	\
@@ -506,6 +622,18 @@ insdef(i_dpb)
 
 insdef(i_idpb)
 {
+#if KLH10_BPCACHE
+  {
+    register vmptr_t dvp;
+    int p, s;
+
+    if ((dvp = bpc_step(e, VMF_WRITE, &p, &s))) {	/* Try cache first */
+	DPBVPMACRO(p, s, dvp)
+	return PCINC_1;
+    }
+  }
+#endif
+  {
 #if KLH10_USE_CANBP
     struct canbp cbp;
 
@@ -530,7 +658,11 @@ insdef(i_idpb)
       DPBMACRO(p, s, y)		/* Do the DPB from AC */
     }
 #endif
+  }
     PCFCLEAR(PCF_FPD);		/* Won, clear flag */
+#if KLH10_BPCACHE
+    bpc_fill(e, VMF_WRITE);	/* Remember for next IDPB */
+#endif
     return PCINC_1;
 }
 
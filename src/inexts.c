@@ -392,12 +392,12 @@ ac_32set(int ac, uint32 val)
 **	On the KS10 there is only section 0, so this always traps as a
 **	MUUO on that machine.  Assume single-section KL similar.
 **
-** This is a straightforward implementation and there are several
-** ways to optimize it:
-**	- Separate loops for forward and reverse BLTs
-**	- Test for 32-bit count and optimize in register
+** Separate loops are used for forward and reverse transfers, with the
+** count kept in a 32-bit register.  Each mapping is used for as many
+** words as stay within both the source and dest pages (see pag_blkspan),
+** so PI and page fails are only checked for at those boundaries.
+** Possible further optimization:
 **	- Test for src -> src+1 and avoid re-reading value if mappings same.
-**	- Test for within-mem-page BLTs and break into memcpy segments.
 **
 ** Note: for PXCT, source uses XBEA mapping, dest uses XBRW.
 **	These correspond to PXCT AC bits 11 and 12 respectively.
@@ -415,6 +415,7 @@ xinsdef(ix_xblt)
 {
     register vaddr_t src, dst;
     register vmptr_t svp, dvp;
+    register int32 n;
     w10_t wcnt, wsrc, wdst, wdone;
     enum xires res = RES_WON;
 
@@ -450,15 +451,19 @@ xinsdef(ix_xblt)
 		res = RES_PF;
 		break;
 	    }
-	    vm_pset(dvp, vm_pget(svp));	/* Transfer the word */
+	    n = pag_blkspan(src, dst, (cnt > PAG_SIZE ? PAG_SIZE : cnt), FALSE);
+	    if (n == 1)
+		vm_pset(dvp, vm_pget(svp));	/* Transfer the word */
+	    else
+		pag_blkmove(dvp, svp, n, FALSE);	/* or words */
 
-	    va_ginc(src);		/* Bump addrs up */
-	    va_ginc(dst);
-	    if (--cnt == 0)		/* Bump count down, see if done */
+	    va_gadd(src, n);		/* Bump addrs up */
+	    va_gadd(dst, n);
+	    if ((cnt -= n) == 0)	/* Bump count down, see if done */
 		break;			/* stop loop! */
 
 	    /* Done with one iteration, now check before doing next */
-	    CLOCKPOLL();		/* More left, keep clock going */
+	    CLOCKPOLLN(n);		/* More left, keep clock going */
 	    if (INSBRKTEST()) {		/* Watch for PI interrupt */
 		res = RES_PI;
 		break;
@@ -493,13 +498,20 @@ xinsdef(ix_xblt)
 		res = RES_PF;
 		break;
 	    }
-	    vm_pset(dvp, vm_pget(svp));	/* Transfer the word */
+	    n = pag_blkspan(src, dst, (-cnt > PAG_SIZE ? PAG_SIZE : -cnt), TRUE);
+	    if (n == 1)
+		vm_pset(dvp, vm_pget(svp));	/* Transfer the word */
+	    else {
+		pag_blkmove(dvp, svp, n, TRUE);	/* or words, going down */
+		va_gadd(src, -(n-1));		/* Addrs now at last word */
+		va_gadd(dst, -(n-1));
+	    }
 
-	    if (++cnt >= 0)		/* Bump count up; if gone, */
+	    if ((cnt += n) >= 0)	/* Bump count up; if gone, */
 		break;			/* stop loop! */
 
 	    /* Done with one iteration, now check before doing next */
-	    CLOCKPOLL();		/* More left, keep clock going */
+	    CLOCKPOLLN(n);		/* More left, keep clock going */
 	    if (INSBRKTEST()) {		/* Watch for PI interrupt */
 		res = RES_PI;
 		break;
@@ -1227,6 +1239,163 @@ xadjbp(register struct cleanbp *bp,
     return RES_OK;
 }
 
+/* Whole-word string fast paths.
+**	When two BPs have the same byte size and both are about to start
+** a new word, their bytes line up exactly, so MOVSLJ/MOVSRJ can move
+** (and CMPSx can compare) a word's worth of bytes at once.  Words are
+** handled a page span at a time (see pag_blkspan), mapping each page
+** only once.
+**	These are purely optimizations: any page fault or non-trivial case
+** simply stops the fast path early, leaving the remainder to the normal
+** byte-at-a-time code which will report any failure properly.  An
+** interrupt also stops it, after at least one span is done.
+**	Indirect BPs are not handled, since their byte EA must be
+** recomputed for every word.
+*/
+
+/* XBPWDOK - TRUE if BP is about to start a new word */
+#define xbpwdok(bp) ((bp)->p < (bp)->s || (bp)->p == W10BITS)
+
+/* XBPWDPAIR - TRUE if worth trying the word fast path for this BP pair */
+#define xbpwdpair(b1,b2) ((b1)->s == (b2)->s && xbpwdok(b1) && xbpwdok(b2) \
+			&& !(b1)->isindir && !(b2)->isindir)
+
+static void
+xbpwdset(register struct cleanbp *bp,
+	 int32 nwds,
+	 int bpw)
+{
+    /* Leave BP pointing at the last byte of the last word done.
+    ** If it was at the start of a word, Y was already the first word.
+    */
+    if (bp->p == W10BITS)
+	--nwds;
+    va_add(bp->y, nwds);
+    bp->ycnt += nwds;
+    bp->p = W10BITS - (bpw * bp->s);
+    bp->vp = NULL;		/* Cached word no longer valid */
+}
+
+/* XBPWMOVE - Move as many whole words of bytes as possible from s1 to s2,
+**	up to nbytes.  Returns # of bytes moved, 0 if none.
+**	Dest words are updated in ascending order with each source word
+**	read just before the dest word, so overlapping strings give the
+**	same result as moving one byte at a time.
+*/
+static int32
+xbpwmove(register struct cleanbp *s1,
+	 register struct cleanbp *s2,
+	 int32 nbytes)
+{
+    register vmptr_t svp, dvp;
+    register int32 i, n;
+    register w10_t w, dw, bmask;
+    vaddr_t y1, y2;
+    int32 nwds, done = 0;
+    int bpw;
+
+    if (s1->s <= 0 || s1->s > W10BITS)	/* Guard against bogus S */
+	return 0;
+    bpw = W10BITS / s1->s;
+    if ((nwds = nbytes / bpw) <= 0)
+	return 0;
+    bmask = wbytemask[bpw * s1->s];	/* Mask of all byte bits in word */
+    op10m_lshift(bmask, W10BITS - (bpw * s1->s));
+
+    y1 = s1->y;				/* Find first word of each */
+    if (s1->p < s1->s)
+	va_inc(y1);
+    y2 = s2->y;
+    if (s2->p < s2->s)
+	va_inc(y2);
+
+    do {
+	if (!(svp = vm_xbeamap(y1, VMF_READ|VMF_NOTRAP))
+	  || !(dvp = vm_xbrwmap(y2, VMF_WRITE|VMF_NOTRAP)))
+	    break;			/* Let byte code take the fault */
+	n = pag_blkspan(y1, y2, nwds, FALSE);
+	for (i = 0; i < n; ++i) {
+	    w = vm_pget(svp+i);
+	    op10m_and(w, bmask);
+	    dw = vm_pget(dvp+i);
+	    op10m_andcm(dw, bmask);	/* Keep any unused low bits */
+	    op10m_ior(dw, w);
+	    vm_pset(dvp+i, dw);
+	}
+	va_add(y1, n);
+	va_add(y2, n);
+	done += n;
+	CLOCKPOLLN(n * bpw);		/* Keep clock going */
+    } while ((nwds -= n) > 0 && !INSBRKTEST());
+
+    if (!done)
+	return 0;
+    xbpwdset(s1, done, bpw);
+    xbpwdset(s2, done, bpw);
+    return done * bpw;
+}
+
+/* XBPWCMP - Compare as many whole words of bytes as possible, up to
+**	nbytes.  Returns # of bytes found equal and passed over, 0 if none.
+**	Stops without passing the first word that differs, so the byte
+**	code can find the unequal byte.
+**	Both strings are sources, and use the XBEA map.
+*/
+static int32
+xbpwcmp(register struct cleanbp *s1,
+	register struct cleanbp *s2,
+	int32 nbytes)
+{
+    register vmptr_t vp1, vp2;
+    register int32 i, n;
+    register w10_t w1, w2, bmask;
+    vaddr_t y1, y2;
+    int32 nwds, done = 0;
+    int bpw;
+
+    if (s1->s <= 0 || s1->s > W10BITS)	/* Guard against bogus S */
+	return 0;
+    bpw = W10BITS / s1->s;
+    if ((nwds = nbytes / bpw) <= 0)
+	return 0;
+    bmask = wbytemask[bpw * s1->s];	/* Mask of all byte bits in word */
+    op10m_lshift(bmask, W10BITS - (bpw * s1->s));
+
+    y1 = s1->y;				/* Find first word of each */
+    if (s1->p < s1->s)
+	va_inc(y1);
+    y2 = s2->y;
+    if (s2->p < s2->s)
+	va_inc(y2);
+
+    do {
+	if (!(vp1 = vm_xbeamap(y1, VMF_READ|VMF_NOTRAP))
+	  || !(vp2 = vm_xbeamap(y2, VMF_READ|VMF_NOTRAP)))
+	    break;			/* Let byte code take the fault */
+	n = pag_blkspan(y1, y2, nwds, FALSE);
+	for (i = 0; i < n; ++i) {
+	    w1 = vm_pget(vp1+i);
+	    w2 = vm_pget(vp2+i);
+	    op10m_and(w1, bmask);
+	    op10m_and(w2, bmask);
+	    if (op10m_camn(w1, w2))
+		break;
+	}
+	va_add(y1, i);
+	va_add(y2, i);
+	done += i;
+	CLOCKPOLLN(i * bpw);		/* Keep clock going */
+	if (i < n)			/* Found a difference? */
+	    break;
+    } while ((nwds -= n) > 0 && !INSBRKTEST());
+
+    if (!done)
+	return 0;
+    xbpwdset(s1, done, bpw);
+    xbpwdset(s2, done, bpw);
+    return done * bpw;
+}
+
 /* MOVSLJ - Move String Left Justified		(EXTEND [016 ])
 **
 ** This is the only EXTEND string instruction legal for PXCTing (and only
@@ -1239,6 +1408,7 @@ xinsdef(ix_movslj)
     register int32 len1, len2;	/* Note signed */
     register vaddr_t va;
     struct cleanbp s1, s2;
+    register int32 n;
     w10_t wbyte;
     w10_t wfill;
     enum xires res = RES_TRUNC;
@@ -1277,14 +1447,18 @@ xinsdef(ix_movslj)
 	    break;	/* Return, either won or page-failed */
 	}
 
+	/* Try moving whole words; counts already include this byte */
+	if (xbpwdpair(&s1, &s2)
+	  && (n = xbpwmove(&s1, &s2, (len1 < len2 ? len1 : len2) + 1))) {
+	    len1 -= n-1, len2 -= n-1;
+
 	/* Fetch & store byte */
-	if (xildb(&s1, &wbyte)) {
+	} else if (xildb(&s1, &wbyte)) {
 	    /* Clean up and fail (normally page fail) */
 	    res = s1.err;
 	    ++len1, ++len2;	/* Back up */
 	    break;
-	}
-	if (xidpb(&s2, &wbyte)) {	/* Store byte */
+	} else if (xidpb(&s2, &wbyte)) {	/* Store byte */
 	    /* Clean up and page-fail */
 	    res = s2.err;
 	    xdecbp(&s1);		/* Back up source BP */
@@ -1575,6 +1749,7 @@ xinsdef(ix_movsrj)
     register int32 len1, len2;	/* Note signed */
     register vaddr_t va;
     struct cleanbp s1, s2;
+    register int32 n;
     w10_t wbyte;
     w10_t wfill;
     enum xires res = RES_OK;
@@ -1621,11 +1796,13 @@ xinsdef(ix_movsrj)
       && len2) {		/* and dest string still needs more stuff */
 	/* At this point, len1 == len2 and at least one byte to copy */
 	for (;;) {
-	    if (xildb(&s1, &wbyte)) {	/* Fetch byte! */
+	    if (xbpwdpair(&s1, &s2)	/* Try moving whole words */
+	      && (n = xbpwmove(&s1, &s2, len2))) {
+		len2 -= n-1;		/* Last byte counted below */
+	    } else if (xildb(&s1, &wbyte)) {	/* Fetch byte! */
 		res = s1.err;		/* Page-fail.  No backup needed */
 		break;
-	    }
-	    if (xidpb(&s2, &wbyte)) {	/* Store byte! */
+	    } else if (xidpb(&s2, &wbyte)) {	/* Store byte! */
 		res = s2.err;
 		xdecbp(&s1);		/* Page-fail, must back up source BP */
 		break;
@@ -1697,6 +1874,7 @@ xinsdef(ix_cmps)		/* Do all CMPSx instructions */
     register w10_t fill;
     enum xires res = RES_OK;
     register int cmpf;
+    register int32 n;
 
     /* Set up string lengths. */
     AC_32GET(len1, ac, 0, 0777000);	/* Get source len */
@@ -1732,6 +1910,11 @@ xinsdef(ix_cmps)		/* Do all CMPSx instructions */
     /* Loop until pagefail, interrupt, bytes not equal, or count out */
     cmpf = CMPF_EQ;			/* Default if count out is equal */
     for (;;) {
+	if (len1 > 0 && len2 > 0	/* Try skipping equal words */
+	  && xbpwdpair(&s1, &s2)
+	  && (n = xbpwcmp(&s1, &s2, (len1 < len2 ? len1 : len2)))) {
+	    len1 -= n, len2 -= n;
+	}
 	if (--len1 >= 0) {		/* Get byte from string 1 */
 	    if (xildb(&s1, &w1)) {
 		res = s1.err;
@@ -333,6 +333,10 @@ insdef(i_dmovnm)		/* DMOVNM AC,E */
 /* BLT - with optimization for case where dest is source+1.
 **	Note test for using same mapping, since BLT can be used for
 **	transfers between user and exec maps!
+**	Words are moved a page span at a time (see pag_blkspan), so
+**	source and dest are mapped only once per page.  Interrupts and
+**	page faults are thus only noticed at span boundaries, which is
+**	fine as the AC is always left describing the next word to move.
 */
 
 /* Note special page map context references for BLT.
@@ -395,6 +399,7 @@ insdef(i_blt)
     register int32 cnt;		/* Note signed */
     register vaddr_t src, dst;
     register vmptr_t vp;
+    register int32 n, i;
 
 #if KLH10_EXTADR
     src = dst = e;			/* E sets default section & l/g flag */
@@ -467,8 +472,10 @@ insdef(i_blt)
 	}
 	w = vm_pget(vp);		/* Get word, remember it */
 
+	/* Fill as much of the dest page as possible per mapping.
+	** Interrupts are checked once per chunk.
+	*/
 	do {
-	    CLOCKPOLL();		/* Keep clock going */
 	    if (INSBRKTEST()) {		/* Watch for interrupt */
 		ac_setlrh(ac, va_insect(src),	/* Oops, save AC */
 			      va_insect(dst));
@@ -479,16 +486,18 @@ insdef(i_blt)
 			      va_insect(dst));
 		pag_fail();			/* Take page-fail trap */
 	    }
-	    vm_pset(vp, w);		/* Store word value */
-	    va_linc(src);		/* Do LOCAL increment of addrs! */
-	    va_linc(dst);
-	} while (--cnt >= 0);
+	    n = pag_blkspan(dst, dst, cnt+1, FALSE);
+	    for (i = 0; i < n; ++i)
+		vm_pset(vp+i, w);	/* Store word value */
+	    va_ladd(src, n);		/* Do LOCAL increment of addrs! */
+	    va_ladd(dst, n);
+	    CLOCKPOLLN(n);		/* Keep clock going */
+	} while ((cnt -= n) >= 0);
     }
     else do {
 
-	/* Normal BLT transfer */
+	/* Normal BLT transfer, a page span at a time */
 	register vmptr_t rp;
-	CLOCKPOLL();			/* Keep clock going */
 	if (INSBRKTEST()) {		/* Watch for interrupt */
 	    ac_setlrh(ac, va_insect(src),	/* Oops, save AC */
 			  va_insect(dst));
@@ -500,12 +509,17 @@ insdef(i_blt)
 	    ac_setlrh(ac, va_insect(src),	/* Oops, save AC */
 			  va_insect(dst));
 	    pag_fail();			/* Take page-fail trap */
+	    return PCINC_1;		/* Never returns; quiets compiler */
 	}
-	vm_pset(vp, vm_pget(rp));	/* Copy directly from source */
-	va_linc(src);			/* Add 1 to both addrs */
-	va_linc(dst);			/* Again, LOCAL increment only */
-
-    } while (--cnt >= 0);
+	if ((n = pag_blkspan(src, dst, cnt+1, FALSE)) == 1)
+	    vm_pset(vp, vm_pget(rp));	/* Copy directly from source */
+	else
+	    pag_blkmove(vp, rp, n, FALSE);
+	va_ladd(src, n);		/* Add n to both addrs */
+	va_ladd(dst, n);		/* Again, LOCAL increment only */
+	CLOCKPOLLN(n);			/* Keep clock going */
+
+    } while ((cnt -= n) >= 0);
 
 #if 0	/* No longer needed, code done inline to avoid this check */
     /* Broke out of loop, see if page-failed or not */
@@ -93,6 +93,8 @@ char *cmdprompt =	/* Set initial command prompt */
 	":KLH10# :KLH10> :KLH10>> ";
 #endif
 
+char *cpu_engine = "interp";	/* Current CPU fast loop, see cmvp_engine */
+
 char *ld_fmt = NULL;	/* Current load file format */
 char *ld_dfmt =		/* Default format if none specified */
 #if KLH10_SYS_ITS
@@ -212,6 +214,11 @@ CMDDEF(cd_trace, fc_trace,  CMRF_NOARG,	NULL,
 				"Toggle execution trace", "")
 CMDDEF(cd_halt,  fc_halt,   CMRF_NOARG,	NULL,
 				"Halt KN10 immediately", "")
+#if KLH10_PCPROF
+CMDDEF(cd_prof,  fc_prof,   CMRF_TOKS,
+			"[start [<usec> [<nsamp>]]|stop|clear|dump [<file>]|pprof <file>]",
+			"Sampling PC profiler", "")
+#endif
 CMDDEF(cd_zero,  fc_zero,   CMRF_NOARG,	NULL,
 				"Zero first 256K memory", "")
 CMDDEF(cd_devload,fc_devload, CMRF_TLIN,
@@ -276,6 +283,9 @@ KEYSBEGIN(fectbkeys)
     KEYDEF("set",	cd_set)
     KEYDEF("trace-toggle",	cd_trace)
     KEYDEF("halt",	cd_halt)
+#if KLH10_PCPROF
+    KEYDEF("profile",	cd_prof)
+#endif
     KEYDEF("zero",	cd_zero)
     KEYDEF("devdefine",	cd_devdef)
     KEYDEF("devdebug",  cd_devdbg)
@@ -350,6 +360,9 @@ pconfig(FILE *f)
 	    KLH10S_JPC
 	    KLH10S_DEBUG
 	    KLH10S_PCCACHE
+	    KLH10S_ICACHE
+	    KLH10S_BPCACHE
+	    KLH10S_PCPROF
 	    KLH10S_CTYIO_INT
 	    KLH10S_IMPIO_INT
 	    KLH10S_EVHS_INT
@@ -1347,6 +1360,7 @@ static int cmvp_sethz(struct prmvcx_s *);
 static int cmvp_setpri(struct prmvcx_s *);
 static int cmvp_memlock(struct prmvcx_s *);
 static int cmvp_serialno(struct prmvcx_s *);
+static int cmvp_engine(struct prmvcx_s *);
 
 extern int ld_debug;	/* From feload.c */
 #if KLH10_DEBUG && KLH10_CPU_KS
@@ -1372,6 +1386,8 @@ struct prmvar_s fecmvars[] = {
 				PRMVT_BOO, &cpu.mr_debug, NULL, NULL),
     PRMVAR("cpu_exsafe", "Enable exec mode safety halts",
 				PRMVT_OCT, &cpu.mr_exsafe, NULL, NULL),
+    PRMVAR("cpu_engine", "CPU fast loop (interp or block)",
+				PRMVT_STR, &cpu_engine, cmvp_engine, NULL),
     PRMVAR("fe_intchr", "KLH10 cmd escape char",
 				PRMVT_OCT, &cpu.fe.fe_intchr, NULL, NULL),
     PRMVAR("fe_prompt", "KLH10 cmd prompt",
@@ -1546,6 +1562,33 @@ cmvp_serialno(register struct prmvcx_s *cx)
     return TRUE;
 }
 
+/* Select CPU fast loop.  Takes effect the next time the CPU is started
+** or continued, since apr_run() only picks a loop on entry.
+*/
+static int
+cmvp_engine(register struct prmvcx_s *cx)
+{
+    register char *cp = cx->prmvcx_val.vs;
+    int eng;
+
+    if (cp && strcmp(cp, "interp") == 0)
+	eng = APR_ENG_INTERP;
+#if KLH10_ICACHE && KLH10_PCCACHE
+    else if (cp && strcmp(cp, "block") == 0)
+	eng = APR_ENG_BLOCK;
+#endif
+    else {
+	if (cx->prmvcx_ef)
+	    fprintf(cx->prmvcx_ef, "Unknown CPU engine \"%s\"\n",
+						cp ? cp : "");
+	return FALSE;
+    }
+    if (!prmvp_set(cx))
+	return FALSE;	/* Problem setting param?  Already reported */
+    cpu.mr_engine = eng;
+    return TRUE;
+}
+
 
 
 static int
@@ -2091,6 +2134,292 @@ fc_trace(struct cmd_s *cm)
     }
 }
 
+#if KLH10_PCPROF
+
+/* Sampling PC profiler.
+**	A clock timer periodically records the PC, opcode, and mode of
+**	the next instruction to execute.  Since the timer is invoked at
+**	an instruction boundary by the normal clock callout mechanism,
+**	the CPU keeps running in its fast loop; nothing is done per
+**	instruction.  Samples go into a ring buffer (so a long run keeps
+**	only the most recent ones) and a per-mode opcode histogram.
+**
+**	"profile dump" prints the hottest PCs and opcodes; "profile pprof"
+**	writes the samples in the legacy gperftools CPU profile format,
+**	which pprof can read.  User mode PCs have PRF_USRBIT added so the
+**	two address spaces stay distinct.
+*/
+
+#define PRF_DEFUSEC (CLK_USECS_PER_SEC/100)	/* Default interval */
+#define PRF_DEFNSAMP ((long)1<<16)		/* Default ring size */
+#define PRF_NOOP 01000		/* Opcode if instr couldn't be fetched */
+#define PRF_USRBIT ((unsigned long)1<<30)	/* Marks user PC in key */
+#define PRF_NTOP 40		/* # of hot PCs and opcodes to show */
+
+struct prfsamp {
+    unsigned long ps_key;	/* 30-bit PC, plus PRF_USRBIT if user */
+    int ps_op;			/* Opcode, or PRF_NOOP */
+};
+struct prfcnt {			/* Aggregated samples */
+    unsigned long pc_key;	/* Sample key (or opcode) */
+    long pc_cnt;		/* # of samples with that key */
+};
+
+static struct prfsamp *prf_ring = NULL;	/* Sample ring buffer */
+static long prf_nring;			/* Size of ring */
+static long prf_nsamp;			/* Total # samples taken */
+static long prf_ops[2][PRF_NOOP+1];	/* Opcode histogram, exec & user */
+static int32 prf_usec;			/* Sample interval */
+static struct clkent *prf_tmr = NULL;	/* Timer, if running */
+
+static int
+prf_clktmo(void *arg)		/* arg is ignored */
+{
+    register struct prfsamp *ps;
+    register vmptr_t vp;
+    register int usr = (cpu.mr_pcflags & PCF_USR) ? 1 : 0;
+
+    ps = &prf_ring[prf_nsamp++ % prf_nring];
+    ps->ps_key = (unsigned long)PC_30 | (usr ? PRF_USRBIT : 0);
+
+    /* Look at the instruction without disturbing the pager */
+    vp = vm_xtrymap(PC_VADDR, VMF_FETCH, cpu.acblk.xea, cpu.vmap.xea);
+    ps->ps_op = vp ? (iw_op(vm_pget(vp)) & 0777) : PRF_NOOP;
+    prf_ops[usr][ps->ps_op]++;
+    return CLKEVH_RET_REPEAT;
+}
+
+/* Sort samples by key, for aggregation */
+static int
+prf_keycmp(const void *a, const void *b)
+{
+    register unsigned long ka = ((struct prfsamp *)a)->ps_key;
+    register unsigned long kb = ((struct prfsamp *)b)->ps_key;
+
+    return (ka < kb) ? -1 : ((ka > kb) ? 1 : 0);
+}
+
+/* Sort aggregated samples by count, highest first */
+static int
+prf_cntcmp(const void *a, const void *b)
+{
+    register long ca = ((struct prfcnt *)a)->pc_cnt;
+    register long cb = ((struct prfcnt *)b)->pc_cnt;
+
+    return (ca > cb) ? -1 : ((ca < cb) ? 1 : 0);
+}
+
+/* PRF_AGGR - Collapse samples in ring into one count per key.
+**	Returns malloced array (caller frees) sorted by key, and sets
+**	*an to its length.
+*/
+static struct prfcnt *
+prf_aggr(long *an)
+{
+    register struct prfsamp *tab;
+    register struct prfcnt *cnt;
+    register long i, j, n;
+
+    n = (prf_nsamp < prf_nring) ? prf_nsamp : prf_nring;
+    tab = (struct prfsamp *)malloc((n+1) * sizeof(struct prfsamp));
+    cnt = (struct prfcnt *)malloc((n+1) * sizeof(struct prfcnt));
+    if (!tab || !cnt) {
+	if (tab) free((char *)tab);
+	if (cnt) free((char *)cnt);
+	return NULL;
+    }
+    memcpy((char *)tab, (char *)prf_ring, n * sizeof(struct prfsamp));
+    qsort((void *)tab, (size_t)n, sizeof(struct prfsamp), prf_keycmp);
+    for (i = j = 0; i < n; ++j) {
+	cnt[j].pc_key = tab[i].ps_key;
+	cnt[j].pc_cnt = 0;
+	for (; i < n && tab[i].ps_key == cnt[j].pc_key; ++i)
+	    cnt[j].pc_cnt++;
+    }
+    free((char *)tab);
+    *an = j;
+    return cnt;
+}
+
+/* Print count as percentage of total, to 0.1% */
+static void
+prf_pct(FILE *f, long cnt, long tot)
+{
+    register long pm = tot ? (cnt * 1000) / tot : 0;
+
+    fprintf(f, "%3ld.%ld%%", pm / 10, pm % 10);
+}
+
+static void
+prf_dump(FILE *f)
+{
+    register struct prfcnt *tab;
+    register long i, n, tot;
+    long nkeys, nexec, nusr;
+    struct prfcnt optab[PRF_NOOP+1];
+
+    fprintf(f, "Profile: %ld samples taken, every %ld usec (%s)\n",
+		prf_nsamp, (long)prf_usec, (prf_tmr ? "running" : "stopped"));
+    for (nexec = nusr = i = 0; i <= PRF_NOOP; ++i) {
+	nexec += prf_ops[0][i];
+	nusr += prf_ops[1][i];
+    }
+    if (!(tot = nexec + nusr))
+	return;
+    fprintf(f, "    Exec: %ld ", nexec);
+    prf_pct(f, nexec, tot);
+    fprintf(f, "   User: %ld ", nusr);
+    prf_pct(f, nusr, tot);
+    fprintf(f, "\n");
+
+    if (!(tab = prf_aggr(&nkeys))) {
+	fprintf(f, "?Can't allocate memory for dump\n");
+	return;
+    }
+    qsort((void *)tab, (size_t)nkeys, sizeof(struct prfcnt), prf_cntcmp);
+    n = (prf_nsamp < prf_nring) ? prf_nsamp : prf_nring;
+    fprintf(f, "Hottest PCs (of %ld in last %ld samples):\n", nkeys, n);
+    for (i = 0; i < nkeys && i < PRF_NTOP; ++i) {
+	fprintf(f, "  %8ld ", tab[i].pc_cnt);
+	prf_pct(f, tab[i].pc_cnt, n);
+	fprintf(f, "  %c %lo\n", (tab[i].pc_key & PRF_USRBIT) ? 'U' : 'E',
+			(long)(tab[i].pc_key & ~PRF_USRBIT));
+    }
+    free((char *)tab);
+
+    /* Merge modes for opcode table; key is opcode */
+    for (n = i = 0; i <= PRF_NOOP; ++i) {
+	if (prf_ops[0][i] + prf_ops[1][i]) {
+	    optab[n].pc_key = i;
+	    optab[n++].pc_cnt = prf_ops[0][i] + prf_ops[1][i];
+	}
+    }
+    qsort((void *)optab, (size_t)n, sizeof(struct prfcnt), prf_cntcmp);
+    fprintf(f, "Hottest opcodes:\n");
+    for (i = 0; i < n && i < PRF_NTOP; ++i) {
+	register int op = (int)optab[i].pc_key;
+
+	fprintf(f, "  %8ld ", optab[i].pc_cnt);
+	prf_pct(f, optab[i].pc_cnt, tot);
+	if (op == PRF_NOOP)
+	    fprintf(f, "  ---  (not mapped)\n");
+	else
+	    fprintf(f, "  %03o  %s\n", op,
+		(opcptr[op] && opcptr[op]->opstr) ? opcptr[op]->opstr : "?");
+    }
+}
+
+/* Write samples in legacy gperftools CPU profile format: a header, one
+** record of <count, depth, pc> per distinct PC, and a trailer, all in
+** native words.  No memory map follows, so pprof shows raw addresses.
+*/
+static int
+prf_pprof(FILE *f)
+{
+    register struct prfcnt *tab;
+    long i, nkeys;
+    unsigned long hdr[5];
+
+    if (!(tab = prf_aggr(&nkeys)))
+	return FALSE;
+    hdr[0] = 0, hdr[1] = 3, hdr[2] = 0, hdr[3] = prf_usec, hdr[4] = 0;
+    fwrite((char *)hdr, sizeof(hdr[0]), 5, f);
+    for (i = 0; i < nkeys; ++i) {
+	hdr[0] = tab[i].pc_cnt, hdr[1] = 1, hdr[2] = tab[i].pc_key;
+	fwrite((char *)hdr, sizeof(hdr[0]), 3, f);
+    }
+    hdr[0] = 0, hdr[1] = 1, hdr[2] = 0;
+    fwrite((char *)hdr, sizeof(hdr[0]), 3, f);
+    free((char *)tab);
+    return !ferror(f);
+}
+
+/* FC_PROF - Control sampling PC profiler
+*/
+static void
+fc_prof(struct cmd_s *cm)
+{
+    char *cp;
+    long usec = PRF_DEFUSEC, nsamp = PRF_DEFNSAMP;
+    FILE *f;
+
+    if (cmdargs_all(cm) < 1) {
+	printf("Profiler %s, %ld samples taken\n",
+		(prf_tmr ? "running" : "stopped"), prf_nsamp);
+	return;
+    }
+    cp = cm->cmd_argv[0];
+    if (strcmp(cp, "start") == 0) {
+	if (prf_tmr) {
+	    printf("Profiler already running\n");
+	    return;
+	}
+	if (prf_ring)		/* Keep current buffer unless told otherwise */
+	    nsamp = prf_nring;
+	if ((cm->cmd_argc > 1 && (!s_tonum(cm->cmd_argv[1], &usec)
+				  || usec <= 0))
+	  || (cm->cmd_argc > 2 && (!s_tonum(cm->cmd_argv[2], &nsamp)
+				  || nsamp <= 0))) {
+	    printf("?Bad interval or sample count\n");
+	    return;
+	}
+	if (!prf_ring || nsamp != prf_nring) {
+	    if (prf_ring)
+		free((char *)prf_ring);
+	    prf_ring = (struct prfsamp *)malloc(nsamp*sizeof(struct prfsamp));
+	    if (!prf_ring) {
+		printf("?Can't allocate %ld samples\n", nsamp);
+		return;
+	    }
+	    prf_nring = nsamp;
+	    prf_nsamp = 0;
+	    memset((char *)prf_ops, 0, sizeof(prf_ops));
+	}
+	prf_usec = usec;
+	prf_tmr = clk_tmrget(prf_clktmo, (void *)NULL, prf_usec);
+	printf("Profiler started, every %ld usec, %ld sample buffer\n",
+		usec, prf_nring);
+
+    } else if (strcmp(cp, "stop") == 0) {
+	if (prf_tmr) {
+	    clk_tmrkill(prf_tmr);
+	    prf_tmr = NULL;
+	}
+	printf("Profiler stopped, %ld samples taken\n", prf_nsamp);
+
+    } else if (strcmp(cp, "clear") == 0) {
+	prf_nsamp = 0;
+	memset((char *)prf_ops, 0, sizeof(prf_ops));
+
+    } else if (strcmp(cp, "dump") == 0) {
+	if (cm->cmd_argc < 2)
+	    prf_dump(stdout);
+	else if (!(f = fopen(cm->cmd_argv[1], "w")))
+	    printf("?Can't open \"%s\": %s\n", cm->cmd_argv[1],
+			os_strerror(-1));
+	else {
+	    prf_dump(f);
+	    fclose(f);
+	}
+
+    } else if (strcmp(cp, "pprof") == 0) {
+	if (cm->cmd_argc < 2)
+	    printf("?Need output filename\n");
+	else if (!(f = fopen(cm->cmd_argv[1], "wb")))
+	    printf("?Can't open \"%s\": %s\n", cm->cmd_argv[1],
+			os_strerror(-1));
+	else {
+	    if (!prf_pprof(f))
+		printf("?Error writing \"%s\"\n", cm->cmd_argv[1]);
+	    fclose(f);
+	}
+
+    } else
+	printf("?Unknown profile command \"%s\"\n", cp);
+}
+
+#endif /* KLH10_PCPROF */
+
 #if 0	/* Not bound to a command now, use SET. */
 
 /* FC_DEBUG - Toggles general debug flag
@@ -277,6 +277,18 @@
 #ifndef  KLH10_PCCACHE	/* True to include experimental PC cache stuff */
 # define KLH10_PCCACHE 1
 #endif
+#ifndef  KLH10_ICACHE	/* True to include decoded-instruction cache */
+# define KLH10_ICACHE 1
+#endif
+#ifndef  KLH10_ICACHE_SIZE	/* # phys words it covers (power of 2, >= page) */
+# define KLH10_ICACHE_SIZE (1<<13)
+#endif
+#ifndef  KLH10_BPCACHE	/* True to include ILDB/IDPB byte pointer cache */
+# define KLH10_BPCACHE 1
+#endif
+#ifndef  KLH10_PCPROF	/* True to include sampling PC profiler */
+# define KLH10_PCPROF 1
+#endif
 #ifndef  KLH10_JPC	/* True to include JPC feature */
 # define KLH10_JPC 1	/* For now, always - helps debug! */
 #endif
@@ -392,6 +404,14 @@
 # define KLH10_DEV_DP (KLH10_DEV_DPNI20 \
 		      |KLH10_DEV_DPRPXX|KLH10_DEV_DPTM03|KLH10_DEV_DPIMP)
 #endif
+
+/* True to allow DPs to run as threads within the KLH10 (DP_XT_THCV)
+** rather than as forked subprocesses.  Needs POSIX threads, so link
+** with -lpthread.  Only the RPxx DP can be run this way at present.
+*/
+#ifndef  KLH10_DEV_DPTHREADS
+# define KLH10_DEV_DPTHREADS 0
+#endif
 
 /* Miscellaneous config vars */
 
@@ -220,6 +220,21 @@
 #else
 # define KLH10S_PCCACHE ""
 #endif
+#if KLH10_ICACHE
+# define KLH10S_ICACHE " ICACHE"
+#else
+# define KLH10S_ICACHE ""
+#endif
+#if KLH10_BPCACHE
+# define KLH10S_BPCACHE " BPCACHE"
+#else
+# define KLH10S_BPCACHE ""
+#endif
+#if KLH10_PCPROF
+# define KLH10S_PCPROF " PCPROF"
+#else
+# define KLH10S_PCPROF ""
+#endif
 #if KLH10_CTYIO_INT
 # define KLH10S_CTYIO_INT " CTYINT"
 #else
@@ -256,7 +271,9 @@
 
     /* Drive units for RH controllers */
 #if KLH10_DEV_RPXX
-# if KLH10_DEV_DPRPXX
+# if KLH10_DEV_DPRPXX && KLH10_DEV_DPTHREADS
+#  define KLH10S_DEV_RPXX " RPXX(DP/THR)"
+# elif KLH10_DEV_DPRPXX
 #  define KLH10S_DEV_RPXX " RPXX(DP)"
 # else
 #  define KLH10S_DEV_RPXX " RPXX"
@@ -130,6 +130,7 @@ struct clkregs {
 ** grubby details about the clock model.
 **
 **	CLOCKPOLL() carries out a clock ctick update if synchronous.
+**	CLOCKPOLLN(n) ditto for n cticks at once (block instructions).
 **	CLK_CTICKS_SINCE_ITICK() # of cticks so far in the current interval.
 **	CLK_CTICKS_UNTIL_ITICK() # of cticks left in current interval.
 **	CLK_CTICKS_PER_ITICK	 # of cticks in an interval.
@@ -140,6 +141,7 @@ struct clkregs {
 */
 #if IFCLOCKED	/* Synchronous counter model (also assuming ctick==usec) */
 # define CLOCKPOLL() if (--cpu.clk.clk_counter <= 0) CLK_TRIGGER()
+# define CLOCKPOLLN(n) if ((cpu.clk.clk_counter -= (n)) <= 0) CLK_TRIGGER()
 # define CLK_CTICKS_SINCE_ITICK() (cpu.clk.clk_icnter + \
 				(cpu.clk.clk_ocnt - cpu.clk.clk_counter))
 # define CLK_CTICKS_UNTIL_ITICK() (cpu.clk.clk_counter)
@@ -149,6 +151,7 @@ struct clkregs {
 # define CLK_USECS_PER_ITICK	CLK_CTICKS_PER_ITICK
 #else		/* Real-time OSINT model */
 # define CLOCKPOLL()
+# define CLOCKPOLLN(n)
 # define CLK_CTICKS_SINCE_ITICK() (0)
 # define CLK_CTICKS_UNTIL_ITICK() (0)
 # define CLK_CTICKS_PER_ITICK	  (1)
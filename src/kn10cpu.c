@@ -70,6 +70,14 @@ static int tim_init(void);
  static int apr_walk(void);
  static void apr_fly(void);
 #endif
+#if KLH10_ICACHE
+ static void ic_init(void);
+ static void ic_fill(struct icent *, w10_t);
+# if KLH10_PCCACHE
+  static void apr_leap(void);
+  static void bb_build(struct icent *, vmptr_t, int);
+# endif
+#endif
 #if KLH10_ITS_1PROC
  static void apr_1proc(void);
 #endif
@@ -110,6 +118,9 @@ apr_init(void)
     cpu.mr_inafi = 0;
 #endif
     cpu.mr_dotrace = cpu.mr_1step = 0;
+#if KLH10_ICACHE
+    ic_init();			/* Decode cache must match opdisp */
+#endif
 
     op10m_setz(cpu.mr_dsw);	/* Clear data switches initially */
 
@@ -206,6 +217,11 @@ apr_run(void)
 	/* No debugging - invoke normal fast loop, max speed */
 
 	_setjmp(aprloopbuf);	/* Save return point for trap/interrupt */
+#if KLH10_ICACHE && KLH10_PCCACHE
+	if (cpu.mr_engine == APR_ENG_BLOCK)
+	    apr_leap();		/* Basic-block loop, either kind */
+	else
+#endif
 #if KLH10_EXTADR
 	apr_hop();		/* Extended (KL) */
 #else
@@ -218,6 +234,91 @@ apr_run(void)
     }
 }
 
+#if KLH10_ICACHE
+
+/* Decoded-instruction cache support.
+**	The fast loops look up an ICACHE entry using the physical address
+**	of the instruction they just fetched, and re-decode it with
+**	ic_fill() if the entry was made from some other word.  Since the
+**	entry is validated against the fetched word on every use, there is
+**	no need to track stores into instruction pages, and page map or AC
+**	block changes don't matter either.
+*/
+
+/* IC_EA - Compute E for cached instruction, same as ea_calc().
+** IC_XEA - Ditto for xea_calc(), given PC section.
+*/
+#define ic_ea(ic) \
+  ((ic)->ic_ix \
+     ? (((ic)->ic_ix & IW_I) \
+	? ea_fncalc((ic)->ic_iw, cpu.acblk.xea, cpu.vmap.xea) \
+	: va_Vmake(VAF_LOCAL, 0, H10MASK &		/* Has X only */\
+		((ic)->ic_y + ac_xgetrh((ic)->ic_ix, cpu.acblk.xea)))) \
+     : va_Vmake(VAF_LOCAL, 0, (ic)->ic_y))		/* Simple Y */
+
+#define ic_xea(ic, s) \
+  ((ic)->ic_ix \
+     ? ((((ic)->ic_ix & IW_I) || (s)) \
+	? xea_xcalc((ic)->ic_iw, (unsigned)(s), cpu.acblk.xea, cpu.vmap.xea) \
+	: va_Vmake(VAF_LOCAL, s, H10MASK &		/* Has X only */\
+		((ic)->ic_y + ac_xgetrh((ic)->ic_ix, cpu.acblk.xea)))) \
+     : va_Vmake(VAF_LOCAL, s, (ic)->ic_y))		/* Simple Y */
+
+#if KLH10_PCCACHE
+static unsigned char bb_endop[I_N];	/* TRUE if opcode ends a block */
+#endif
+
+/* IC_FILL - Decode instruction word into given ICACHE entry.
+*/
+static void
+ic_fill(register struct icent *ic,
+	register w10_t iw)
+{
+    ic->ic_iw = iw;
+    ic->ic_op = iw_op(iw);
+    ic->ic_ac = iw_ac(iw);
+    ic->ic_rtn = cpu.opdisp[ic->ic_op];
+    ic->ic_ix = LHGET(iw) & (IW_I|IW_X);
+    ic->ic_y = RHGET(iw);
+    ic->ic_bblen = 0;		/* Not known to start a block */
+}
+
+/* IC_INIT - Initialize ICACHE.
+**	Every entry is made valid (for a zero word) so the fast loops
+**	never need to test for an empty one.
+*/
+static void
+ic_init(void)
+{
+    register int i;
+    w10_t w;
+
+    op10m_setz(w);
+    for (i = 0; i < KLH10_ICACHE_SIZE; ++i)
+	ic_fill(&cpu.ic_tab[i], w);
+
+#if KLH10_PCCACHE
+    /* Find the opcodes that must end a basic block: ones that always
+    ** jump, and ones that may change the mapping, AC block, or PC flags
+    ** without jumping (XCT and friends can execute anything).
+    ** Conditional jumps and skips don't end a block, since apr_leap()
+    ** leaves the block anyway whenever one is taken.
+    */
+    for (i = 0; i < I_N; ++i)
+	bb_endop[i] = (i >= 0700			/* IO, or KS UMOVE etc */
+		|| cpu.opdisp[i] == cpu.opdisp[I_MUUO]	/* UUOs incl JSYS */
+		|| cpu.opdisp[i] == cpu.opdisp[I_LUUO]);
+    bb_endop[I_ILLEG] = bb_endop[I_XCT] = bb_endop[I_JRST] = TRUE;
+# if KLH10_SYS_ITS
+    bb_endop[I_XCTR] = bb_endop[I_XCTRI] = TRUE;
+# endif
+    bb_endop[I_JSR] = bb_endop[I_JSP] = bb_endop[I_JSA] = TRUE;
+    bb_endop[I_JRA] = bb_endop[I_PUSHJ] = bb_endop[I_POPJ] = TRUE;
+    bb_endop[I_JUMPA] = bb_endop[I_AOJA] = bb_endop[I_SOJA] = TRUE;
+#endif
+}
+#endif /* KLH10_ICACHE */
+
 #if !KLH10_EXTADR
 /* APR_WALK - Routine to use when debugging or some other kind of
 **	slow checking within the main loop may be needed.
@@ -289,6 +390,10 @@ apr_fly(void)
     register paddr_t pc;
     register paddr_t cachelo = 1;	/* Lower & upper bounds of PC */
     register paddr_t cachehi = 0;
+# if KLH10_ICACHE
+    register struct icent *icp = NULL;	/* ICACHE entries for cached page */
+    register struct icent *ic;
+# endif
 #endif
 
     PCCACHE_RESET();		/* Robustness: invalidate cached PC info */
@@ -312,8 +417,21 @@ apr_fly(void)
 		cachehi = PAG_MASK;
 	    } else
 		cachehi = AC_17;	/* Running in ACs */
+# if KLH10_ICACHE
+	    /* Find ICACHE entries for this page, unless running in ACs */
+	    icp = (cachehi == AC_17) ? NULL
+		: ICACHE_ENT((paddr_t)(cpu.mr_cachevp - cpu.physmem));
+# endif
 	}
 	instr = vm_pget(vp);
+# if KLH10_ICACHE
+	if (icp) {
+	    ic = icp + (pc & PAG_MASK);
+	    if (op10m_camn(ic->ic_iw, instr))	/* Stale or other word? */
+		ic_fill(ic, instr);		/* Yep, decode it now */
+	    PC_ADDXCT((*ic->ic_rtn)(ic->ic_op, ic->ic_ac, ic_ea(ic)));
+	} else
+# endif
 #else
 	instr = vm_fetch(PC_VADDR);	/* Fetch next instr */
 #endif
@@ -410,18 +528,73 @@ apr_creep(void)
 
 /* APR_HOP - EXTENDED version of APR_FLY.
 **	Fast loop, hobbled by XA operations.
-**	No PC Cache stuff to begin with -- keep simple for now.
+**	The PC cache works as for APR_FLY, except that the bounds are
+**	full 30-bit PC values so that a section change always misses.
+**	The page containing an address break is never cached, so that
+**	instruction fetches from it continue to go through pag_refill().
 */
 static void
 apr_hop(void)
 {
     register w10_t instr;
+#if KLH10_PCCACHE
+    register vmptr_t vp;
+    register paddr_t pc;
+    register paddr_t cachelo = 1;	/* Lower & upper bounds of PC */
+    register paddr_t cachehi = 0;
+# if KLH10_ICACHE
+    register struct icent *icp = NULL;	/* ICACHE entries for cached page */
+    register struct icent *ic;
+# endif
+#endif
 
+    PCCACHE_RESET();		/* Robustness: invalidate cached PC info */
     for (;;) {
 	if (INSBRKTEST())	/* Check and handle all possible "asynchs" */
 	    apr_check();
+#if KLH10_PCCACHE
+	/* See if PC is still within cached page pointer */
+	if ((pc = PC_30) <= cachehi && cachelo <= pc
+	  && cpu.mr_cachevp) {
+	    vp = cpu.mr_cachevp + (pc & PAG_MASK);	/* Win, fast fetch */
+	} else {
+	    vp = vm_PCmap(VMF_FETCH,		/* Do mapping, may fault */
+			cpu.acblk.xea, cpu.vmap.xea);
+	    if (PC_ISACREF
+# if KLH10_CPU_KL
+	      || PC_PAGE == cpu.mr_abk_pagno
+# endif
+			) {
+		cachelo = 1;		/* Running in ACs or break page, */
+		cachehi = 0;		/* don't cache anything */
+# if KLH10_ICACHE
+		icp = NULL;
+# endif
+	    } else {
+		/* Remember start of page */
+		cpu.mr_cachevp = vp - (pc & PAG_MASK);
+		cachelo = pc & ~(paddr_t)PAG_MASK;
+		cachehi = cachelo | PAG_MASK;
+		if (!(pc & (H10MASK & ~PAG_MASK)))	/* Page 0 of sect? */
+		    cachelo |= AC_17+1;		/* Skip the AC addrs */
+# if KLH10_ICACHE
+		icp = ICACHE_ENT((paddr_t)(cpu.mr_cachevp - cpu.physmem));
+# endif
+	    }
+	}
+	instr = vm_pget(vp);
+# if KLH10_ICACHE
+	if (icp) {
+	    ic = icp + (pc & PAG_MASK);
+	    if (op10m_camn(ic->ic_iw, instr))	/* Stale or other word? */
+		ic_fill(ic, instr);		/* Yep, decode it now */
+	    PC_ADDXCT((*ic->ic_rtn)(ic->ic_op, ic->ic_ac,
+				ic_xea(ic, PC_SECT)));
+	} else
+# endif
+#else
 	instr = vm_PCfetch();	/* Fetch next instr */
-
+#endif
 	PC_ADDXCT(op_xct(iw_op(instr), iw_ac(instr),
 				xea_calc(instr, PC_SECT)));
 
@@ -436,6 +609,139 @@ apr_hop(void)
 }
 #endif /* EXTADR */
 
+#if KLH10_ICACHE && KLH10_PCCACHE
+
+/* Basic-block engine, selected with "set cpu_engine block".
+**	A basic block is a run of ICACHE entries for consecutive words
+**	within one page, ending at the first instruction that always jumps
+**	or that might change the mapping or PC flags without jumping (see
+**	bb_endop[]).  Its length is kept in the ICACHE entry of its first
+**	word, so the decoded entries themselves serve as direct-threaded
+**	code and a block is executed without any PC cache test, mapping,
+**	or ICACHE lookup between instructions.
+**	Every word is still compared against memory before it is executed,
+**	so a store into a block just causes that word to be re-decoded and
+**	the block to be cut short after it.  A jump or skip leaves the
+**	block; if the new PC is in the same page, the next block is entered
+**	directly ("chained") without going back through the mapping code.
+**	XCT, PXCT, UUOs and IO instructions always end a block, so any
+**	mapping change they make is seen before the next instruction; a
+**	page fault simply longjmps back into the top of the loop.
+*/
+
+#if KLH10_EXTADR
+# define bb_pc() PC_30
+# define bb_ea(ic) ic_xea(ic, PC_SECT)
+# define bb_iwea(w) xea_calc(w, PC_SECT)
+#else
+# define bb_pc() PC_INSECT
+# define bb_ea(ic) ic_ea(ic)
+# define bb_iwea(w) ea_calc(w)
+#endif
+
+/* APR_LEAP - Basic-block version of APR_FLY and APR_HOP.
+*/
+static void
+apr_leap(void)
+{
+    register struct icent *ic;
+    register vmptr_t vp;
+    register int n;
+    register pcinc_t pcinc;
+    register paddr_t pc;
+    paddr_t cachelo, cachehi;	/* Lower & upper bounds of PC in page */
+    struct icent *icp;		/* ICACHE entries for page */
+
+    PCCACHE_RESET();		/* Robustness: invalidate cached PC info */
+    for (;;) {
+	if (INSBRKTEST())	/* Check and handle all possible "asynchs" */
+	    apr_check();
+
+	/* Map page of PC, may fault */
+	pc = bb_pc();
+#if KLH10_EXTADR
+	vp = vm_PCmap(VMF_FETCH, cpu.acblk.xea, cpu.vmap.xea);
+	if (PC_ISACREF
+# if KLH10_CPU_KL
+	  || PC_PAGE == cpu.mr_abk_pagno
+# endif
+			) {
+#else
+	vp = vm_xeamap(PC_VADDR, VMF_FETCH);
+	if (pc <= AC_17) {
+#endif
+	    /* Running in ACs or break page, just do one instruction */
+	    register w10_t instr = vm_pget(vp);
+
+	    PC_ADDXCT(op_xct(iw_op(instr), iw_ac(instr), bb_iwea(instr)));
+	    CLOCKPOLL();
+	    continue;
+	}
+	cpu.mr_cachevp = vp - (pc & PAG_MASK);	/* Cleared by map changes */
+	cachelo = pc & ~(paddr_t)PAG_MASK;
+	cachehi = cachelo | PAG_MASK;
+	if (!(pc & (H10MASK & ~PAG_MASK)))	/* Page 0 of sect? */
+	    cachelo |= AC_17+1;			/* Skip the AC addrs */
+	icp = ICACHE_ENT((paddr_t)(cpu.mr_cachevp - cpu.physmem));
+
+	/* Run blocks in this page until control leaves it */
+	for (;;) {
+	    ic = icp + (pc & PAG_MASK);
+	    if (!ic->ic_bblen || op10m_camn(ic->ic_iw, vm_pget(vp)))
+		bb_build(ic, vp, PAG_SIZE - (int)(pc & PAG_MASK));
+	    n = ic->ic_bblen;
+	    while ((pcinc = (*ic->ic_rtn)(ic->ic_op, ic->ic_ac, bb_ea(ic)))
+			== PCINC_1) {
+		PC_ADD(1);
+		CLOCKPOLL();
+		if (--n <= 0 || INSBRKTEST())
+		    break;
+		++ic, ++vp;
+		if (op10m_camn(ic->ic_iw, vm_pget(vp))) {  /* Word changed? */
+		    ic_fill(ic, vm_pget(vp));	/* Re-decode it, and */
+		    n = 1;			/* end block after it */
+		}
+	    }
+	    if (pcinc != PCINC_1) {
+		PC_ADDXCT(pcinc);
+		CLOCKPOLL();
+	    }
+	    if (INSBRKTEST() || !cpu.mr_cachevp)
+		break;			/* Asynch or mapping changed */
+	    if ((pc = bb_pc()) > cachehi || pc < cachelo)
+		break;			/* Left the page */
+	    vp = cpu.mr_cachevp + (pc & PAG_MASK);	/* Chain to new block */
+	}
+    }
+}
+
+/* BB_BUILD - Translate basic block starting at given ICACHE entry,
+**	whose word is at vp.  The block may not extend past max words,
+**	which keeps it within the page.
+*/
+static void
+bb_build(register struct icent *ic,
+	 register vmptr_t vp,
+	 register int max)
+{
+    register struct icent *hd = ic;
+    register int n;
+
+    for (n = 1;; ++n, ++ic, ++vp) {
+	if (op10m_camn(ic->ic_iw, vm_pget(vp)))	/* Stale or other word? */
+	    ic_fill(ic, vm_pget(vp));		/* Yep, decode it now */
+	if (n >= max || bb_endop[ic->ic_op])
+	    break;
+    }
+    hd->ic_bblen = n;
+}
+
+#undef bb_pc
+#undef bb_ea
+#undef bb_iwea
+
+#endif /* KLH10_ICACHE && KLH10_PCCACHE */
+
 
 /* APR_CHECK - Check all possible "interrupt" conditions to see what
 **	needs to be done, and do it.
@@ -855,6 +855,65 @@ struct feregs {
 	/*		020 */	/* SCTLW - Request word, various bits */
 #endif
 
+/* Decoded-instruction cache
+**	Each entry holds the result of taking apart one instruction word,
+**	so the fast loops can skip straight to the dispatch.  The table is
+**	direct-mapped by physical address; an entry is only trusted if
+**	ic_iw matches the word just fetched, so any store into the page
+**	(whether by an instruction or by device DMA) simply causes a
+**	re-decode the next time that word is executed.  Nothing in an
+**	entry depends on the current mapping or AC block.
+*/
+#if KLH10_ICACHE
+struct icent {
+	w10_t ic_iw;		/* Instruction word entry was decoded from */
+	opfp_t ic_rtn;		/* Pre-resolved cpu.opdisp[] routine */
+	int ic_op;		/* Opcode field */
+	int ic_ac;		/* AC field */
+	h10_t ic_ix;		/* I and X bits (LH format), 0 if E is just Y */
+	h10_t ic_y;		/* Y field */
+	int ic_bblen;		/* # instrs in basic block starting here, or 0 */
+};
+# define ICACHE_MASK (KLH10_ICACHE_SIZE-1)
+# define ICACHE_ENT(pa) (&cpu.ic_tab[(pa) & ICACHE_MASK])
+#endif /* KLH10_ICACHE */
+
+/* Byte pointer stream cache
+**	Remembers where the byte word of a recently used ILDB/IDPB pointer
+**	was found in physical memory, so a loop stepping through a string
+**	needn't redo the byte EA calc and mapping until it leaves the page.
+**	Only simple BPs (one-word local, no I or X, not pointing at an AC)
+**	are entered.  An entry is trusted only if the BP word still holds
+**	bc_bp and the byte data map still has the generation it had when
+**	the entry was made; any other change just causes a miss.
+**	The cache must be flushed with BPCACHE_RESET whenever that check
+**	could pass for a stale entry: when a map generation wraps around
+**	(pag_mapclr), and when code edits a single map entry in place
+**	without bumping the map's generation.
+*/
+#if KLH10_BPCACHE
+struct bpcent {
+	vmptr_t bc_bpvp;	/* Phys loc of BP word, NULL if entry unused */
+	vaddr_t bc_e;		/* E the BP was referenced with */
+	w10_t bc_bp;		/* BP word as last fetched or stored */
+	vmptr_t bc_vp;		/* Phys loc of word that BP's Y refers to */
+	pment_t *bc_map;	/* Byte data map bc_vp came from */
+	pment_t bc_gen;		/* Generation of that map at the time */
+	pment_t bc_acc;		/* VMF_READ or VMF_WRITE as checked */
+};
+# define BPCACHE_N 4		/* # entries, power of 2 */
+# define BPCACHE_ENT(e) (&cpu.bpc_tab[va_insect(e) & (BPCACHE_N-1)])
+# define BPCACHE_RESET() memset((char *)cpu.bpc_tab, 0, sizeof(cpu.bpc_tab))
+#else
+# define BPCACHE_RESET()
+#endif /* KLH10_BPCACHE */
+
+/* Values for cpu.mr_engine, selecting which fast loop apr_run() uses.
+**	The basic-block engine needs both the ICACHE and the PC cache.
+*/
+#define APR_ENG_INTERP	0	/* Normal one-instruction-at-a-time loop */
+#define APR_ENG_BLOCK	1	/* Basic-block (threaded ICACHE) loop */
+
 /* Global Machine state variables
 **	This is a structure so references to the contents can all be made
 **	as offsets from a base address (which may be in a register).  On
@@ -930,6 +989,8 @@ struct machstate {
 	struct acregs acblk;	/* AC block mappings */
 	struct vmregs vmap;	/* Pager context mappings */
 	struct pagregs pag;	/* Paging registers */
+	pment_t *pr_umap;	/* Internal user mode map table */
+	pment_t *pr_emap;	/*   "      exec  "    "    "   */
 	struct aprregs aprf;	/* APR device stuff */
 	struct piregs pi;	/* PI system stuff */
 	struct timeregs tim;	/* Timer and clock stuff */
@@ -948,6 +1009,7 @@ struct machstate {
 	/* Miscellaneous cruft */
 	int mr_runnable;	/* TRUE if CPU runnable (ie init complete) */
 	int mr_running;		/* TRUE if CPU running (not halted) */
+	int mr_engine;		/* APR_ENG_xxx fast loop to use */
 	int mm_shared;		/* TRUE if using shared phys memory */
 	int mm_locked;		/* TRUE if want memory locked */
 	osmm_t mm_physegid;	/* Phys memory shared segment ID (can be 0) */
@@ -960,8 +1022,14 @@ struct machstate {
 
 	w10_t acblks[ACBLKS_N][16];	/* Actual AC blocks!  16 wds each */
 	opfp_t opdisp[I_N];		/* I_xxx Routine dispatch table */
-	pment_t pr_umap[PAG_MAXVIRTPGS]; /* Internal user mode map table */
-	pment_t pr_emap[PAG_MAXVIRTPGS]; /*   "      exec  "    "    "   */
+#if KLH10_ICACHE
+	struct icent ic_tab[KLH10_ICACHE_SIZE];	/* Decoded instrs */
+#endif
+#if KLH10_BPCACHE
+	struct bpcent bpc_tab[BPCACHE_N];	/* ILDB/IDPB BP cache */
+#endif
+	pment_t pr_umapbuf[1+PAG_MAXVIRTPGS];	/* pr_umap, with generation */
+	pment_t pr_emapbuf[1+PAG_MAXVIRTPGS];	/* pr_emap,   "      "     */
 };
 
 EXTDEF struct machstate cpu;
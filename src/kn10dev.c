@@ -76,6 +76,9 @@ static int    dvnull_iobuf(struct device *d, int wc, w10_t **awp)
 			{ return 0; }
 static void   dvnull_ioend(struct device *d, int i)
 			{ }
+static int    dvnull_iosgl(struct device *d, long wc,
+			   struct dviosg_s *sg, int nsg)
+			{ return 0; }
 static uint32 dvnull_rrg(struct device *d, int r)
 			{ return -1; }
 static int    dvnull_wrg(struct device *d, int r, dvureg_t v)
@@ -124,6 +127,7 @@ iodv_setnull(register struct device *d)
     d->dv_iobeg = dvnull_iobeg;	/* [C] Xfer start */
     d->dv_iobuf = dvnull_iobuf;	/* [C] Xfer buffer setup */
     d->dv_ioend = dvnull_ioend;	/* [C] Xfer end */
+    d->dv_iosgl = dvnull_iosgl;	/* [C] Xfer scatter-gather list */
     d->dv_rdreg = dvnull_rrg;	/* Drive register read */
     d->dv_wrreg = dvnull_wrg;	/* Drive register write */
 
@@ -1235,7 +1239,8 @@ dev_show(FILE *of,
 	return TRUE;
     }
 
-    return FALSE;
+    /* Specific device, let its driver show whatever it likes */
+    return dev_status(of, dstr, args);
 #if 0
     if (!(def = dev_lookup(dstr))) {
 	if (of)
@@ -103,7 +103,18 @@ Issues not addressed:
 */
 
 
-#define KN10DEV_VERSION 2	/* Version # of structure */
+#define KN10DEV_VERSION 3	/* Version # of structure */
+
+/* Scatter-gather list segment, as returned by dv_iosgl.
+**	A controller fills in a list of these describing as much of the
+**	current transfer as it can see ahead, with physically contiguous
+**	buffers merged into one segment.  The drive can then do the whole
+**	list at once and report the total with a single dv_iobuf call.
+*/
+struct dviosg_s {
+    w10_t *sg_vp;		/* Start of segment in 10 memory */
+    int sg_wc;			/* # words in segment */
+};
 
 /* Device structure.
 **	All entries here are set by the device, except for those marked [C]
@@ -137,6 +148,8 @@ struct device {
     int  (*dv_iobeg)(dv_t *, int);	/* [C] Xfer start */
     int  (*dv_iobuf)(dv_t *, int, w10_t **);	/* [C] Xfer buffer setup */
     void (*dv_ioend)(dv_t *, int);	/* [C] Xfer end */
+    int  (*dv_iosgl)(dv_t *, long,	/* [C] Xfer scatter-gather list */
+		     struct dviosg_s *, int);
     uint32 (*dv_rdreg)(dv_t *, int);		/* Drive register read */
     int    (*dv_wrreg)(dv_t *, int, dvureg_t);	/* Drive register write */
 
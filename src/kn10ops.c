@@ -149,6 +149,35 @@
 # define OP10_KCCOPS 0
 #endif
 
+/* Determine whether native 64-bit arithmetic can be used internally.
+**	If the host has a 64-bit integer type, a few of the more expensive
+**	routines (FFO, unsigned multiply, single division) carry out their
+**	work on whole 36-bit values in a uint64 instead of piecemeal.  This
+**	is independent of the word10 model; W64GET and W64SET only use
+**	the halfword facilities, so results are identical either way.
+*/
+#ifndef OP10_USE64
+# ifdef WORD10_INT64
+#  define OP10_USE64 1
+# else
+#  define OP10_USE64 0
+# endif
+#endif
+
+#if OP10_USE64
+# define W64GET(w) ((((uint64)LHGET(w))<<H10BITS) | RHGET(w))
+# define W64SET(w,v) LRHSET(w, (h10_t)(((v)>>H10BITS)&H10MASK), \
+				(h10_t)((v)&H10MASK))
+# define W64SIGN36 (((uint64)1)<<35)
+# define W64SGET(w) ((int64)(W64GET(w) ^ W64SIGN36) - (int64)W64SIGN36)
+# define W64MASK35 ((((uint64)1)<<35)-1)
+# define W64MASK36 ((((uint64)1)<<36)-1)
+# ifdef __GNUC__	/* Count leading zeros of nonzero 64-bit value */
+#  define FFO64(v) (__builtin_clzll((unsigned long long)(v)) \
+			- (int)(sizeof(unsigned long long)*CHAR_BIT - 64))
+# endif
+#endif
+
 
 /* Determine whether DIV() or LDIV() is available from C */
 #if defined(__STDC__) && __STDC__
@@ -286,6 +315,7 @@ static w10_t ffmpr(w10_t, w10_t, int);	/* Aux for FMP/FMPR */
 static w10_t sfnorm(int, w10_t, int);	/* Float & normalize single-prec int */
 static dw10_t dfad(dw10_t, dw10_t, int);	/* Aux for DFAD/DFSB */
 static int qdivstep(qw10_t *, dw10_t, int);	/* For double division */
+static int qdivfrac(qw10_t *, dw10_t, int);	/* For DF/GF division */
 
 #if IFFLAGS
 static void x_ashflg(w10_t, int);
@@ -367,6 +397,14 @@ int op10ffo(register w10_t w)
     register int i;
     register uint18 reg;		/* Need unsigned for shifting */
 
+#if OP10_USE64 && defined(FFO64)
+    /* Let the host count leading zeros in one instruction */
+    register uint64 v;
+
+    if (!(v = W64GET(w)))
+	return 36;
+    return FFO64(v) - (64-36);
+#endif
     if ((reg = LHGET(w))) i = 17;	/* Find right halfword and set up */
     else if ((reg = RHGET(w))) i = 17+18;
     else return 36;
@@ -397,6 +435,16 @@ static int adffo(register dw10_t d)
     register int i;
     register uint18 reg;		/* Need unsigned for shifting */
 
+#if OP10_USE64 && defined(FFO64)
+    if (wskipn(d.HI))
+	return op10ffo(d.HI);
+    {
+	register uint64 v;
+	if (!(v = W64GET(d.LO) & W64MASK35))	/* Ignore low sign bit */
+	    return 36+36-1;
+	return FFO64(v) - (64-36) + 36-1;
+    }
+#endif
     if ((reg = LHGET(d.HI))) i = 17;	/* Find right halfword and set up */
     else if ((reg = RHGET(d.HI))) i = 17+18;
     else if ((reg = (LHGET(d.LO)&H10MAGS))) i = 17+36-1;
@@ -1168,6 +1216,22 @@ dw10_t op10mul(register w10_t a, register w10_t b)
 */
 dw10_t op10xmul(register w10_t a, register w10_t b)
 {
+#if OP10_USE64
+    /* Multiply 18-bit halves natively; each partial product fits in
+    ** 37 bits, so the 72-bit result can be assembled without overflow.
+    */
+    register uint64 al, ah, bl, bh, mid, t;
+    register dw10_t d;
+
+    ah = LHGET(a), al = RHGET(a);
+    bh = LHGET(b), bl = RHGET(b);
+    mid = ah*bl + al*bh;
+    t = al*bl + ((mid & H10MASK) << H10BITS);
+    W64SET(d.LO, t & W64MASK35);
+    t = (((ah*bh + (mid >> H10BITS)) << 1) + (t >> 35)) & W64MASK36;
+    W64SET(d.HI, t);
+    return d;
+#else
     register int ai, bi;
     register dw10_t d;
     uint32 av[NDIGS(36)], bv[NDIGS(36)], pv[2*NDIGS(36)];
@@ -1227,6 +1291,7 @@ dw10_t op10xmul(register w10_t a, register w10_t b)
     LHSET(d.HI, (pv[1] & ((1<<11)-1))<< (18-11) | (pv[2] >> 8) );
 #endif
     return d;
+#endif /* !OP10_USE64 */
 }
 
 /* IDIV and DIV.  Note that if these routines are used for instruction
@@ -1359,6 +1424,30 @@ static int x_div(
 	return 0;		/* Fail, no divide */
 
     /* Quick method - see if can do division in native arithmetic */
+#if OP10_USE64 && defined(__SIZEOF_INT128__)
+    /* If high word is less than divisor, quotient fits in 35 bits */
+    if (!wskipl(w) && !wskipl(d.HI) && op10m_ucmpl(d.HI, w)) {
+	register unsigned __int128 num;
+	register uint64 den;
+	num = ((unsigned __int128)W64GET(d.HI) << 35)
+		| (W64GET(d.LO) & W64MASK35);
+	den = W64GET(w);
+	W64SET(d.HI, (uint64)(num / den));
+	W64SET(d.LO, (uint64)(num % den));
+	DEBUGPRF(("idivquick: %o/%o Q: %lo,%lo R: %lo,%lo\n",
+		numsign, densign, DBGV_W(d.HI), DBGV_W(d.LO)));
+    } else
+#elif OP10_USE64
+    if (!wskipn(d.HI) && !wskipl(d.LO) && !wskipl(w)) {
+	register uint64 num, den;
+	num = W64GET(d.LO);
+	den = W64GET(w);
+	W64SET(d.HI, num / den);
+	W64SET(d.LO, num % den);
+	DEBUGPRF(("idivquick: %o/%o Q: %lo,%lo R: %lo,%lo\n",
+		numsign, densign, DBGV_W(d.HI), DBGV_W(d.LO)));
+    } else
+#endif
     if (!wskipn(d.HI) && !(LHGET(d.LO)&(~(HMASK>>4)))
       && !(LHGET(w)&(~(HMASK>>4)))) {
 	register uint32 num, den;
@@ -1941,9 +2030,29 @@ static w10_t ffadr(register w10_t a, register w10_t b, int flg)
     }
 
     /* Now right-shift B by the number of bits in i, then add to A. */
-    d.HI = x_ash(b, -i);		/* Shift B and put in hi word */
-    op10m_add(d.HI, a);			/* then add A to it */
-    d.LO = x_ash(b, 35-i);		/* Set 2nd word (low of B) */
+#if OP10_USE64
+    if (i <= 35) {
+	/* Both fractions fit in 28 bits, so the double-length sum
+	** A*2^35 + B*2^(35-i) fits in a signed 64-bit integer.
+	*/
+	register uint64 v;
+
+	v = (uint64)(W64SGET(a) * ((int64)1 << 35)
+		   + W64SGET(b) * ((int64)1 << (35-i)));
+	W64SET(d.LO, v & W64MASK35);
+	if (wskipl(b))			/* Low sign is that of B */
+	    op10m_signset(d.LO);
+	v >>= 35;			/* Extend sign into high word */
+	if (v & (W64SIGN36 >> 7))
+	    v |= W64MASK36 & ~((W64SIGN36 >> 6) - 1);
+	W64SET(d.HI, v);
+    } else
+#endif
+    {
+	d.HI = x_ash(b, -i);		/* Shift B and put in hi word */
+	op10m_add(d.HI, a);		/* then add A to it */
+	d.LO = x_ash(b, 35-i);		/* Set 2nd word (low of B) */
+    }
 
     DEBUGPRF(("FADR preN: (%o) %lo,%lo,%lo,%lo\n", expa, DBGV_D(d)));
 
@@ -2106,6 +2215,27 @@ static w10_t ffmpr(register w10_t a, register w10_t b, int dornd)
     exp += expb - 0200;
 
     /* Now multiply the 27-bit magnitude numbers (maybe 28-bit if neg) */
+#if OP10_USE64
+    {
+	/* Product has at most 55 bits, so normalize it natively; this
+	** is exactly the ASHC below, done in one shift.
+	*/
+	register uint64 p = W64GET(a) * W64GET(b);
+
+	if (!p)
+	    return w10zero;		/* Zero product, return 0.0 */
+# ifdef FFO64
+	i = FFO64(p) - 2;		/* Shift to put high bit at B9 */
+# else
+	W64SET(d.HI, p >> 35);
+	W64SET(d.LO, p & W64MASK35);
+	i = adffo(d) - SFEBITS;
+# endif
+	p <<= i;
+	W64SET(d.HI, p >> 35);
+	W64SET(d.LO, p & W64MASK35);
+    }
+#else
     d = op10xmul(a, b);		/* Multiply the numbers, get double result */
 
     /* The high 17 bits of product should be empty (1 sign, 16 magnitude bits)
@@ -2125,6 +2255,7 @@ static w10_t ffmpr(register w10_t a, register w10_t b, int dornd)
 
     /* OK, now normalize. */
     d = x_ashc(d, i);			/* Do ASHC bringing in zeros */
+#endif /* !OP10_USE64 */
     exp -= i - 8;
     DEBUGPRF(("FMP pstN: (%d.) %lo,%lo,%lo,%lo\n", exp, DBGV_D(d)));
 
@@ -2243,10 +2374,23 @@ int op10xfdv(w10_t *aw,
     ** unnormalized behavior??
     */
     i = (dornd ? 29 : 28);
+#if OP10_USE64
+    {
+	/* Dividend is less than divisor, so quotient fits in i bits.
+	** Remainder comes out already fixed up (never negative).
+	*/
+	register uint64 num = W64GET(a) << i;
+	register uint64 den = W64GET(b);
+
+	W64SET(d.HI, num / den);
+	W64SET(d.LO, num % den);
+    }
+#else
     if (!ddivstep(&d, b, i, 0)) {	/* Divide them, get double result */
 	OP10_PCFSET(PCF_ARO+PCF_TR1+PCF_FOV+PCF_DIV);
 	return 0;			/* Fail */
     }
+#endif
     exp += 35-i;			/* Adjust for partial division */
 
     DEBUGPRF(("FDV preN: Q: %lo,%lo R: %lo,%lo  E: %o\n", DBGV_D(d), exp));
@@ -3180,7 +3324,7 @@ dw10_t op10dfdv(register dw10_t a, register dw10_t b)
 			DBGV_Q(q), DBGV_D(b)));
 #endif
 
-    if (!qdivstep(&q, b, 63)) {
+    if (!qdivfrac(&q, b, 63)) {
 	OP10_PCFSET(PCF_ARO+PCF_TR1+PCF_FOV+PCF_DIV);
 	return a;
     }
@@ -3286,6 +3430,36 @@ static int qdivstep(qw10_t *aq,
     *aq = qw;
     return 1;
 }
+
+/* QDIVFRAC - Variant of qdivstep for floating-point fraction division,
+**	where the low double of the dividend is zero and only the quotient
+**	is wanted.  The remainder (high double of result) is NOT valid.
+**	If the host can do it, the division is done natively with a
+**	128-bit dividend instead of one step per quotient bit.
+*/
+static int qdivfrac(qw10_t *aq,
+		    register dw10_t d,
+		    register int nmagbits)
+{
+#if OP10_USE64 && defined(__SIZEOF_INT128__)
+    register uint64 num, den;
+
+    /* Get 70-bit magnitudes; only handle values that fit in 64 bits */
+    if (nmagbits <= 64
+      && !wskipl(aq->D0.HI) && !(W64GET(aq->D0.HI) >> 29)
+      && !wskipl(d.HI) && !(W64GET(d.HI) >> 29)) {
+	num = (W64GET(aq->D0.HI) << 35) | (W64GET(aq->D0.LO) & W64MASK35);
+	den = (W64GET(d.HI) << 35) | (W64GET(d.LO) & W64MASK35);
+	if (num >= den)
+	    return 0;		/* Overflow, no divide */
+	num = (uint64)(((unsigned __int128)num << nmagbits) / den);
+	W64SET(aq->D0.HI, num >> 35);
+	W64SET(aq->D0.LO, num & W64MASK35);
+	return 1;
+    }
+#endif
+    return qdivstep(aq, d, nmagbits);
+}
 
 #if OP10_GFMT
 
@@ -3796,7 +3970,7 @@ dw10_t op10gfdv(register dw10_t a, register dw10_t b)
     q.D0 = a;
     q.D1 = dw10zero;		/* Set up dividend */
 
-    if (!qdivstep(&q, b, 59+1)) {
+    if (!qdivfrac(&q, b, 59+1)) {
 	OP10_PCFSET(PCF_ARO+PCF_TR1+PCF_FOV+PCF_DIV);
 	return a;
     }
@@ -52,6 +52,9 @@ static void pag_enable(int);
 static void pag_clear(void);
 static void pag_mapclr(pment_t *);
 static void pag_segclr(pment_t *);
+#if KLH10_MCA25
+ static void pag_keepclr(void);
+#endif
 static void pag_nxmfail(paddr_t, pment_t, char *);
 
 /* Pager code */
@@ -141,8 +144,13 @@ pag_init(void)
     acblk_set(0, 0);		/* Set up cur & prev blocks */
 
     /* Set up physical memory "map" */
+    pag_mapgen(pr_pmap) = 0;
     for (i = 0; i < PAG_MAXVIRTPGS; ++i)
 	pr_pmap[i] = (VMF_READ|VMF_WRITE) | i;
+
+    /* Exec and User maps follow their generation words */
+    cpu.pr_umap = &cpu.pr_umapbuf[1];
+    cpu.pr_emap = &cpu.pr_emapbuf[1];
     pag_clear();		/* Clear Exec and User maps */
 
     pag_enable(0);		/* Ensure paging is off internally */
@@ -239,9 +247,23 @@ pag_enable(int onf)
     }
 }
 
-/* PAG_CLEAR - Invalidate all pager maps by clearing all internal entries.
-**	Perhaps optimize by keeping count of refills?  If count zero,
-**	don't need to re-clear the table.
+#if KLH10_MCA25
+/* Map entries made from page pointers with the 'K' bit, for pag_keepclr().
+**	The list need not be complete, since a kept page that doesn't get
+**	on it is simply refilled later.  Entries that have since been
+**	replaced or invalidated are weeded out by pag_keepclr().
+*/
+# define PAG_KEEPMAX 512	/* Same as # entries in KL hardware table */
+static struct pagkeep {
+    pment_t *pk_map;		/* Map containing entry */
+    pagno_t pk_pag;		/* Virtual page # of entry */
+} pag_keeplist[PAG_KEEPMAX];
+static int pag_nkeep;		/* # in use */
+#endif
+
+/* PAG_CLEAR - Invalidate all pager maps.
+**	This is cheap since it only bumps each map's generation; see
+**	pag_mapgen in kn10pag.h.
 */
 static void
 pag_clear(void)
@@ -249,22 +271,66 @@ pag_clear(void)
     PCCACHE_RESET();		/* Invalidate cached PC info */
     pag_mapclr(cpu.pr_umap);
     pag_mapclr(cpu.pr_emap);
+#if KLH10_MCA25
+    pag_nkeep = 0;
+#endif
 }
 
 static void		/* Ditto but one map only */
 pag_mapclr(register pment_t *p)
 {
-    memset((char *)p, 0, PAG_MAXVIRTPGS*sizeof(*p));
+    /* Start new generation.  If it wrapped, old entries made in
+    ** generation 0 could match again, so really clear them.  Same
+    ** goes for the generations saved in the BP cache.
+    */
+    if ((pag_mapgen(p) += PAG_GENUNIT) == 0) {
+	memset((char *)p, 0, PAG_MAXVIRTPGS*sizeof(*p));
+	BPCACHE_RESET();
+    }
 #if KLH10_CPU_KL
     cpu.mr_abk_pmflags = 0;
 #endif
 }
 
+#if KLH10_MCA25
+
+/* PAG_KEEPCLR - Invalidate pager maps as for pag_clear(), except for
+**	entries made from page pointers with the MCA25 'K' bit set.
+**	Used by WRUBR when it asks for kept pages to be preserved, so
+**	that pages the monitor marks as kept (typically its own) don't
+**	have to be refilled on every context switch.
+**	Kept entries that are still current are just re-stamped with
+**	the new generation.
+*/
+static void
+pag_keepclr(void)
+{
+    register struct pagkeep *kp, *np;
+    register pment_t ent;
+    register int n = pag_nkeep;
+    pment_t ugen = pag_mapgen(cpu.pr_umap);	/* Remember old gens */
+    pment_t egen = pag_mapgen(cpu.pr_emap);
+
+    pag_clear();			/* Invalidate everything */
+    for (np = kp = pag_keeplist; --n >= 0; ++kp) {
+	ent = kp->pk_map[kp->pk_pag];
+	if ((ent & VMF_KEEP)
+	  && (ent & PAG_GENMASK) == (kp->pk_map == cpu.pr_umap ? ugen : egen)) {
+	    kp->pk_map[kp->pk_pag] = (ent & ~PAG_GENMASK)
+					| pag_mapgen(kp->pk_map);
+	    *np++ = *kp;		/* Still kept, leave on list */
+	}
+    }
+    pag_nkeep = np - pag_keeplist;
+}
+#endif /* KLH10_MCA25 */
+
 /* Not actually used for anything */
 static void		/* Ditto but only half a map */
 pag_segclr(register pment_t *p)
 {
     memset((char *)p, 0, (PAG_MAXVIRTPGS/2)*sizeof(*p));
+    BPCACHE_RESET();
 #if KLH10_CPU_KL
     cpu.mr_abk_pmflags = 0;
 #endif
@@ -435,9 +501,15 @@ ioinsdef(io_wrubr)
 	cpu.mr_ubraddr = pag_pgtopa(RHGET(w) & UBR_BASEPAG);
 #endif
 
-	/* Also must reset cache and page table.
+	/* Also must reset cache and page table, except for kept
+	** entries if asked to (MCA25).
 	** KLH10 also resets its PC cache if any.
 	*/
+#if KLH10_MCA25
+	if (LHGET(w) & UBR_KEEP)
+	    pag_keepclr();
+	else
+#endif
 	pag_clear();		/* Or?  pag_mapclr(cpu.pr_umap); */
     }
 #if KLH10_DEBUG
@@ -468,6 +540,7 @@ ioinsdef(io_wrubr)
 ioinsdef(io_clrpt)
 {
     PCCACHE_RESET();			/* Invalidate cached PC info */
+    BPCACHE_RESET();			/* and cached byte pointers */
     cpu.pr_umap[va_page(e)] = 0;	/* Zapo! */
     cpu.pr_emap[va_page(e)] = 0;
 #if KLH10_CPU_KL
@@ -654,7 +727,8 @@ pag_refill(register pment_t *p,	/* Page map pointer */
 	} else
 #endif
 	{
-	    p[pag] = ent | (mapent & PM_PAG);	/* Won, set hardware table */
+	    p[pag] = ent | (mapent & PM_PAG)	/* Won, set hardware table */
+			| pag_mapgen(p);
 	    return vm_physmap(pag_pgtopa(mapent & PM_PAG) | va_pagoff(e));
 	}
     } else {
@@ -1319,6 +1393,9 @@ ioinsdef(io_do_apr)
 {
     uint32 w;
 
+    PCCACHE_RESET();		/* Break page must not stay in PC cache */
+    BPCACHE_RESET();		/* nor in the byte pointer cache */
+
     /* Remove any prior address break */	
 
     if (cpu.mr_abk_pagno != -1) {
@@ -1347,10 +1424,15 @@ ioinsdef(io_do_apr)
 	if (cpu.mr_abk_cond & ABK_WRITE)
 	    cpu.mr_abk_pmmask &= ~VMF_WRITE;	    
 
-	/* Save page access flags and clear them so all refs cause a refill */
+	/* Save page access flags and clear them so all refs cause a refill.
+	** An entry left over from an older generation has no valid
+	** access; its stale bits must not let pag_refill skip the refill.
+	*/
 	cpu.mr_abk_pmap =
 	    (cpu.mr_abk_cond & ABK_USER) ? cpu.pr_umap : cpu.pr_emap;
-	cpu.mr_abk_pmflags = cpu.mr_abk_pmap[cpu.mr_abk_pagno] & VMF_ACC;
+	cpu.mr_abk_pmflags =
+	    pag_mapcur(cpu.mr_abk_pmap, cpu.mr_abk_pagno)
+		? (cpu.mr_abk_pmap[cpu.mr_abk_pagno] & VMF_ACC) : 0;
 	cpu.mr_abk_pmap[cpu.mr_abk_pagno] &= cpu.mr_abk_pmmask;
     }
 
@@ -1550,8 +1632,10 @@ pag_refill(register pment_t *p,	/* Page map pointer */
 	    goto pfault;			/* go set VIRT etc */
 	}
 
-	/* No break, recalculate access using true pager flags */
-	if (f & cpu.mr_abk_pmflags) {
+	/* No break, recalculate access using true pager flags,
+	** provided they're from the current map generation.
+	*/
+	if ((f & cpu.mr_abk_pmflags) && pag_mapcur(p, vpag)) {
 	    /* abk_pagno is in section 0-37, no need to range check vpag */
 	    return vm_physmap(pag_pgtopa(p[vpag]&PAG_PAMSK) | va_pagoff(e));
 	}
@@ -1661,6 +1745,9 @@ pag_t20map(register pment_t *p,	/* Page map pointer */
     register h10_t accbits = 0;
     register paddr_t paddr;
     register pagno_t pag, pgn;
+#if KLH10_MCA25
+    register h10_t keep = 0;	/* 'K' bit from last page map pointer */
+#endif
 
     accbits = PT_WACC | PT_CACHE /* | PT_PACC */ ;	/* Start with these */
 
@@ -1791,6 +1878,9 @@ pag_t20map(register pment_t *p,	/* Page map pointer */
 	w = vm_pget(vm_physmap(paddr));		/* Get page map entry */
 
 	/* Handle map pointer */
+#if KLH10_MCA25
+	keep = LHGET(w) & PT_KEEP;	/* Only page map pointers count */
+#endif
 	switch (LHGET(w) >> 15) {		/* Get map pointer type */
 	default:
 	case PTT_NOACC:
@@ -1898,21 +1988,36 @@ pag_t20map(register pment_t *p,	/* Page map pointer */
 	    return NULL;			/* Fail, page not writable */
 	}
     }
+#if KLH10_MCA25
+    accbits |= keep;
+#endif
     cpu.pag.pr_flh = accbits;		/* Remember bits in case MAP */
 
     /* Won completely, update internal page map!
     ** VMF_READ serves the function of a 'valid' bit, and
     ** VMF_WRITE serves as the 'M' (modified) bit.  M should be set only
     **	if the page is writable *and* M is set in the CST.
+    ** VMF_KEEP (MCA25 only) is the 'K' bit.
     ** There is no need or support for an internal 'C' (cacheable) bit.
-    ** Likewise for any other bits (P, K) at the moment.
+    ** Likewise for the P bit at the moment.
     */
-    p[vpag] = pag | VMF_READ
+    p[vpag] = pag | VMF_READ | pag_mapgen(p)
 		 | ((accbits & CST_MBIT) ? VMF_WRITE : 0);
+#if KLH10_MCA25
+    if (keep) {
+	p[vpag] |= VMF_KEEP;
+	if (pag_nkeep < PAG_KEEPMAX) {		/* Remember it if room */
+	    pag_keeplist[pag_nkeep].pk_map = p;
+	    pag_keeplist[pag_nkeep++].pk_pag = vpag;
+	}
+    }
+#endif
 
 #if KLH10_CPU_KL
     /* If page vpag contains the address break address, clear its
     ** access flags so that refs will cause a refill.
+    ** The entry was just made in the current generation, so its
+    ** flags can be saved as they are.
     */
     if (vpag == cpu.mr_abk_pagno && p == cpu.mr_abk_pmap) {
 	cpu.mr_abk_pmflags = p[vpag] & VMF_ACC;
@@ -1924,6 +2029,89 @@ pag_t20map(register pment_t *p,	/* Page map pointer */
 }
 
 #endif /* T20 (KL) paging */
+
+/* PAG_BLKSPAN - Used by block transfer instructions (BLT, XBLT) so they
+**	can move more than one word per mapping.  Given the source and
+**	destination addresses of the next word to move, returns how many
+**	words (at most max) can be moved using the mappings of just those
+**	two words, ie without either address leaving its page or running
+**	into the ACs.  If rev is set the transfer is descending and the
+**	addresses are those of the highest words.
+**	Always 1 for an AC reference, and also while an address break
+**	is set, since those can only be handled by mapping every word.
+*/
+int32
+pag_blkspan(register vaddr_t src,
+	    register vaddr_t dst,
+	    int32 max,
+	    int rev)
+{
+    register int32 n, m;
+
+#if KLH10_EXTADR
+    if (va_isacref(src) || va_isacref(dst))
+	return 1;
+#else
+    if (!(src & (H10MASK&(~AC_MASK))) || !(dst & (H10MASK&(~AC_MASK))))
+	return 1;
+#endif
+#if KLH10_CPU_KL
+    if (cpu.mr_abk_pagno != -1)
+	return 1;
+#endif
+    if (rev) {
+	/* Going down, stop short of the ACs if in page 0 of a section */
+	n = va_pagoff(src) + 1;
+	if (va_insect(src) < PAG_SIZE && n > AC_17+1)
+	    n -= AC_17+1;
+	m = va_pagoff(dst) + 1;
+	if (va_insect(dst) < PAG_SIZE && m > AC_17+1)
+	    m -= AC_17+1;
+    } else {
+	n = PAG_SIZE - va_pagoff(src);
+	m = PAG_SIZE - va_pagoff(dst);
+    }
+    if (n > m)
+	n = m;
+    return (n < max) ? n : max;
+}
+
+/* PAG_BLKMOVE - Move n words of physical memory from svp to dvp, with
+**	the same result as moving them one at a time in ascending order
+**	(or descending, if rev is set, in which case the pointers are to
+**	the highest words).  When the destination overlaps the source
+**	further along in that order, each word moved is picked up again
+**	later, so a pattern is replicated; this is the usual BLT idiom for
+**	clearing memory.  Anything else is a plain memmove().
+*/
+void
+pag_blkmove(register vmptr_t dvp,
+	    register vmptr_t svp,
+	    register int32 n,
+	    int rev)
+{
+    if (!rev) {
+	if (svp < dvp && dvp < svp + n) {	/* Replicating overlap */
+	    do {
+		vm_pset(dvp, vm_pget(svp));
+		++dvp, ++svp;
+	    } while (--n > 0);
+	    return;
+	}
+    } else {
+	if (dvp < svp && svp < dvp + n) {	/* Replicating overlap */
+	    do {
+		vm_pset(dvp, vm_pget(svp));
+		--dvp, --svp;
+	    } while (--n > 0);
+	    return;
+	}
+	dvp -= n-1;			/* Point to lowest words */
+	svp -= n-1;
+    }
+    memmove((char *)dvp, (char *)svp, (size_t)n * sizeof(w10_t));
+}
+
 
 #if KLH10_EXTADR
 
@@ -72,8 +72,11 @@
 # define PAG_BITS 9
 #endif
 
-#define PAG_VMFBITS 2	/* # of access bits needed in page table */
-			/* (See VMF_ flags) */
+#if KLH10_MCA25
+# define PAG_VMFBITS 3	/* # of access bits needed in page table */
+#else			/* (See VMF_ flags; MCA25 adds keep bit) */
+# define PAG_VMFBITS 2
+#endif
 
 /* The remaining definitions are more or less all derived
 ** from the above parameters.
@@ -134,10 +137,14 @@
 #endif
 	typedef unsigned KLH10_PAGNO_T pagno_t;
 
+/* pment_t also holds a map generation number above the PAG_PMEBITS
+** bits of the entry proper (see pag_mapgen), so ask for at least
+** 8 bits more than that.
+*/
 #ifndef KLH10_PMENT_T		/* Permit compile-time override */
-# if (SHRT_MAX > (1L<<(PAG_PMEBITS-2)))
+# if (SHRT_MAX > (1L<<(PAG_PMEBITS+8-2)))
 #  define KLH10_PMENT_T short
-# elif (INT_MAX > (1L<<(PAG_PMEBITS-2)))
+# elif (INT_MAX > (1L<<(PAG_PMEBITS+8-2)))
 #  define KLH10_PMENT_T int
 # else
 #  define KLH10_PMENT_T long
@@ -457,23 +464,53 @@ struct vmregs {
 # endif
 #endif
 
-#define VMF_NOTRAP ((pment_t)1<<(PAG_PMEBITS-3)) /* Flag for pag_refill() */
-					/* NOT used in map entry! */
+#if KLH10_MCA25
+# define VMF_KEEP ((pment_t)1<<(PAG_PMEBITS-3))	/* Kept (MCA25 'K' bit) */
+#endif
+
+#define VMF_NOTRAP ((pment_t)1<<(PAG_PMEBITS-PAG_VMFBITS-1))
+				/* Flag for pag_refill(), NOT used in map entry! */
 
 /* Extra flag used with VMF_READ to distinguish instruction fetch
 ** references for address break and whatever else becomes important.
 ** For example, it might provide a way of indicating that the address
 ** (ie PC) is forcibly interpreted as local.
 */
-#define VMF_IFETCH ((pment_t)1<<(PAG_PMEBITS-4)) /* Flag for pag_refill() */
- 					/* NOT used in map entry! */
+#define VMF_IFETCH ((pment_t)1<<(PAG_PMEBITS-PAG_VMFBITS-2))
+				/* Flag for pag_refill(), NOT used in map entry! */
 #define VMF_FETCH (VMF_READ | VMF_IFETCH)
 
 /* Flag used with VMF_READ or VMF_WRITE to flag doubleword refs, so
 ** address break can trap if the low word hits.
 */
-#define VMF_DWORD ((pment_t)1<<(PAG_PMEBITS-5)) /* Flag for pag_refill() */
- 					/* NOT used in map entry! */
+#define VMF_DWORD ((pment_t)1<<(PAG_PMEBITS-PAG_VMFBITS-3))
+				/* Flag for pag_refill(), NOT used in map entry! */
+
+/* Page map generations.
+**	Every internal page map is preceded by a word holding its current
+**	generation number, kept in the pment_t bits above PAG_PMEBITS.
+**	Map entries are stamped with the generation they were made in, and
+**	are only valid while it matches, so pag_mapclr() can invalidate a
+**	whole map just by bumping its generation.  The map only needs to be
+**	really cleared when the generation number wraps around to 0.
+**	A zero entry is invalid in any generation.
+*/
+#define PAG_GENUNIT ((pment_t)1<<PAG_PMEBITS)	/* Generation increment */
+#define PAG_GENMASK ((pment_t)~(PAG_GENUNIT-1))	/* Generation field */
+#define pag_mapgen(m) ((m)[-1])		/* Current generation of map m */
+
+/* PAG_MAPOK - TRUE if entry for page pg of map m is current and allows
+**	access f (only one of VMF_READ or VMF_WRITE).
+*/
+#define pag_mapok(m,pg,f) \
+    ((((m)[pg] ^ pag_mapgen(m)) & (PAG_GENMASK|((f)&VMF_ACC))) \
+	== ((f)&VMF_ACC))
+
+/* PAG_MAPCUR - TRUE if entry for page pg of map m is of the current
+**	generation, i.e. its access bits mean something.
+*/
+#define pag_mapcur(m,pg) \
+    ((((m)[pg] ^ pag_mapgen(m)) & PAG_GENMASK) == 0)
 
 /* VM_XMAP - Map virtual address in given context to physical address.
 **	Page faults if requested access cannot be granted, unless
@@ -488,7 +525,7 @@ struct vmregs {
 #define vm_xmap(v,f,a,m)	/* Vaddr, AccessFlags, ACblock, MapPointer */\
     (((v) & (H10MASK&(~AC_MASK)))==0		\
 	? ac_xmap((v)&AC_MASK, (a))		/* AC ref, use AC block */\
-	: ( ((m)[va_page(v)] & ((f)&VMF_ACC)) /* Mem ref, check map */\
+	: ( pag_mapok(m, va_page(v), f)	/* Mem ref, check map */\
 	     ? vm_physmap(pag_pgtopa((m)[va_page(v)]&PAG_PAMSK) \
 						| ((v) & PAG_MASK)) \
 	     : pag_refill((pment_t *)(m),(vaddr_t)(v),(pment_t)(f)) \
@@ -497,7 +534,7 @@ struct vmregs {
 #define vm_xtrymap(v,f,a,m)	/* Vaddr, AccessFlags, ACblock, MapPointer */\
     (((v) & (H10MASK&(~AC_MASK)))==0		\
 	? ac_xmap((v)&AC_MASK, (a))		/* AC ref, use AC block */\
-	: ( ((m)[va_page(v)] & ((f)&VMF_ACC)) /* Mem ref, check map */\
+	: ( pag_mapok(m, va_page(v), f)	/* Mem ref, check map */\
 	     ? vm_physmap(pag_pgtopa((m)[va_page(v)]&PAG_PAMSK) \
 						| ((v) & PAG_MASK)) \
 	     : (vmptr_t)0	\
@@ -510,7 +547,7 @@ struct vmregs {
     (va_isacref(v)				\
 	? ac_xmap(va_ac(v), (a))		/* AC ref, use AC block */\
 	: ((va_isoksect(v)			/* Verify section OK */\
-	   && ((m)[va_page(v)] & ((f)&VMF_ACC))) /* Mem ref, check map */\
+	   && pag_mapok(m, va_page(v), f))	/* Mem ref, check map */\
 	     ? vm_physmap(pag_pgtopa((m)[va_page(v)]&PAG_PAMSK) \
 						| va_pagoff(v)) \
 	     : pag_refill((pment_t *)(m),(vaddr_t)(v),(pment_t)(f)) \
@@ -520,7 +557,7 @@ struct vmregs {
     (va_isacref(v)				\
 	? ac_xmap(va_ac(v), (a))		/* AC ref, use AC block */\
 	: ((va_isoksect(v)			/* Verify section OK */\
-	   && ((m)[va_page(v)] & ((f)&VMF_ACC))) /* Mem ref, check map */\
+	   && pag_mapok(m, va_page(v), f))	/* Mem ref, check map */\
 	     ? vm_physmap(pag_pgtopa((m)[va_page(v)]&PAG_PAMSK) \
 						| va_pagoff(v)) \
 	     : (vmptr_t) 0	\
@@ -537,7 +574,7 @@ struct vmregs {
     (PC_ISACREF				\
 	? ac_xmap(PC_AC, (a))		/* AC ref, use AC block */\
 	: ( ((PC_PAGE & PAG_NXSMSK)==0 /* Verify section OK */\
-	   && ((m)[PC_PAGE] & ((f)&VMF_ACC)))	/* Mem ref, check map */\
+	   && pag_mapok(m, PC_PAGE, f))	/* Mem ref, check map */\
 	     ? vm_physmap(pag_pgtopa((m)[PC_PAGE]&PAG_PAMSK) | PC_PAGOFF) \
 	     : pag_refill((pment_t *)(m),(vaddr_t)PC_VADDR,(pment_t)(f)) \
 	))
@@ -687,6 +724,8 @@ struct vmregs {
 /* Internal "hardware" page tables.
 **	The user and exec maps are now in the "cpu" struct for locality.
 **	The physical map is rarely used so is left here.
+**	Each has an extra word in front for its generation; the physical
+**	map's is always 0.
 */
 #ifndef EXTDEF
 # define EXTDEF extern	/* Default is to declare (not define) vars */
@@ -695,7 +734,8 @@ struct vmregs {
 EXTDEF pment_t pr_umap[PAG_MAXVIRTPGS];	/* Internal user mode map table */
 EXTDEF pment_t pr_emap[PAG_MAXVIRTPGS];	/*   "      exec  "    "    "   */
 #endif
-EXTDEF pment_t pr_pmap[PAG_MAXVIRTPGS];	/*   "      physical   "    "   */
+EXTDEF pment_t pr_pmapbuf[1+PAG_MAXVIRTPGS];	/* Internal physical map */
+#define pr_pmap (pr_pmapbuf+1)
 
 /* ITS Pager definitions */
 
@@ -969,6 +1009,10 @@ extern vmptr_t pag_refill(pment_t *, vaddr_t, pment_t);
 
 extern void pag_fail(void);	/* Effect page-fail trap */
 
+	/* Help for block transfers (BLT, XBLT) */
+extern int32 pag_blkspan(vaddr_t, vaddr_t, int32, int);
+extern void pag_blkmove(vmptr_t, vmptr_t, int32, int);
+
 #if KLH10_CPU_KS
 extern void pag_iofail(paddr_t, int);	/* PF trap for IO unibus ref */
 #endif
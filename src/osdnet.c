@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <time.h>
+#include <poll.h>	/* For osn_pfreadnb_fd */
 
 /* The possible configuration macro definitions, with defaults:
  */
@@ -55,12 +56,14 @@ static struct ifent *osn_iftab_addaddress(char *name, struct sockaddr *addr, str
 #if KLH10_NET_PCAP
 static void osn_pfinit_pcap(struct pfdata *pfdata, struct osnpf *osnpf, void *pfarg);
 static ssize_t osn_pfread_pcap(struct pfdata *pfdata, void *buf, size_t nbytes);
+static ssize_t osn_pfreadnb_pcap(struct pfdata *pfdata, void *buf, size_t nbytes);
 static ssize_t osn_pfwrite_pcap(struct pfdata *pfdata, const void *buf, size_t nbytes);
 #endif /* KLH10_NET_PCAP */
 #if KLH10_NET_TUN || KLH10_NET_TAP
 static void osn_pfinit_tuntap(struct pfdata *pfdata, struct osnpf *osnpf, void *pfarg);
 static void osn_pfdeinit_tuntap(struct pfdata *pfdata, struct osnpf *osnpf);
 static ssize_t osn_pfread_fd(struct pfdata *pfdata, void *buf, size_t nbytes);
+static ssize_t osn_pfreadnb_fd(struct pfdata *pfdata, void *buf, size_t nbytes);
 static ssize_t osn_pfwrite_fd(struct pfdata *pfdata, const void *buf, size_t nbytes);
 #endif /* TUN || TAP */
 
@@ -75,6 +78,7 @@ static int pfopen_create(char *basename, struct tuntap_context *tt_ctx, struct o
 static void osn_pfinit_vde(struct pfdata *pfdata, struct osnpf *osnpf, void *pfarg);
 static void osn_pfdeinit_vde(struct pfdata *pfdata, struct osnpf *osnpf);
 static ssize_t osn_pfread_vde(struct pfdata *pfdata, void *buf, size_t nbytes);
+static ssize_t osn_pfreadnb_vde(struct pfdata *pfdata, void *buf, size_t nbytes);
 static ssize_t osn_pfwrite_vde(struct pfdata *pfdata, const void *buf, size_t nbytes);
 #endif /* KLH10_NET_VDE */
 #if KLH10_NET_TUN || KLH10_NET_TAP || KLH10_NET_VDE
@@ -1421,6 +1425,18 @@ osn_pfread(struct pfdata *pfdata, void *buf, size_t nbytes)
     return pfdata->pf_read(pfdata, buf, nbytes);
 }
 
+/*
+ * Like osn_pfread, but never waits: returns 0 if no packet is ready yet.
+ * Used to pick up the rest of a burst after a blocking read has returned.
+ */
+ssize_t
+osn_pfreadnb(struct pfdata *pfdata, void *buf, size_t nbytes)
+{
+    if (!pfdata->pf_readnb)
+	return 0;
+    return pfdata->pf_readnb(pfdata, buf, nbytes);
+}
+
 int
 osn_pfwrite(struct pfdata *pfdata, const void *buf, size_t nbytes)
 {
@@ -1434,6 +1450,43 @@ osn_pfdeinit(struct pfdata *pfdata, struct osnpf *osnpf)
 	pfdata->pf_deinit(pfdata, osnpf);
 }
 
+#if KLH10_NET_PCAP || KLH10_NET_LNXBPF
+/*
+ * Put a (new) BPF program into effect in the kernel, replacing any
+ * previous one, so unwanted packets never reach us.
+ * Returns TRUE if it worked, FALSE if the method can't do it.
+ */
+int
+osn_pfsetfilter(struct pfdata *pfdata, struct bpf_program *pf)
+{
+    switch (pfdata->pf_meth) {
+#if KLH10_NET_PCAP
+    case PF_METH_PCAP:
+	if (pcap_setfilter(pfdata->pf_handle, pf) < 0) {
+	    error("pcap_setfilter failed: %s", pcap_geterr(pfdata->pf_handle));
+	    return FALSE;
+	}
+	return TRUE;
+#endif
+#if KLH10_NET_LNXBPF
+    case PF_METH_TAP:
+      {
+	struct sock_fprog fprog;
+
+	fprog.len = pf->bf_len;
+	fprog.filter = (struct sock_filter *)pf->bf_insns;
+	if (ioctl(pfdata->pf_fd, TUNATTACHFILTER, &fprog) < 0) {
+	    syserr(errno, "TUNATTACHFILTER failed");
+	    return FALSE;
+	}
+	return TRUE;
+      }
+#endif
+    }
+    return FALSE;
+}
+#endif /* KLH10_NET_PCAP || KLH10_NET_LNXBPF */
+
 #if KLH10_NET_PCAP
 static
 void
@@ -1461,6 +1514,7 @@ osn_pfinit_pcap(struct pfdata *pfdata, struct osnpf *osnpf, void *pfarg)
 
     pfdata->pf_meth = PF_METH_PCAP;
     pfdata->pf_read = osn_pfread_pcap;
+    pfdata->pf_readnb = osn_pfreadnb_pcap;
     pfdata->pf_write = osn_pfwrite_pcap;
     pfdata->pf_deinit = NULL;
     pfdata->pf_handle = pc = pcap_create(ifnam, errbuf);
@@ -1535,6 +1589,15 @@ osn_pfinit_pcap(struct pfdata *pfdata, struct osnpf *osnpf, void *pfarg)
 
     pfdata->pf_fd = pcap_get_selectable_fd(pc);
 
+    /* Make the handle non-blocking once and for all, rather than
+       switching it around every osn_pfreadnb_pcap() call.
+       osn_pfread_pcap() then does its waiting in poll().  With no fd
+       to poll, stay blocking and do without osn_pfreadnb().
+     */
+    pfdata->pf_rdtmo = osnpf->osnpf_rdtmo ? osnpf->osnpf_rdtmo * 1000 : -1;
+    if (pfdata->pf_fd < 0 || pcap_setnonblock(pc, 1, errbuf) < 0)
+	pfdata->pf_readnb = NULL;
+
 #if !HAVE_PCAP_SET_IMMEDIATE_MODE && defined(BIOCIMMEDIATE)
     /* Try to set immediate mode another way. Assume BPF since we know how to
      * do that. But don't complain if it fails, since libpcap may use
@@ -1598,6 +1661,18 @@ tryagain:
 	return nbytes;
     }
 
+    if (pfdata->pf_readnb) {	/* Non-blocking handle, so wait here */
+	struct pollfd myfd;
+	int n;
+
+	myfd.fd = pfdata->pf_fd;
+	myfd.events = POLLIN;
+	n = poll(&myfd, 1, pfdata->pf_rdtmo);
+	if (n > 0 || (n < 0 && errno == EINTR))
+	    goto tryagain;
+	return n;		/* 0 if timed out */
+    }
+
 #if CENV_SYS_NETBSD
 	    /* NetBSD bpf is broken.
 	       See osdnet.c:osn_pfinit() comments re BIOCIMMEDIATE to
@@ -1625,6 +1700,29 @@ tryagain:
     return 0;
 }
 
+/*
+ * As above, but only if a packet is already waiting.
+ * On Linux, libpcap reads whole blocks of a TPACKET ring at a time,
+ * so this usually just hands back the next packet of the current block.
+ * Only used when osn_pfinit_pcap() made the handle non-blocking.
+ */
+static
+ssize_t
+osn_pfreadnb_pcap(struct pfdata *pfdata, void *buf, size_t nbytes)
+{
+    struct pcap_pkthdr pkt_header;
+    const u_char *pkt_data;
+
+    pkt_data = pcap_next(pfdata->pf_handle, &pkt_header);
+
+    if (!pkt_data)
+	return 0;
+    if (pkt_header.caplen < nbytes)
+	nbytes = pkt_header.caplen;
+    memcpy(buf, pkt_data, nbytes);
+    return nbytes;
+}
+
 /*
  * Like the standard write(2) call:
  * Expect a full ethernet frame including link-layer header.
@@ -1978,6 +2076,7 @@ osn_pfinit_tuntap(struct pfdata *pfdata, struct osnpf *osnpf, void *arg)
     pfdata->pf_handle = &tt_ctx;
     pfdata->pf_can_filter = pfdata->pf_ip4_only;
     pfdata->pf_read = osn_pfread_fd;
+    pfdata->pf_readnb = osn_pfreadnb_fd;
     pfdata->pf_write = osn_pfwrite_fd;
     pfdata->pf_deinit = osn_pfdeinit_tuntap;
 
@@ -2019,6 +2118,23 @@ osn_pfread_fd(struct pfdata *pfdata, void *buf, size_t nbytes)
     return read(pfdata->pf_fd, buf, nbytes);
 }
 
+/*
+ * As above, but only if a packet is already waiting.
+ * Tun/tap devices aren't sockets, so recvmmsg(2) can't be used here.
+ */
+static
+ssize_t
+osn_pfreadnb_fd(struct pfdata *pfdata, void *buf, size_t nbytes)
+{
+    struct pollfd myfd;
+
+    myfd.fd = pfdata->pf_fd;
+    myfd.events = POLLIN;
+    if (poll(&myfd, 1, 0) <= 0 || !(myfd.revents & POLLIN))
+	return 0;
+    return read(pfdata->pf_fd, buf, nbytes);
+}
+
 /*
  * Like the standard write(2) call:
  * Expect a full ethernet frame including link-layer header.
@@ -2315,6 +2431,7 @@ osn_pfinit_vde(struct pfdata *pfdata, struct osnpf *osnpf, void *pfarg)
 	pfdata->pf_can_filter = FALSE;
 	pfdata->pf_ip4_only = FALSE;
 	pfdata->pf_read = osn_pfread_vde;
+	pfdata->pf_readnb = osn_pfreadnb_vde;
 	pfdata->pf_write = osn_pfwrite_vde;
 	pfdata->pf_deinit = osn_pfdeinit_vde;
     }
@@ -2338,6 +2455,18 @@ osn_pfread_vde(struct pfdata *pfdata, void *buf, size_t nbytes)
     return len;
 }
 
+static
+ssize_t
+osn_pfreadnb_vde(struct pfdata *pfdata, void *buf, size_t nbytes)
+{
+    ssize_t len = vde_recv((VDECONN *)pfdata->pf_handle, buf, nbytes,
+			   MSG_DONTWAIT);
+
+    if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	return 0;
+    return len;
+}
+
 static
 ssize_t
 osn_pfwrite_vde(struct pfdata *pfdata, const void *buf, size_t nbytes)
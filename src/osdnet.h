@@ -89,6 +89,10 @@
 # include <pcap/bpf.h>
 # define KLH10_NET_PCAP 1
 #endif
+#if HAVE_LINUX_IF_TUN_H && defined(TUNATTACHFILTER)
+# include <linux/filter.h>	/* For struct sock_fprog */
+# define KLH10_NET_LNXBPF 1	/* Can run BPF filter on a tap device */
+#endif
 #if HAVE_GETIFADDRS
 # include <ifaddrs.h>
 #endif
@@ -134,6 +138,21 @@
 #ifndef  KLH10_NET_PCAP	/* pretty generic libpcap interface */
 # define KLH10_NET_PCAP 0
 #endif
+#ifndef  KLH10_NET_LNXBPF /* Linux TUNATTACHFILTER */
+# define KLH10_NET_LNXBPF 0
+#endif
+
+#if KLH10_NET_LNXBPF && !KLH10_NET_PCAP
+/* Without libpcap, describe BPF programs with the kernel's own
+   struct sock_filter, under the names <pcap/bpf.h> would provide.
+*/
+# define bpf_insn sock_filter
+typedef __u32 bpf_u_int32;
+struct bpf_program {
+    u_int bf_len;
+    struct bpf_insn *bf_insns;
+};
+#endif
 #ifndef FALSE
 # define FALSE 0
 #endif
@@ -300,6 +319,8 @@ struct pfdata {
     int 	 pf_can_filter;	/* has a packet filter built-in and enabled */
     int		 pf_ip4_only;	/* set TRUE for IP i/f; FALSE for ethernet i/f */
     osn_pfread_f pf_read;	/* indirection to packet reading function */
+    osn_pfread_f pf_readnb;	/* same, but returns 0 rather than block */
+    int		 pf_rdtmo;	/* pcap: ms for pf_read to wait, -1 forever */
     osn_pfwrite_f pf_write;	/* indirection to packet writing function */
     osn_pfdeinit_f pf_deinit;	/* indirection to closing function */
 };
@@ -359,8 +380,12 @@ struct osnpf {	/* Arg struct for common initialization params */
 /* the void * is an argument to pass on to pfbuild() */
 void osn_pfinit(struct pfdata *, struct osnpf *, void *);
 void osn_pfdeinit(struct pfdata *, struct osnpf *);
+#if KLH10_NET_PCAP || KLH10_NET_LNXBPF
+int osn_pfsetfilter(struct pfdata *, struct bpf_program *);
+#endif
 
 ssize_t osn_pfread(struct pfdata *pfdata, void *buf, size_t nbytes);
+ssize_t osn_pfreadnb(struct pfdata *pfdata, void *buf, size_t nbytes);
 int osn_pfwrite(struct pfdata *pfdata, const void *buf, size_t nbytes);
 
 extern char osn_networking[];
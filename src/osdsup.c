@@ -881,6 +881,73 @@ os_fdwrite(osfd_t fd,
     return TRUE;
 }
 
+/* Positional versions of the above, which do not use or change the
+**	file position, so a transfer is a single call and several threads
+**	may use the same fd.  Otherwise same as os_fdseek then os_fdread
+**	or os_fdwrite.
+*/
+int
+os_fdpread(osfd_t fd,
+	   char *buf,
+	   size_t len, osdaddr_t addr, size_t *ares)
+{
+#if CENV_SYS_UNIX
+    register ssize_t res = pread(fd, buf, len, addr);
+    if (res < 0) {
+	if (ares) *ares = 0;
+	return FALSE;
+    }
+    if (ares) *ares = res;
+    return TRUE;
+#else
+    if (!os_fdseek(fd, addr)) {
+	if (ares) *ares = 0;
+	return FALSE;
+    }
+    return os_fdread(fd, buf, len, ares);
+#endif
+}
+
+int
+os_fdpwrite(osfd_t fd,
+	    char *buf,
+	    size_t len, osdaddr_t addr, size_t *ares)
+{
+#if CENV_SYS_UNIX
+    register ssize_t res = pwrite(fd, buf, len, addr);
+    if (res < 0) {
+	if (ares) *ares = 0;
+	return FALSE;
+    }
+    if (ares) *ares = res;
+    return TRUE;
+#else
+    if (!os_fdseek(fd, addr)) {
+	if (ares) *ares = 0;
+	return FALSE;
+    }
+    return os_fdwrite(fd, buf, len, ares);
+#endif
+}
+
+/* Force data written to FD out to the disk itself, as far as the host
+**	allows, so it is known to be there before anything that depends
+**	on it is written.
+*/
+int
+os_fdsync(osfd_t fd)
+{
+#if CENV_SYS_UNIX
+# if defined(_POSIX_SYNCHRONIZED_IO) && (_POSIX_SYNCHRONIZED_IO > 0)
+    return fdatasync(fd) == 0;
+# else
+    return fsync(fd) == 0;
+# endif
+#else
+    return TRUE;
+#endif
+}
+
 /* Support for "atomic" intflag reference.
 **	Intended to work like EXCH, not always truly atomic but
 **	close enough.  As function to prevent optimizing away
@@ -80,6 +80,9 @@ extern int os_fdopen(osfd_t *, char *, char *);
 extern int os_fdseek(osfd_t, osdaddr_t);
 extern int os_fdread(osfd_t, char *, size_t, size_t *);
 extern int os_fdwrite(osfd_t, char *, size_t, size_t *);
+extern int os_fdpread(osfd_t, char *, size_t, osdaddr_t, size_t *);
+extern int os_fdpwrite(osfd_t, char *, size_t, osdaddr_t, size_t *);
+extern int os_fdsync(osfd_t);
 extern int os_fdclose(osfd_t);
 
 
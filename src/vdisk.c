@@ -38,8 +38,16 @@
 #include "rcsid.h"
 #include "word10.h"
 #include "osdsup.h"
+#include "wfio.h"		/* For shared H36 packing macros */
 #include "vdisk.h"
 
+#if VDK_MMAP
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
 #ifdef RCSID
  RCSID(vdisk_c,"$Id: vdisk.c,v 2.5 2002/05/21 09:47:06 klh Exp $")
 #endif
@@ -53,6 +61,20 @@
 static void VDK_FORMATS;	/* Automate function predecls */
 # undef vdk_fmt
 
+#if VDK_MMAP
+static int vdk_mmount(struct vdk_unit *);
+static int vdk_mmio(struct vdk_unit *, int, w10_t *, uint32, int);
+#endif
+#if VDK_SPARSE
+static int vdk_smount(struct vdk_unit *, int);
+static void vdk_sunmount(struct vdk_unit *);
+static int vdk_sio(struct vdk_unit *, int, w10_t *, uint32, int);
+#endif
+#if VDK_CACHE
+static int vdk_cmount(struct vdk_unit *);
+static void vdk_cunmount(struct vdk_unit *);
+#endif
+
 static struct {
 	char *fmt_name;		/* Short name of format */
 	int fmt_siz;		/* # bytes in a double-word */
@@ -111,6 +133,7 @@ vdk_mount(register struct vdk_unit *d,
 	  int wrtf)
 {
     size_t cvtsiz;
+    int created;
 
     if (!d->dk_devname[0]) {
 	d->dk_err = EINVAL;	/* Invalid arg */
@@ -139,6 +162,13 @@ vdk_mount(register struct vdk_unit *d,
 	d->dk_err = EINVAL;
 	return FALSE;
     }
+#if !VDK_SPARSE
+    if (d->dk_format == VDK_FMT_VDKS) {
+	vdkerror(d, "vdk_mount: VDKS format not supported");
+	d->dk_err = EINVAL;
+	return FALSE;
+    }
+#endif
 
     /* If doing any kind of conversions, will need buffer */
     if (d->dk_fmt2wds || d->dk_wds2fmt) {
@@ -189,6 +219,7 @@ vdk_mount(register struct vdk_unit *d,
 
     /* Actually open the real device! */
     d->dk_iswrite = wrtf;			/* See if writing */
+    created = FALSE;
     if (!os_fdopen(&d->dk_fd, path, (wrtf ? "+b" : "rb"))) {
 	/* Diskfile doesn't appear to exist, try to create it */
 	fprintf(stderr, "[Creating %s disk file \"%s\"]\r\n",
@@ -199,6 +230,7 @@ vdk_mount(register struct vdk_unit *d,
 	    d->dk_err = errno;
 	    return FALSE;
 	}
+	created = TRUE;
 #if VDK_DISKMAP
 	if (d->dk_ismap && !vdk_mapcreate(d)) {
 	    vdkerror(d, "vdk_mount: Cannot create disk map");
@@ -226,28 +258,583 @@ vdk_mount(register struct vdk_unit *d,
     }
     strcpy(d->dk_filename, path);
 
+#if VDK_SPARSE
+    d->dk_sidx = NULL;
+    if ((d->dk_format == VDK_FMT_VDKS) && !vdk_smount(d, created)) {
+	/* smount should set dkerr */
+	os_fdclose(d->dk_fd);
+	free(d->dk_filename);
+	d->dk_filename = NULL;
+	return FALSE;
+    }
+#endif
+#if VDK_MMAP
+    d->dk_mmbase = NULL;
+    if (d->dk_mmap)
+	(void) vdk_mmount(d);		/* If can't map, just do normal I/O */
+#endif
+#if VDK_CACHE
+    d->dk_cents = NULL;
+    if (d->dk_csize
+# if VDK_MMAP
+      && !d->dk_mmbase			/* Mapped pack needs no cache */
+# endif
+      && !vdk_cmount(d))
+	vdkerror(d, "vdk_mount: Cannot alloc %u-sector cache, not caching",
+			d->dk_csize);
+#endif
+
     return TRUE;
 }
 
 int
 vdk_unmount(register struct vdk_unit *d)
 {
+    int res = 1;
+
     if (d->dk_filename) {
+#if VDK_CACHE
+	if (d->dk_cents) {
+	    if (!vdk_flush(d))
+		res = 0;		/* Report it, but unmount anyway */
+	    vdk_cunmount(d);
+	}
+#endif
 #if VDK_DISKMAP
 	if (d->dk_ismap) {
 	    if (!vdk_unmap(d))
 		return 0;
 	}
+#endif
+#if VDK_SPARSE
+	if (d->dk_sidx)
+	    vdk_sunmount(d);
+#endif
+#if VDK_MMAP
+	if (d->dk_mmbase) {
+	    /* Always flush, whatever dk_msync says */
+	    (void) msync((void *)d->dk_mmbase, d->dk_mmsize, MS_SYNC);
+	    (void) munmap((void *)d->dk_mmbase, d->dk_mmsize);
+	    d->dk_mmbase = NULL;
+	}
 #endif
 	if (!os_fdclose(d->dk_fd))
 	    return 0;
 	free(d->dk_filename);
 	d->dk_filename = NULL;
     }
-    return 1;
+    return res;
 }
 
-/* Read from disk.
+#if VDK_MMAP
+
+/* Memory-mapped RAW packs.
+**	A RAW pack is just an image of the emulated words, so when it is
+**	mapped a transfer is simply a copy between the mapping and the
+**	word buffer (normally the 10's memory).  The OS writes the pages
+**	back as it likes, or when dk_msync says to.
+**	The whole pack is mapped, so a writable file that is too short is
+**	extended first (sparsely).  Note that a write into a hole when the
+**	host filesystem is full, or any access past the end of a file that
+**	something else has truncated, gets SIGBUS rather than an error
+**	return, and the KLH10 dies.
+*/
+static int
+vdk_mmount(register struct vdk_unit *d)
+{
+    struct stat st;
+    size_t size;
+    void *ptr;
+
+    if (d->dk_fmt2wds || d->dk_wds2fmt) {
+	vdkerror(d, "vdk_mount: Only RAW format can be mapped, not mapping");
+	return FALSE;
+    }
+    size = (size_t)d->dk_ncyls * d->dk_ntrks * d->dk_nsecs
+		* VDK_NWDS(d) * sizeof(w10_t);
+    if (fstat(d->dk_fd, &st) < 0) {
+	vdkerror(d, "vdk_mount: fstat failed, not mapping - errno = %d",
+			errno);
+	return FALSE;
+    }
+    if ((osdaddr_t)st.st_size < (osdaddr_t)size) {
+	if (!d->dk_iswrite || !S_ISREG(st.st_mode)
+	  || ftruncate(d->dk_fd, (off_t)size) < 0) {
+	    vdkerror(d, "vdk_mount: Pack smaller than disk, not mapping");
+	    return FALSE;
+	}
+    }
+    ptr = mmap((void *)NULL, size,
+		PROT_READ | (d->dk_iswrite ? PROT_WRITE : 0),
+		MAP_SHARED, d->dk_fd, (off_t)0);
+    if (ptr == MAP_FAILED) {
+	vdkerror(d, "vdk_mount: mmap failed, not mapping - errno = %d",
+			errno);
+	return FALSE;
+    }
+    d->dk_mmbase = (unsigned char *)ptr;
+    d->dk_mmsize = size;
+    return TRUE;
+}
+
+static int
+vdk_mmio(register struct vdk_unit *d,
+	 int wrtf, w10_t *wp, uint32 secaddr, int nsec)
+{
+    register size_t boff, bcnt;
+    size_t pgoff;
+
+    boff = (size_t)secaddr * VDK_NWDS(d) * sizeof(w10_t);
+    bcnt = (size_t)nsec * VDK_NWDS(d) * sizeof(w10_t);
+    if (boff >= d->dk_mmsize)
+	bcnt = 0;
+    else if (bcnt > d->dk_mmsize - boff)
+	bcnt = d->dk_mmsize - boff;	/* Only do what's on the disk */
+
+    if (!wrtf) {
+	memcpy((char *)wp, (char *)d->dk_mmbase + boff, bcnt);
+    } else if (bcnt) {
+	memcpy((char *)d->dk_mmbase + boff, (char *)wp, bcnt);
+	if (d->dk_msync != VDK_MSYNC_NONE) {
+	    pgoff = boff % (size_t)getpagesize();	/* Must start on page */
+	    if (msync((void *)(d->dk_mmbase + boff - pgoff), bcnt + pgoff,
+		      (d->dk_msync == VDK_MSYNC_SYNC ? MS_SYNC : MS_ASYNC))
+		< 0) {
+		d->dk_err = errno;
+		vdkerror(d, "vdk_write: msync failed, errno = %d", errno);
+		return 0;
+	    }
+	}
+    }
+    nsec = bcnt / (VDK_NWDS(d) * sizeof(w10_t));
+    if (!nsec) {
+	d->dk_err = EINVAL;
+	vdkerror(d, "vdk_%s: Non-ex sector %ld",
+			(wrtf ? "write" : "read"), (long)secaddr);
+    }
+    return nsec;
+}
+
+#endif /* VDK_MMAP */
+
+/* Make conversion buffer big enough for NSEC sectors if possible, up to
+**	VDK_CVTMAX bytes.  If it can't be grown, the old one is still fine.
+*/
+static void
+vdk_bufset(register struct vdk_unit *d, int nsec)
+{
+    register size_t want = (size_t)nsec * d->dk_bytesec;
+    unsigned char *nbuf;
+
+    if (want <= d->dk_bufsiz)
+	return;
+    if (want > VDK_CVTMAX)
+	want = (VDK_CVTMAX / d->dk_bytesec) * d->dk_bytesec;
+    if (want <= d->dk_bufsiz
+      || !(nbuf = (unsigned char *)malloc(want)))
+	return;
+    free(d->dk_buf);
+    d->dk_buf = nbuf;
+    d->dk_bufsiz = want;
+    d->dk_bufsecs = want / d->dk_bytesec;
+}
+
+#if VDK_SPARSE
+
+/* Sparse and overlay packs (VDKS format).
+**	The file holds only the blocks that have been written, found through
+**	an index kept in memory while mounted (see vdisk.h for the layout).
+**	A pack can name a base pack, which is opened read-only; any block
+**	this pack doesn't hold is read from the base.  This lets many
+**	writable overlays share one read-only "golden" pack.
+**	Block data is stored in DBD9 format, 9 bytes per word pair.  A block
+**	that is all zeros takes no data space.
+**	New block data is written and synced to disk before its index entry
+**	is written, so the index never points at data that isn't there;
+**	a crash can lose at most the block being allocated.
+*/
+
+static void
+vdk_sput(register unsigned char *ucp, register int n, osdaddr_t val)
+{
+    while (--n >= 0) {
+	ucp[n] = val & 0377;
+	val >>= 8;
+    }
+}
+
+static osdaddr_t
+vdk_sget(register unsigned char *ucp, register int n)
+{
+    register osdaddr_t val = 0;
+
+    while (--n >= 0)
+	val = (val << 8) | *ucp++;
+    return val;
+}
+
+/* Write index entry for block BLK out to the pack.
+*/
+static int
+vdk_sidxput(register struct vdk_unit *d, uint32 blk)
+{
+    unsigned char ebuf[8];
+    size_t ndone = 0;
+
+    vdk_sput(ebuf, 8, d->dk_sidx[blk]);
+    if (!os_fdpwrite(d->dk_fd, (char *)ebuf, sizeof(ebuf),
+		     (osdaddr_t)VDK_SHDRSIZ + ((osdaddr_t)blk * 8), &ndone)
+      || (ndone != sizeof(ebuf))) {
+	d->dk_err = errno;
+	vdkerror(d, "vdk_write: index update failed, errno = %d", errno);
+	return FALSE;
+    }
+    return TRUE;
+}
+
+/* Set up a VDKS pack just opened by vdk_mount.
+**	If CREATED, the file is new and must be given a header, which names
+**	the base pack dk_sbpath (if set).
+*/
+static int
+vdk_smount(register struct vdk_unit *d, int created)
+{
+    unsigned char hdr[VDK_SHDRSIZ];
+    unsigned char *ibuf = NULL;
+    size_t isiz, ndone = 0;
+    register uint32 i;
+    uint32 nsecs, nblks;
+    osdaddr_t ent, blkbytes;
+    int fmt;
+
+    nsecs = (uint32)d->dk_ncyls * d->dk_ntrks * d->dk_nsecs;
+    if (created) {
+	memset((char *)hdr, 0, sizeof(hdr));
+	strcpy((char *)hdr, VDK_SMAGIC);
+	vdk_sput(hdr+VDK_SH_VER, 4, (osdaddr_t)VDK_SVERSION);
+	vdk_sput(hdr+VDK_SH_SECBLK, 4, (osdaddr_t)VDK_SBLKSECS);
+	vdk_sput(hdr+VDK_SH_NSECS, 4, (osdaddr_t)nsecs);
+	vdk_sput(hdr+VDK_SH_NWDS, 4, (osdaddr_t)VDK_NWDS(d));
+	nblks = (nsecs + VDK_SBLKSECS - 1) / VDK_SBLKSECS;
+	vdk_sput(hdr+VDK_SH_NBLKS, 4, (osdaddr_t)nblks);
+	if (d->dk_sbpath && *d->dk_sbpath) {
+	    if (strlen(d->dk_sbpath) >= VDK_SBPATHMAX
+	      || (d->dk_sbfmt < 0) || (d->dk_sbfmt >= VDK_FMT_N)) {
+		vdkerror(d, "vdk_mount: Bad base pack spec");
+		d->dk_err = EINVAL;
+		return FALSE;
+	    }
+	    strcpy((char *)hdr+VDK_SH_BFMT, vdkfmttab[d->dk_sbfmt].fmt_name);
+	    strcpy((char *)hdr+VDK_SH_BPATH, d->dk_sbpath);
+	}
+	/* Write header, then last byte of index so rest reads as zeros */
+	if (!os_fdpwrite(d->dk_fd, (char *)hdr, sizeof(hdr), (osdaddr_t)0,
+			 &ndone)
+	  || (ndone != sizeof(hdr))
+	  || !os_fdpwrite(d->dk_fd, (char *)hdr+VDK_SH_NBLKS+4, 1,
+		(osdaddr_t)VDK_SHDRSIZ + ((osdaddr_t)nblks * 8) - 1, &ndone)
+	  || (ndone != 1)) {
+	    vdkerror(d, "vdk_mount: Cannot write header, errno = %d", errno);
+	    d->dk_err = errno;
+	    return FALSE;
+	}
+    }
+
+    /* Read and check header */
+    if (!os_fdpread(d->dk_fd, (char *)hdr, sizeof(hdr), (osdaddr_t)0, &ndone)
+      || (ndone != sizeof(hdr))
+      || memcmp((char *)hdr, VDK_SMAGIC, sizeof(VDK_SMAGIC)-1) != 0) {
+	vdkerror(d, "vdk_mount: Not a VDKS pack");
+	d->dk_err = EINVAL;
+	return FALSE;
+    }
+    if (vdk_sget(hdr+VDK_SH_VER, 4) != VDK_SVERSION) {
+	vdkerror(d, "vdk_mount: Unknown VDKS version %ld",
+			(long)vdk_sget(hdr+VDK_SH_VER, 4));
+	d->dk_err = EINVAL;
+	return FALSE;
+    }
+    d->dk_sblksec = vdk_sget(hdr+VDK_SH_SECBLK, 4);
+    nblks = vdk_sget(hdr+VDK_SH_NBLKS, 4);
+    if ((vdk_sget(hdr+VDK_SH_NSECS, 4) != nsecs)
+      || (vdk_sget(hdr+VDK_SH_NWDS, 4) != VDK_NWDS(d))
+      || (d->dk_sblksec == 0)
+      || (nblks != (nsecs + d->dk_sblksec - 1) / d->dk_sblksec)) {
+	vdkerror(d, "vdk_mount: VDKS pack geometry doesn't match %.16s",
+			d->dk_devname);
+	d->dk_err = EINVAL;
+	return FALSE;
+    }
+
+    /* Read index, and find end of block data */
+    vdk_bufset(d, d->dk_sblksec);
+    if (d->dk_bufsecs < d->dk_sblksec) {
+	vdkerror(d, "vdk_mount: VDKS block size too big");
+	d->dk_err = EINVAL;
+	return FALSE;
+    }
+    isiz = (size_t)nblks * 8;
+    if (!(ibuf = (unsigned char *)malloc(isiz))
+      || !(d->dk_sidx = (osdaddr_t *)malloc(nblks * sizeof(osdaddr_t)))
+      || !(d->dk_swds = (w10_t *)malloc(d->dk_sblksec * VDK_NWDS(d)
+						* sizeof(w10_t)))) {
+	vdkerror(d, "vdk_mount: Cannot alloc VDKS index");
+	d->dk_err = errno;
+	if (ibuf)
+	    free(ibuf);
+	vdk_sunmount(d);
+	return FALSE;
+    }
+    if (!os_fdpread(d->dk_fd, (char *)ibuf, isiz, (osdaddr_t)VDK_SHDRSIZ,
+		    &ndone)
+      || (ndone != isiz)) {
+	vdkerror(d, "vdk_mount: Cannot read VDKS index, errno = %d", errno);
+	d->dk_err = errno ? errno : EINVAL;
+	free(ibuf);
+	vdk_sunmount(d);
+	return FALSE;
+    }
+    d->dk_snblks = nblks;
+    blkbytes = (osdaddr_t)d->dk_sblksec * d->dk_bytesec;
+    d->dk_sfree = (osdaddr_t)VDK_SHDRSIZ + isiz;
+    d->dk_sfree = ((d->dk_sfree + VDK_SHDRSIZ - 1) / VDK_SHDRSIZ)
+				* VDK_SHDRSIZ;	/* Data starts block-aligned */
+    for (i = 0; i < nblks; ++i) {
+	ent = d->dk_sidx[i] = vdk_sget(ibuf + (i * 8), 8);
+	if ((ent > VDK_SIDX_ZERO) && (ent + blkbytes > d->dk_sfree))
+	    d->dk_sfree = ent + blkbytes;
+    }
+    free(ibuf);
+
+    /* Mount base pack, if any.  It is never written. */
+    if (hdr[VDK_SH_BPATH]) {
+	hdr[VDK_SHDRSIZ-1] = '\0';
+	hdr[VDK_SH_BPATH-1] = '\0';
+	for (fmt = 0; fmt < VDK_FMT_N; ++fmt)
+	    if (strcmp((char *)hdr+VDK_SH_BFMT, vdkfmttab[fmt].fmt_name) == 0)
+		break;
+	if (fmt >= VDK_FMT_N) {
+	    vdkerror(d, "vdk_mount: Unknown base pack format \"%.16s\"",
+			(char *)hdr+VDK_SH_BFMT);
+	    d->dk_err = EINVAL;
+	    vdk_sunmount(d);
+	    return FALSE;
+	}
+	if (d->dk_sdepth >= VDK_SMAXDEPTH) {
+	    vdkerror(d, "vdk_mount: Too many overlays on \"%.256s\"",
+			(char *)hdr+VDK_SH_BPATH);
+	    d->dk_err = EINVAL;
+	    vdk_sunmount(d);
+	    return FALSE;
+	}
+	if (!(d->dk_sbase = (struct vdk_unit *)malloc(sizeof(*d)))) {
+	    vdkerror(d, "vdk_mount: Cannot alloc base pack");
+	    d->dk_err = errno;
+	    vdk_sunmount(d);
+	    return FALSE;
+	}
+	vdk_init(d->dk_sbase, d->dk_errhan, d->dk_errarg);
+	strcpy(d->dk_sbase->dk_devname, d->dk_devname);
+	d->dk_sbase->dk_format = fmt;
+	d->dk_sbase->dk_dtype = d->dk_dtype;
+	d->dk_sbase->dk_ncyls = d->dk_ncyls;
+	d->dk_sbase->dk_ntrks = d->dk_ntrks;
+	d->dk_sbase->dk_nsecs = d->dk_nsecs;
+	d->dk_sbase->dk_nwds = d->dk_nwds;
+	d->dk_sbase->dk_sdepth = d->dk_sdepth + 1;
+	if (!vdk_mount(d->dk_sbase, (char *)hdr+VDK_SH_BPATH, FALSE)) {
+	    vdkerror(d, "vdk_mount: Cannot mount base pack \"%.256s\"",
+			(char *)hdr+VDK_SH_BPATH);
+	    d->dk_err = d->dk_sbase->dk_err;
+	    vdk_sunmount(d);
+	    return FALSE;
+	}
+    }
+    return TRUE;
+}
+
+static void
+vdk_sunmount(register struct vdk_unit *d)
+{
+    if (d->dk_sbase) {
+	if (vdk_ismounted(d->dk_sbase))
+	    (void) vdk_unmount(d->dk_sbase);
+	if (d->dk_sbase->dk_buf)
+	    free(d->dk_sbase->dk_buf);
+	free((char *)d->dk_sbase);
+	d->dk_sbase = NULL;
+    }
+    if (d->dk_swds) {
+	free((char *)d->dk_swds);
+	d->dk_swds = NULL;
+    }
+    if (d->dk_sidx) {
+	free((char *)d->dk_sidx);
+	d->dk_sidx = NULL;
+    }
+}
+
+/* TRUE if sector is held by this pack itself (rather than its base).
+*/
+int
+vdk_sisset(register struct vdk_unit *d, uint32 secaddr)
+{
+    register uint32 blk;
+
+    if (!d->dk_sidx)
+	return TRUE;		/* Not sparse, everything is here */
+    blk = secaddr / d->dk_sblksec;
+    return (blk < d->dk_snblks) && (d->dk_sidx[blk] != VDK_SIDX_NONE);
+}
+
+/* Put a block into the pack that it doesn't yet have.
+**	WP has the whole block.  All zeros just marks the index.
+*/
+static int
+vdk_snew(register struct vdk_unit *d, uint32 blk, w10_t *wp)
+{
+    register w10_t *zp = wp;
+    register int i = d->dk_sblksec * VDK_NWDS(d);
+    size_t bcnt, ndone = 0;
+
+    for (; --i >= 0; ++zp)
+	if (LHGET(*zp) || RHGET(*zp))
+	    break;
+    if (i < 0) {			/* All zeros? */
+	if (d->dk_sidx[blk] == VDK_SIDX_ZERO
+	  || (d->dk_sidx[blk] == VDK_SIDX_NONE && !d->dk_sbase))
+	    return TRUE;		/* Already reads as zeros */
+	d->dk_sidx[blk] = VDK_SIDX_ZERO;
+	return vdk_sidxput(d, blk);
+    }
+
+    (*d->dk_wds2fmt)(d->dk_buf, wp, (int)(d->dk_sblksec * VDK_NWDS(d)));
+    bcnt = d->dk_sblksec * d->dk_bytesec;
+    if (!os_fdpwrite(d->dk_fd, (char *)d->dk_buf, bcnt, d->dk_sfree, &ndone)
+      || (ndone != bcnt)) {
+	d->dk_err = errno;
+	vdkerror(d, "vdk_write: failed, cnt %ld, ret %ld, errno = %d",
+			(long)bcnt, (long)ndone, errno);
+	return FALSE;
+    }
+    if (!os_fdsync(d->dk_fd)) {		/* Data must be there before index */
+	d->dk_err = errno;
+	vdkerror(d, "vdk_write: sync failed, errno = %d", errno);
+	return FALSE;
+    }
+    d->dk_sidx[blk] = d->dk_sfree;
+    d->dk_sfree += bcnt;
+    return vdk_sidxput(d, blk);
+}
+
+/* Read or write a VDKS pack.
+**	Return # sectors done.
+**	Runs of blocks that are contiguous in the file are done with one I/O
+**	call, up to the size of the conversion buffer.
+*/
+static int
+vdk_sio(register struct vdk_unit *d,
+	int wrtf, w10_t *wp, uint32 secaddr, int nsec)
+{
+    register uint32 blk, nb;
+    register osdaddr_t ent;
+    osdaddr_t blkbytes = (osdaddr_t)d->dk_sblksec * d->dk_bytesec;
+    uint32 totsecs = (uint32)d->dk_ncyls * d->dk_ntrks * d->dk_nsecs;
+    unsigned off, n;
+    int secleft = nsec;
+    size_t bcnt, ndone = 0;
+
+    while (secleft > 0) {
+	if (secaddr >= totsecs) {
+	    d->dk_err = EINVAL;
+	    vdkerror(d, "vdk_%s: Non-ex sector %ld",
+			(wrtf ? "write" : "read"), (long)secaddr);
+	    break;
+	}
+	blk = secaddr / d->dk_sblksec;
+	off = secaddr % d->dk_sblksec;
+	n = d->dk_sblksec - off;
+	if (n > (unsigned)secleft)
+	    n = secleft;
+	if (n > totsecs - secaddr)
+	    n = totsecs - secaddr;
+	ent = d->dk_sidx[blk];
+
+	if (ent > VDK_SIDX_ZERO) {
+	    /* Block is here; extend through following contiguous blocks */
+	    for (nb = blk + 1;
+		 (n < (unsigned)secleft) && (nb < d->dk_snblks)
+		   && (d->dk_sidx[nb] == ent + (nb - blk) * blkbytes)
+		   && (n + d->dk_sblksec <= d->dk_bufsecs);
+		 ++nb) {
+		n += d->dk_sblksec;
+		if (n > (unsigned)secleft)
+		    n = secleft;
+		if (n > totsecs - secaddr)
+		    n = totsecs - secaddr;
+	    }
+	    ent += (osdaddr_t)off * d->dk_bytesec;
+	    bcnt = n * d->dk_bytesec;
+	    if (wrtf) {
+		(*d->dk_wds2fmt)(d->dk_buf, wp, (int)(n * VDK_NWDS(d)));
+		if (!os_fdpwrite(d->dk_fd, (char *)d->dk_buf, bcnt, ent,
+				 &ndone) || (ndone != bcnt)) {
+		    d->dk_err = errno;
+		    vdkerror(d,
+			"vdk_write: failed, cnt %ld, ret %ld, errno = %d",
+			(long)bcnt, (long)ndone, errno);
+		    break;
+		}
+	    } else {
+		if (!os_fdpread(d->dk_fd, (char *)d->dk_buf, bcnt, ent,
+				&ndone) || (ndone != bcnt)) {
+		    d->dk_err = errno ? errno : EIO;
+		    vdkerror(d,
+			"vdk_read: failed, cnt %ld, ret %ld, errno = %d",
+			(long)bcnt, (long)ndone, errno);
+		    break;
+		}
+		(*d->dk_fmt2wds)(wp, (int)(n * VDK_NWDS(d)), d->dk_buf);
+	    }
+
+	} else if (wrtf) {
+	    /* New block for this pack.  If only part of it is being
+	    ** written, fill in the rest from what it reads as now.
+	    */
+	    if (n != d->dk_sblksec) {
+		nb = blk * d->dk_sblksec;	/* First sector of block */
+		memset((char *)d->dk_swds, 0,	/* In case block is short */
+			d->dk_sblksec * VDK_NWDS(d) * sizeof(w10_t));
+		if (vdk_sio(d, FALSE, d->dk_swds, nb,
+			    (totsecs - nb < d->dk_sblksec)
+				? (int)(totsecs - nb) : (int)d->dk_sblksec)
+			<= 0)
+		    break;
+		memcpy((char *)(d->dk_swds + (off * VDK_NWDS(d))), (char *)wp,
+			n * VDK_NWDS(d) * sizeof(w10_t));
+		if (!vdk_snew(d, blk, d->dk_swds))
+		    break;
+	    } else if (!vdk_snew(d, blk, wp))
+		break;
+
+	} else if ((ent == VDK_SIDX_NONE) && d->dk_sbase) {
+	    if (vdk_read(d->dk_sbase, wp, secaddr, (int)n) != (int)n) {
+		d->dk_err = d->dk_sbase->dk_err;
+		break;
+	    }
+	} else
+	    memset((char *)wp, 0, n * VDK_NWDS(d) * sizeof(w10_t));
+
+	secleft -= n;
+	secaddr += n;
+	wp += n * VDK_NWDS(d);
+    }
+    return nsec - secleft;
+}
+
+#endif /* VDK_SPARSE */
+
+/* VDK_DREAD - Read from disk, bypassing any cache.
 **	Return # sectors read.
 **
 **	Raw (no-conversion) case reads directly to word buffer.
@@ -256,11 +843,11 @@ vdk_unmount(register struct vdk_unit *d)
 **	    now independent threads/processes and CPU shouldn't ever see
 **	    the intermediate forms!
 */
-int
-vdk_read(register struct vdk_unit *d,
-	 w10_t *wp,		/* Word buffer to read data */
-	 uint32 secaddr,	/* Sector addr on disk */
-	 int nsec)		/* # sectors - Never more than 16 bits */
+static int
+vdk_dread(register struct vdk_unit *d,
+	  w10_t *wp,		/* Word buffer to read data */
+	  uint32 secaddr,	/* Sector addr on disk */
+	  int nsec)		/* # sectors - Never more than 16 bits */
 {
 #if VDK_DISKMAP
     register osdaddr_t dwaddr;
@@ -285,22 +872,25 @@ vdk_read(register struct vdk_unit *d,
 
     d->dk_err = 0;
 
+#if VDK_MMAP
+    if (d->dk_mmbase)			/* Mapped RAW pack? */
+	return vdk_mmio(d, FALSE, wp, secaddr, nsec);
+#endif
+#if VDK_SPARSE
+    if (d->dk_sidx)			/* Sparse or overlay pack? */
+	return vdk_sio(d, FALSE, wp, secaddr, nsec);
+#endif
+
     if (d->dk_fmt2wds == NULL) {	/* RAW input?  (No conversion) */
 
 	daddr = ((osdaddr_t)secaddr) * VDK_NWDS(d) * sizeof(w10_t);
 	bcnt = nsec * VDK_NWDS(d) * sizeof(w10_t);
 
-	if (!os_fdseek(d->dk_fd, daddr)) {
-	    d->dk_err = errno;		/* OS DEP!! */
-	    vdkerror(d, "vdk_read: seek failed for %"
-		     OSDADDR_FMT "d, errno = %d", daddr, errno);
-	    return 0;			/* Later do something better? */
-	}
-
-	if (!os_fdread(d->dk_fd, (char *)wp, bcnt, &ndone)) {
+	if (!os_fdpread(d->dk_fd, (char *)wp, bcnt, daddr, &ndone)) {
 	    d->dk_err = errno;		/* OS DEP!! */
-	    vdkerror(d, "vdk_read: failed: cnt %ld, ret %ld, errno = %d",
-		     (long)bcnt, (long)ndone, errno);
+	    vdkerror(d, "vdk_read: failed at %" OSDADDR_FMT
+		     "d: cnt %ld, ret %ld, errno = %d",
+		     daddr, (long)bcnt, (long)ndone, errno);
 	    return ndone / (VDK_NWDS(d) * sizeof(w10_t));
 	}
 
@@ -315,20 +905,14 @@ vdk_read(register struct vdk_unit *d,
     }
 
     /* Any other kind of format comes here -- requires using another buffer.
-    ** Speed is not of the essence for the following cases.
-    ** An inner loop is used because the buffer may not be large enough to
-    ** hold the entire transfer requested.  It will always, however, be large
-    ** enough to hold at least one sector at a time.
+    ** The buffer is grown to hold the whole transfer if possible, so this
+    ** is normally a single read; an inner loop handles the rest, as the
+    ** buffer will always be large enough for at least one sector.
     */
+    vdk_bufset(d, nsec);
 
     /* Set up for OS I/O */
     daddr = ((osdaddr_t)secaddr) * d->dk_bytesec; /* Disk addr in bytes */
-    if (!os_fdseek(d->dk_fd, daddr)) {
-	d->dk_err = errno;		/* OS DEP!! */
-	vdkerror(d, "vdk_read: seek failed for %" OSDADDR_FMT "d, errno = %d",
-			daddr, errno);
-	return 0;
-    }
 
     secleft = nsec;
     while (secleft > 0) {
@@ -338,7 +922,7 @@ vdk_read(register struct vdk_unit *d,
 	secwant = (secleft <= d->dk_bufsecs) ? secleft : d->dk_bufsecs;
 	bcnt = secwant * d->dk_bytesec;		/* # bytes to read */
 
-	err = !os_fdread(d->dk_fd, (char *) d->dk_buf, bcnt, &ndone);
+	err = !os_fdpread(d->dk_fd, (char *) d->dk_buf, bcnt, daddr, &ndone);
 
 	/* Find # sectors read in (ie need conversion) */
 	secdone = (ndone == bcnt) ? secwant : (ndone / d->dk_bytesec);
@@ -346,6 +930,7 @@ vdk_read(register struct vdk_unit *d,
 	    (*d->dk_fmt2wds)(wp, (int)(secdone * VDK_NWDS(d)), d->dk_buf);
 	    secleft -= secdone;
 	    wp += secdone * VDK_NWDS(d);
+	    daddr += secdone * d->dk_bytesec;
 	}
 
 	if (err) {
@@ -371,17 +956,17 @@ vdk_read(register struct vdk_unit *d,
 #endif /* !VDK_DISKMAP */
 }
 
-/* Write to disk.
+/* VDK_DWRITE - Write to disk, bypassing any cache.
 **	Return # sectors written.
 **
 **	Raw (no-conversion) case writes directly from word buffer.
 **	Conversion cases use intermediate buffer.
 */
-int
-vdk_write(register struct vdk_unit *d,
-	  w10_t *wp,		/* Word buffer to read data */
-	  uint32 secaddr,	/* Sector addr on disk */
-	  int nsec)		/* # sectors - Never more than 16 bits */
+static int
+vdk_dwrite(register struct vdk_unit *d,
+	   w10_t *wp,		/* Word buffer to read data */
+	   uint32 secaddr,	/* Sector addr on disk */
+	   int nsec)		/* # sectors - Never more than 16 bits */
 {
 #if VDK_DISKMAP
     register osdaddr_t dwaddr;
@@ -406,21 +991,24 @@ vdk_write(register struct vdk_unit *d,
 
     d->dk_err = 0;
 
+#if VDK_MMAP
+    if (d->dk_mmbase)			/* Mapped RAW pack? */
+	return vdk_mmio(d, TRUE, wp, secaddr, nsec);
+#endif
+#if VDK_SPARSE
+    if (d->dk_sidx)			/* Sparse or overlay pack? */
+	return vdk_sio(d, TRUE, wp, secaddr, nsec);
+#endif
+
     if (d->dk_wds2fmt == NULL) {	/* RAW output?  (No conversion) */
 
 	daddr = ((osdaddr_t)secaddr) * VDK_NWDS(d) * sizeof(w10_t);
 	bcnt = nsec * VDK_NWDS(d) * sizeof(w10_t);
 
-	if (!os_fdseek(d->dk_fd, daddr)) {
-	    vdkerror(d, "vdk_write: seek failed for %" OSDADDR_FMT
-		     "d, errno = %d", daddr, errno);
-	    d->dk_err = errno;		/* OS DEP!! */
-	    return 0;			/* Later do something better? */
-	}
-
-	if (!os_fdwrite(d->dk_fd, (char *)wp, bcnt, &ndone)) {
-	    vdkerror(d, "vdk_write: failed: cnt %ld, ret %ld, errno = %d",
-			    (long)bcnt, (long)ndone, errno);
+	if (!os_fdpwrite(d->dk_fd, (char *)wp, bcnt, daddr, &ndone)) {
+	    vdkerror(d, "vdk_write: failed at %" OSDADDR_FMT
+		     "d: cnt %ld, ret %ld, errno = %d",
+		     daddr, (long)bcnt, (long)ndone, errno);
 	    d->dk_err = errno;		/* OS DEP!! */
 	    return ndone / (VDK_NWDS(d) * sizeof(w10_t));
 	}
@@ -428,20 +1016,12 @@ vdk_write(register struct vdk_unit *d,
     }
 
     /* Any other kind of format comes here -- may require using another buffer.
-    ** Speed is not of the essence for the following cases.
-    ** An inner loop is used because the buffer may not be large enough to
-    ** hold the entire transfer requested.  It will always, however, be large
-    ** enough to hold at least one sector at a time.
+    ** As for vdk_read, this is normally a single write.
     */
+    vdk_bufset(d, nsec);
 
     /* Set up for OS I/O */
     daddr = ((osdaddr_t)secaddr) * d->dk_bytesec; /* Disk addr in bytes */
-    if (!os_fdseek(d->dk_fd, daddr)) {
-	vdkerror(d, "vdk_read: seek failed for %" OSDADDR_FMT "d, errno = %d",
-			daddr, errno);
-	d->dk_err = errno;		/* OS DEP!! */
-	return 0;
-    }
 
     secleft = nsec;
     while (secleft > 0) {
@@ -455,13 +1035,14 @@ vdk_write(register struct vdk_unit *d,
 
 	bcnt = secwant * d->dk_bytesec;		/* # bytes to write */
 
-	err = !os_fdwrite(d->dk_fd, (char *) d->dk_buf, bcnt, &ndone);
+	err = !os_fdpwrite(d->dk_fd, (char *) d->dk_buf, bcnt, daddr, &ndone);
 
 	/* Find # sectors written */
 	secdone = (ndone == bcnt) ? secwant : (ndone / d->dk_bytesec);
 	if (secdone) {
 	    secleft -= secdone;
 	    wp += secdone * VDK_NWDS(d);
+	    daddr += secdone * d->dk_bytesec;
 	}
 
 	if (err || (secdone != secwant)) {
@@ -476,6 +1057,275 @@ vdk_write(register struct vdk_unit *d,
 #endif /* !VDK_DISKMAP */
 }
 
+#if VDK_CACHE
+
+/* Sector cache.
+**	Keeps the dk_csize most recently used sectors in memory, already
+**	in word form, so that the monitor re-reading its directories and
+**	index blocks needs neither a system call nor a format conversion.
+**	Entries are hashed by sector address; a sector not in the cache
+**	replaces the least recently used entry.
+**	Writes update the cache too.  Normally they also go straight to
+**	the disk ("write-through"); if dk_cwback is set they only mark the
+**	entries dirty ("write-back"), and a dirty sector is written when
+**	its entry is replaced, along with any dirty neighbors, or when the
+**	cache is flushed by vdk_flush or vdk_unmount.
+*/
+
+#define VDK_CNONE ((uint32)-1)		/* ce_sec of an unused entry */
+#define vdk_chash(d,sec) (&(d)->dk_chash[(sec) & (d)->dk_chmask])
+
+/* Move entry to the front (most recently used end) of the list */
+#define vdk_cunlink(ce) \
+	((ce)->ce_prev->ce_next = (ce)->ce_next, \
+	 (ce)->ce_next->ce_prev = (ce)->ce_prev)
+#define vdk_cfront(d,ce) \
+	((ce)->ce_next = (d)->dk_clru.ce_next, \
+	 (ce)->ce_prev = &(d)->dk_clru, \
+	 (d)->dk_clru.ce_next->ce_prev = (ce), \
+	 (d)->dk_clru.ce_next = (ce))
+
+static int
+vdk_cmount(register struct vdk_unit *d)
+{
+    register struct vdk_cent *ce;
+    register unsigned i;
+    uint32 hsiz;
+
+    if (d->dk_csize > VDK_CACHEMAX)
+	d->dk_csize = VDK_CACHEMAX;
+    for (hsiz = 1; hsiz < d->dk_csize; hsiz <<= 1)
+	;
+    if (!(d->dk_cents = (struct vdk_cent *)
+			calloc((size_t)d->dk_csize, sizeof(struct vdk_cent)))
+      || !(d->dk_chash = (struct vdk_cent **)
+			calloc((size_t)hsiz, sizeof(struct vdk_cent *)))
+      || !(d->dk_cwds = (w10_t *)
+			malloc((size_t)(d->dk_csize + VDK_CRUNMAX)
+				* VDK_NWDS(d) * sizeof(w10_t)))) {
+	d->dk_err = errno;
+	vdk_cunmount(d);
+	return FALSE;
+    }
+    d->dk_chmask = hsiz - 1;
+    d->dk_clru.ce_next = d->dk_clru.ce_prev = &d->dk_clru;
+    for (i = 0, ce = d->dk_cents; i < d->dk_csize; ++i, ++ce) {
+	ce->ce_sec = VDK_CNONE;
+	ce->ce_wds = d->dk_cwds + (i * VDK_NWDS(d));
+	vdk_cfront(d, ce);
+    }
+    d->dk_chits = d->dk_cmiss = d->dk_cwrbk = 0;
+    return TRUE;
+}
+
+static void
+vdk_cunmount(register struct vdk_unit *d)
+{
+    if (d->dk_cwds) {
+	free((char *)d->dk_cwds);
+	d->dk_cwds = NULL;
+    }
+    if (d->dk_chash) {
+	free((char *)d->dk_chash);
+	d->dk_chash = NULL;
+    }
+    if (d->dk_cents) {
+	free((char *)d->dk_cents);
+	d->dk_cents = NULL;
+    }
+}
+
+static struct vdk_cent *
+vdk_cfind(register struct vdk_unit *d, register uint32 sec)
+{
+    register struct vdk_cent *ce;
+
+    for (ce = *vdk_chash(d, sec); ce; ce = ce->ce_hnext)
+	if (ce->ce_sec == sec)
+	    return ce;
+    return NULL;
+}
+
+/* VDK_CCLEAN - Write back a dirty entry, together with as many of the
+**	dirty sectors on either side of it as will fit in one write.
+**	Returns FALSE if the entry could not be written.
+*/
+static int
+vdk_cclean(register struct vdk_unit *d, struct vdk_cent *ce)
+{
+    register struct vdk_cent *rce;
+    register w10_t *wp;
+    register int n;
+    uint32 sec;
+    int i, res;
+
+    sec = ce->ce_sec;
+    for (n = 1; n < VDK_CRUNMAX && sec > 0; ++n, --sec) {
+	if (!(rce = vdk_cfind(d, sec-1)) || !rce->ce_dirty)
+	    break;
+    }
+    wp = d->dk_cwds + (d->dk_csize * VDK_NWDS(d));	/* Run buffer */
+    for (n = 0; n < VDK_CRUNMAX; ++n) {
+	if (!(rce = vdk_cfind(d, sec+n)) || !rce->ce_dirty)
+	    break;
+	memcpy((char *)(wp + (n * VDK_NWDS(d))), (char *)rce->ce_wds,
+			VDK_NWDS(d) * sizeof(w10_t));
+    }
+    res = vdk_dwrite(d, wp, sec, n);
+    for (i = 0; i < res; ++i)
+	vdk_cfind(d, sec+i)->ce_dirty = FALSE;
+    d->dk_cwrbk += res;
+    return !ce->ce_dirty;
+}
+
+/* VDK_CGET - Get an entry for a sector not in the cache, at the front
+**	of the list.  Returns NULL if the entry to be replaced was dirty
+**	and could not be written back.
+*/
+static struct vdk_cent *
+vdk_cget(register struct vdk_unit *d, uint32 sec)
+{
+    register struct vdk_cent *ce, **cep;
+
+    ce = d->dk_clru.ce_prev;		/* Least recently used */
+    if (ce->ce_dirty && !vdk_cclean(d, ce))
+	return NULL;
+    if (ce->ce_sec != VDK_CNONE) {	/* Take off its old hash chain */
+	for (cep = vdk_chash(d, ce->ce_sec); *cep != ce;
+						cep = &(*cep)->ce_hnext)
+	    ;
+	*cep = ce->ce_hnext;
+    }
+    ce->ce_sec = sec;
+    cep = vdk_chash(d, sec);
+    ce->ce_hnext = *cep;
+    *cep = ce;
+    vdk_cunlink(ce);
+    vdk_cfront(d, ce);
+    return ce;
+}
+
+/* VDK_CREAD - Read through cache.  Each run of sectors not in the
+**	cache is read from disk in one call, directly into the caller's
+**	buffer, then copied into the cache.
+*/
+static int
+vdk_cread(register struct vdk_unit *d,
+	  w10_t *wp, uint32 secaddr, int nsec)
+{
+    register struct vdk_cent *ce;
+    register int i, n;
+    int j, res;
+    size_t secsiz = VDK_NWDS(d) * sizeof(w10_t);
+
+    d->dk_err = 0;
+    for (i = 0; i < nsec; i += n) {
+	if ((ce = vdk_cfind(d, secaddr+i))) {
+	    memcpy((char *)(wp + (i * VDK_NWDS(d))), (char *)ce->ce_wds,
+								secsiz);
+	    vdk_cunlink(ce);
+	    vdk_cfront(d, ce);
+	    d->dk_chits++;
+	    n = 1;
+	    continue;
+	}
+	for (n = 1; i+n < nsec && !vdk_cfind(d, secaddr+i+n); ++n)
+	    ;
+	res = vdk_dread(d, wp + (i * VDK_NWDS(d)), secaddr+i, n);
+	d->dk_cmiss += res;
+	if (res < n)
+	    return i + res;		/* Don't cache anything suspect */
+	for (j = 0; j < n; ++j) {
+	    if (!(ce = vdk_cget(d, secaddr+i+j)))
+		return i + j;
+	    memcpy((char *)ce->ce_wds, (char *)(wp + ((i+j) * VDK_NWDS(d))),
+								secsiz);
+	}
+    }
+    return nsec;
+}
+
+/* VDK_CWRITE - Write through or into cache.
+*/
+static int
+vdk_cwrite(register struct vdk_unit *d,
+	   w10_t *wp, uint32 secaddr, int nsec)
+{
+    register struct vdk_cent *ce;
+    register int i;
+    size_t secsiz = VDK_NWDS(d) * sizeof(w10_t);
+
+    if (d->dk_cwback)
+	d->dk_err = 0;
+    else
+	nsec = vdk_dwrite(d, wp, secaddr, nsec);	/* Disk first */
+
+    for (i = 0; i < nsec; ++i, wp += VDK_NWDS(d)) {
+	if ((ce = vdk_cfind(d, secaddr+i))) {
+	    vdk_cunlink(ce);
+	    vdk_cfront(d, ce);
+	} else if (!(ce = vdk_cget(d, secaddr+i)))
+	    return i;
+	memcpy((char *)ce->ce_wds, (char *)wp, secsiz);
+	ce->ce_dirty = d->dk_cwback;
+    }
+    return nsec;
+}
+
+#endif /* VDK_CACHE */
+
+/* Read from disk, through the cache if there is one.
+**	Return # sectors read.
+*/
+int
+vdk_read(register struct vdk_unit *d,
+	 w10_t *wp,		/* Word buffer to read data */
+	 uint32 secaddr,	/* Sector addr on disk */
+	 int nsec)		/* # sectors - Never more than 16 bits */
+{
+#if VDK_CACHE
+    if (d->dk_cents)			/* Caching sectors? */
+	return vdk_cread(d, wp, secaddr, nsec);
+#endif
+    return vdk_dread(d, wp, secaddr, nsec);
+}
+
+/* Write to disk, through the cache if there is one.
+**	Return # sectors written.
+*/
+int
+vdk_write(register struct vdk_unit *d,
+	  w10_t *wp,		/* Word buffer to read data */
+	  uint32 secaddr,	/* Sector addr on disk */
+	  int nsec)		/* # sectors - Never more than 16 bits */
+{
+#if VDK_CACHE
+    if (d->dk_cents)			/* Caching sectors? */
+	return vdk_cwrite(d, wp, secaddr, nsec);
+#endif
+    return vdk_dwrite(d, wp, secaddr, nsec);
+}
+
+/* Flush any written data still held in memory out to the disk.
+**	Returns FALSE if some of it could not be written.
+*/
+int
+vdk_flush(register struct vdk_unit *d)
+{
+    int res = TRUE;
+#if VDK_CACHE
+    register unsigned i;
+
+    if (d->dk_cents) {
+	for (i = 0; i < d->dk_csize; ++i) {
+	    if (d->dk_cents[i].ce_dirty && !vdk_cclean(d, &d->dk_cents[i]))
+		res = FALSE;
+	}
+    }
+#endif
+    return res;
+}
+
 /* Format conversion routines */
 
 /*
@@ -499,16 +1349,8 @@ cvtfr_dbd9(register w10_t *wp,
     register w10_t w;
     register int dwcnt = wcnt >> 1;
 
-    for (; --dwcnt >= 0; ucp += 9) {
-	LRHSET(w,
-	    (((ucp[0]&0377)<<10) | ((ucp[1]&0377)<<2) | ((ucp[2]>>6)&03)),
-	    (((ucp[2]&077)<<12)  | ((ucp[3]&0377)<<4) | ((ucp[4]>>4)&017)));
-	*wp++ = w;
-	LRHSET(w,
-	    (((ucp[4]&017)<<14) | ((ucp[5]&0377)<<6) | ((ucp[6]>>2)&077)),
-	    (((ucp[6]&03)<<16)  | ((ucp[7]&0377)<<8) | (ucp[8]&0377)));
-	*wp++ = w;
-    }
+    for (; --dwcnt >= 0; ucp += 9, wp += 2)
+	WF_H36FR2(ucp, wp[0], wp[1]);
 
     /* Ugh, allow gobbling an odd word for generality */
     if (wcnt & 01) {
@@ -524,22 +1366,11 @@ cvtto_dbd9(register unsigned char *ucp,
 	   register w10_t *wp,
 	   register int wcnt)
 {
-    register w10_t w, w2;
+    register w10_t w;
     register int dwcnt = wcnt >> 1;
 
-    for (; --dwcnt >= 0; ) {
-	w = *wp++;
-	w2 = *wp++;
-	*ucp++ = (LHGET(w) >> 10) & 0377;
-	*ucp++ = (LHGET(w) >>  2) & 0377;
-	*ucp++ = ((LHGET(w)&03)<<6) | ((RHGET(w) >> 12) & 077);
-	*ucp++ = (RHGET(w) >>  4) & 0377;
-	*ucp++ = ((RHGET(w)&017)<<4) | ((LHGET(w2) >> 14) & 017);
-	*ucp++ = (LHGET(w2) >>  6) & 0377;
-	*ucp++ = ((LHGET(w2)&077)<<2) | ((RHGET(w2) >> 16) & 03);
-	*ucp++ = (RHGET(w2) >>  8) & 0377;
-	*ucp++ =  RHGET(w2)        & 0377;
-    }
+    for (; --dwcnt >= 0; ucp += 9, wp += 2)
+	WF_H36TO2(ucp, wp[0], wp[1]);
 
     /* Ugh, allow writing an odd word for generality */
     if (wcnt & 01) {
@@ -573,6 +1404,16 @@ cvtfr_dld9(register w10_t *wp,
     register w10_t w;
     register int dwcnt = wcnt >> 1;
 
+#if WF_CVT64
+    /* Bytes 0-7 hold all of word 0 and the low 28 bits of word 1 */
+    for (; --dwcnt >= 0; ucp += 9) {
+	register uint64 v = WF_LE64GET(ucp);
+	W10_U36SET(*wp, v);
+	++wp;
+	W10_U36SET(*wp, (v >> 36) | ((uint64)ucp[8] << 28));
+	++wp;
+    }
+#else
     for (; --dwcnt >= 0; ucp += 9) {
 	LRHSET(w,
 	    (((ucp[4]&017)<<14) | ((ucp[3]&0377)<<6) | ((ucp[2]>>2)&077)),
@@ -583,6 +1424,7 @@ cvtfr_dld9(register w10_t *wp,
 	    (((ucp[6]&077)<<12)  | ((ucp[5]&0377)<<4) | ((ucp[4]>>4)&017)));
 	*wp++ = w;
     }
+#endif
 
     /* Ugh, allow gobbling an odd word for generality */
     if (wcnt & 01) {
@@ -601,6 +1443,16 @@ cvtto_dld9(register unsigned char *ucp,
     register w10_t w, w2;
     register int dwcnt = wcnt >> 1;
 
+#if WF_CVT64
+    for (; --dwcnt >= 0; ucp += 9) {
+	register uint64 v;
+	w = *wp++;
+	w2 = *wp++;
+	v = (uint64)W10_U36(w) | ((uint64)W10_U36(w2) << 36);
+	WF_LE64SET(ucp, v);
+	ucp[8] = (W10_U36(w2) >> 28) & 0377;
+    }
+#else
     for (; --dwcnt >= 0; ) {
 	w = *wp++;
 	w2 = *wp++;
@@ -614,6 +1466,7 @@ cvtto_dld9(register unsigned char *ucp,
 	*ucp++ = (LHGET(w2) >>  2) & 0377;
 	*ucp++ = (LHGET(w2) >> 10) & 0377;
     }
+#endif
 
     /* Ugh, allow writing an odd word for generality */
     if (wcnt & 01) {
@@ -645,12 +1498,19 @@ cvtfr_dbw8(register w10_t *wp,
 {
     register w10_t w;
 
+#if WF_CVT64
+    for (; --wcnt >= 0; ucp += 8) {
+	W10_U36SET(w, WF_BE64GET(ucp));	/* Drops the top 28 bits */
+	*wp++ = w;
+    }
+#else
     for (; --wcnt >= 0; ucp += 8) {
 	LRHSET(w,
 	    (((ucp[3]&017)<<14) | ((ucp[4]&0377)<<6) | ((ucp[5]>>2)&077)),
 	    (((ucp[5]&03)<<16)  | ((ucp[6]&0377)<<8) | (ucp[7]&0377)));
 	*wp++ = w;
     }
+#endif
 }
 
 static void
@@ -660,6 +1520,12 @@ cvtto_dbw8(register unsigned char *ucp,
 {
     register w10_t w;
 
+#if WF_CVT64
+    for (; --wcnt >= 0; ucp += 8) {
+	w = *wp++;
+	WF_BE64SET(ucp, (uint64)W10_U36(w));
+    }
+#else
     for (; --wcnt >= 0; ) {
 	w = *wp++;
 	*ucp++ = 0;
@@ -671,6 +1537,7 @@ cvtto_dbw8(register unsigned char *ucp,
 	*ucp++ = (RHGET(w) >>  8) & 0377;
 	*ucp++ =  RHGET(w)        & 0377;
     }
+#endif
 }
 
 /*
@@ -691,12 +1558,19 @@ cvtfr_dlw8(register w10_t *wp,
 {
     register w10_t w;
 
+#if WF_CVT64
+    for (; --wcnt >= 0; ucp += 8) {
+	W10_U36SET(w, WF_LE64GET(ucp));	/* Drops the top 28 bits */
+	*wp++ = w;
+    }
+#else
     for (; --wcnt >= 0; ucp += 8) {
 	LRHSET(w,
 	    (((ucp[4]&017)<<14) | ((ucp[3]&0377)<<6) | ((ucp[2]>>2)&077)),
 	    (((ucp[2]&03)<<16)  | ((ucp[1]&0377)<<8) | (ucp[0]&0377)));
 	*wp++ = w;
     }
+#endif
 }
 
 static void
@@ -706,6 +1580,12 @@ cvtto_dlw8(register unsigned char *ucp,
 {
     register w10_t w;
 
+#if WF_CVT64
+    for (; --wcnt >= 0; ucp += 8) {
+	w = *wp++;
+	WF_LE64SET(ucp, (uint64)W10_U36(w));
+    }
+#else
     for (; --wcnt >= 0; ) {
 	w = *wp++;
 	*ucp++ =  RHGET(w)        & 0377;
@@ -717,6 +1597,7 @@ cvtto_dlw8(register unsigned char *ucp,
 	*ucp++ = 0;
 	*ucp++ = 0;
     }
+#endif
 }
 
 /*
@@ -737,11 +1618,20 @@ cvtfr_dbh4(register w10_t *wp,
 {
     register w10_t w;
 
+#if WF_CVT64
+    /* Both orders hold LH in the high 32 bits and RH in the low 32 */
+    for (; --wcnt >= 0; ucp += 8) {
+	register uint64 v = WF_BE64GET(ucp);
+	LRHSET(w, (h10_t)((v >> 32) & H10MASK), (h10_t)(v & H10MASK));
+	*wp++ = w;
+    }
+#else
     for (; --wcnt >= 0; ucp += 8) {
 	LRHSET(w, (((ucp[1]&03)<<16) | ((ucp[2]&0377)<<8) | (ucp[3]&0377)),
 		  (((ucp[5]&03)<<16) | ((ucp[6]&0377)<<8) | (ucp[7]&0377)));
 	*wp++ = w;
     }
+#endif
 }
 
 static void
@@ -751,6 +1641,14 @@ cvtto_dbh4(register unsigned char *ucp,
 {
     register w10_t w;
 
+#if WF_CVT64
+    for (; --wcnt >= 0; ucp += 8) {
+	register uint64 v;
+	w = *wp++;
+	v = ((uint64)LHGET(w) << 32) | (uint64)RHGET(w);
+	WF_BE64SET(ucp, v);
+    }
+#else
     for (; --wcnt >= 0; ) {
 	w = *wp++;
 	*ucp++ = 0;
@@ -762,6 +1660,7 @@ cvtto_dbh4(register unsigned char *ucp,
 	*ucp++ = (RHGET(w) >>  8) & 0377;
 	*ucp++ =  RHGET(w)        & 0377;
     }
+#endif
 }
 
 /*
@@ -783,11 +1682,20 @@ cvtfr_dlh4(register w10_t *wp,
 {
     register w10_t w;
 
+#if WF_CVT64
+    /* Both orders hold LH in the high 32 bits and RH in the low 32 */
+    for (; --wcnt >= 0; ucp += 8) {
+	register uint64 v = WF_LE64GET(ucp);
+	LRHSET(w, (h10_t)((v >> 32) & H10MASK), (h10_t)(v & H10MASK));
+	*wp++ = w;
+    }
+#else
     for (; --wcnt >= 0; ucp += 8) {
 	LRHSET(w, (((ucp[6]&03)<<16) | ((ucp[5]&0377)<<8) | (ucp[4]&0377)),
 		  (((ucp[2]&03)<<16) | ((ucp[1]&0377)<<8) | (ucp[0]&0377)));
 	*wp++ = w;
     }
+#endif
 }
 
 static void
@@ -797,6 +1705,14 @@ cvtto_dlh4(register unsigned char *ucp,
 {
     register w10_t w;
 
+#if WF_CVT64
+    for (; --wcnt >= 0; ucp += 8) {
+	register uint64 v;
+	w = *wp++;
+	v = ((uint64)LHGET(w) << 32) | (uint64)RHGET(w);
+	WF_LE64SET(ucp, v);
+    }
+#else
     for (; --wcnt >= 0; ) {
 	w = *wp++;
 	*ucp++ =  RHGET(w)        & 0377;
@@ -808,6 +1724,7 @@ cvtto_dlh4(register unsigned char *ucp,
 	*ucp++ = (LHGET(w) >> 16) & 03;
 	*ucp++ = 0;
     }
+#endif
 }
 
 
@@ -51,6 +51,38 @@
 # endif
 #endif
 
+#ifndef VDK_MMAP		/* Set TRUE to allow mapping RAW packs */
+# define VDK_MMAP (CENV_SYS_UNIX && !VDK_DISKMAP)
+#endif
+
+#ifndef VDK_SPARSE		/* Set TRUE to include sparse/overlay packs */
+# define VDK_SPARSE (!VDK_DISKMAP)
+#endif
+
+#ifndef VDK_SBLKSECS		/* # sectors per block of a new sparse pack */
+# define VDK_SBLKSECS 4			/* One T20/T10 page */
+#endif
+
+#ifndef VDK_SMAXDEPTH		/* Max # of overlays stacked on a base */
+# define VDK_SMAXDEPTH 8
+#endif
+
+#ifndef VDK_CACHE		/* Set TRUE to include sector cache code */
+# define VDK_CACHE (!VDK_DISKMAP)
+#endif
+
+#ifndef VDK_CACHEMAX		/* Max # sectors a unit may cache */
+# define VDK_CACHEMAX 65536		/* 64MB of words on a 64-bit host */
+#endif
+
+#ifndef VDK_CRUNMAX		/* Max # dirty sectors written back at once */
+# define VDK_CRUNMAX 64
+#endif
+
+#ifndef VDK_CVTMAX		/* Max size of conversion buffer in bytes */
+# define VDK_CVTMAX (1024*1024)
+#endif
+
 #ifndef VDK_SECTOR_SIZE		/* Allow specifying sector size in wds */
 # define VDK_SECTOR_SIZE 128		/* Default for all known DEC disks */
 # define VDK_NWDS(d) VDK_SECTOR_SIZE	/* Size as function of disk unit */
@@ -78,7 +110,9 @@
  vdk_fmt(VDK_FMT_DBH4, "DBH4", "Disk_BigEnd_Halfword (8)",		\
 					2*2*4, cvtfr_dbh4, cvtto_dbh4),	\
  vdk_fmt(VDK_FMT_DLH4, "DLH4", "Disk_LittleEnd_Halfword (8)",		\
-					2*2*4, cvtfr_dlh4, cvtto_dlh4)
+					2*2*4, cvtfr_dlh4, cvtto_dlh4),	\
+ vdk_fmt(VDK_FMT_VDKS, "VDKS", "Sparse block index, DBD9 data, overlay",\
+					9, cvtfr_dbd9, cvtto_dbd9)
 
 
 enum {
@@ -88,6 +122,52 @@ enum {
 # undef vdk_fmt
 };
 
+/* When to msync a memory-mapped pack (dk_msync) */
+enum {
+	VDK_MSYNC_NONE=0,	/* Only at unmount, else leave it to the OS */
+	VDK_MSYNC_ASYNC,	/* Start writeback after every write */
+	VDK_MSYNC_SYNC		/* Finish writeback before write returns */
+};
+
+
+#if VDK_SPARSE
+/* Sparse pack (VDKS) layout.  All numbers are big-endian.
+**	Header:	VDK_SHDRSIZ bytes at start of file
+**	Index:	8 bytes per block, giving file offset of block data
+**	Data:	Blocks of dk_sblksec sectors in DBD9 format, in the order
+**		they were first written.
+** A block not in the index is read from the base pack (if any) or is
+** zero.  A block written as all zeros takes no data space.
+*/
+# define VDK_SHDRSIZ	512	/* Size of header */
+# define VDK_SMAGIC	"KLH10-VDKS\n"	/* Magic ID at start of header */
+# define VDK_SVERSION	1
+# define VDK_SH_VER	16	/* Offsets in header: 4-byte version */
+# define VDK_SH_SECBLK	20	/*   4-byte # sectors per block */
+# define VDK_SH_NSECS	24	/*   4-byte # sectors in pack */
+# define VDK_SH_NWDS	28	/*   4-byte # words per sector */
+# define VDK_SH_NBLKS	32	/*   4-byte # entries in index */
+# define VDK_SH_BFMT	64	/*   Name of base pack format */
+# define VDK_SH_BPATH	128	/*   Pathname of base pack, or "" */
+# define VDK_SBPATHMAX	(VDK_SHDRSIZ - VDK_SH_BPATH)
+
+# define VDK_SIDX_NONE	0	/* Index entry: block not in this pack */
+# define VDK_SIDX_ZERO	1	/* Index entry: block is all zeros */
+#endif /* VDK_SPARSE */
+
+#if VDK_CACHE
+/* Sector cache entry.  All entries are on a list in order of use (most
+** recent first), and those holding a sector are also on a hash chain.
+*/
+struct vdk_cent {
+	struct vdk_cent *ce_next,	/* Next (less recently used) entry */
+		*ce_prev;		/* Previous (more recently used) */
+	struct vdk_cent *ce_hnext;	/* Next entry on same hash chain */
+	uint32 ce_sec;		/* Sector address, VDK_CNONE if unused */
+	int ce_dirty;		/* TRUE if not yet written to disk */
+	w10_t *ce_wds;		/* Sector contents */
+};
+#endif /* VDK_CACHE */
 
 #if VDK_DISKMAP
 struct vdk_header {
@@ -131,6 +211,36 @@ struct vdk_unit {
 	char *dk_errarg;	/* Arg to handler */
 	int dk_err;		/* # of last I/O error (0 if none) */
 
+	int dk_mmap;		/* TRUE to map RAW pack into memory if can */
+	int dk_msync;		/* When to msync mapped pack, VDK_MSYNC_xxx */
+	unsigned char *dk_mmbase;	/* M Mapped pack, if mapped */
+	size_t dk_mmsize;	/* Size of mapping in bytes */
+
+#if VDK_SPARSE
+	char *dk_sbpath;	/* Base pack path for new VDKS pack, or NULL */
+	int dk_sbfmt;		/* Base pack format for new VDKS pack */
+	int dk_sdepth;		/* # overlays above this pack */
+	unsigned dk_sblksec;	/* # sectors per block */
+	uint32 dk_snblks;	/* # blocks (# entries in index) */
+	osdaddr_t *dk_sidx;	/* M Block index, if a VDKS pack */
+	osdaddr_t dk_sfree;	/* Offset to put next new block at */
+	w10_t *dk_swds;		/* M Scratch block for partial writes */
+	struct vdk_unit *dk_sbase;	/* M Base pack, if an overlay */
+#endif
+
+#if VDK_CACHE
+	unsigned dk_csize;	/* # sectors to cache, 0 for none */
+	int dk_cwback;		/* TRUE to write back, else write through */
+	struct vdk_cent *dk_cents;	/* M Cache entries, if caching */
+	struct vdk_cent **dk_chash;	/* M Hash table of entries */
+	uint32 dk_chmask;	/* Hash table size - 1 */
+	struct vdk_cent dk_clru;	/* Head of use-ordered entry list */
+	w10_t *dk_cwds;		/* M Sector data, then write-back buffer */
+	unsigned long dk_chits;	/* # sectors read from cache */
+	unsigned long dk_cmiss;	/* # sectors read from disk */
+	unsigned long dk_cwrbk;	/* # dirty sectors written back */
+#endif
+
 #if VDK_DISKMAP
 	int dk_ismap;		/* TRUE if disk being mapped */
 	struct vdk_header dk_dfh;	/* Copy of diskfile header */
@@ -159,11 +269,16 @@ extern int vdk_mount(struct vdk_unit *, char *, int);
 extern int vdk_unmount(struct vdk_unit *);
 extern int vdk_read(struct vdk_unit *, w10_t *, uint32, int);
 extern int vdk_write(struct vdk_unit *, w10_t *, uint32, int);
+extern int vdk_flush(struct vdk_unit *);
 
 /* Compute block number given disk, cylinder, track, sector? */
 #define vdk_blknum(d,c,t,s)	/* unfinished */
 
 
+#if VDK_SPARSE
+extern int vdk_sisset(struct vdk_unit *, uint32);
+#endif
+
 #define vdk_ismounted(d) ((d)->dk_filename != NULL)
 #define vdk_iswritable(d) ((d)->dk_iswrite)
 
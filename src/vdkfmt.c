@@ -52,6 +52,7 @@
 #if CENV_SYS_UNIX
 # include <unistd.h>		/* Basic Unix syscalls */
 # include <sys/types.h>
+# include <sys/stat.h>
 # include <sys/ioctl.h>
 # define NULLDEV "/dev/null"
 # define FD_STDIN 0
@@ -120,9 +121,16 @@ Usage: vdkfmt <params>\n\
   op=<path>	Output disk device\n\
   ifmt=<fmt>	format of input pack data\n\
   ofmt=<fmt>	format of output pack data\n\
+  ob=<path>	Base pack for output overlay (VDKS only)\n\
+  obfmt=<fmt>	format of base pack data\n\
   dt=<type>	Type of drive (RP06, etc)\n\
   log=<path> 	Log filespec (optional, defaults to stderr)\n\
   verbose	Verbose (optional)\n\
+With ofmt=VDKS the output is a sparse pack.  If ob= is given as well it\n\
+is an overlay on that base pack.  If the input is an overlay on the same\n\
+base, only what the input itself holds is copied; otherwise whatever\n\
+differs from the base is.  With no ip= a new empty overlay is created.\n\
+Copying a VDKS pack to a new VDKS pack compacts it.\n\
 ";
 
 
@@ -143,12 +151,15 @@ struct devdk {
 	char *d_path;	/* Disk drive path spec */
 	int d_isdisk;		/* NZ if hardware device, else virtual */
 	int d_fmt;		/* Format to use */
+	char *d_bpath;		/* Base pack path (VDKS overlay only) */
+	int d_bfmt;		/* Base pack format */
 	long d_totsec;		/* Total # sectors */
 	struct vdk_unit d_vdk;	/* Virtual disk info */
 	struct diskconf d_dcf;
 };
 struct devdk dvi = { "In" };
 struct devdk dvo = { "Out" };
+struct devdk dvb = { "Base" };	/* Output's base, if input's differs */
 
 /* Values for d_isdisk */
 #define MTYP_NULL	0	/* Null device */
@@ -164,11 +175,13 @@ char *mtypstr[] = {
 int cmdsget(int ac, char **av);
 int docopy(void);
 int zerosector(w10_t *wp, int nwds);
+int samesector(w10_t *wp1, w10_t *wp2, int nwds);
+int samefile(char *path1, char *path2);
 
 int devopen(struct devdk *d, int wrtf);
 int devclose(struct devdk *d);
-int devread(struct devdk *d, long int daddr, w10_t *buff);
-int devwrite(struct devdk *d, long int daddr, w10_t *buff);
+int devread(struct devdk *d, long int daddr, w10_t *buff, int nsec);
+int devwrite(struct devdk *d, long int daddr, w10_t *buff, int nsec);
 
 void swerror(char *fmt, ...);
 void efatal(char *errmsg);
@@ -270,6 +283,7 @@ main(int argc, char **argv)
     signal(SIGINT, exit);	/* Allow int to terminate log files etc */
 
     dvi.d_fmt = dvo.d_fmt = -1;
+    dvi.d_bfmt = dvo.d_bfmt = -1;
 
     if ((ret = cmdsget(argc, argv)))	/* Parse and handle command line */
 	exit(ret);
@@ -291,12 +305,17 @@ main(int argc, char **argv)
 		dvi.d_dcf.dcf_ntrk *
 		dvi.d_dcf.dcf_ncyl;
     if (sw_verbose) {
-	fprintf(logfile, ";  Input disk spec \"%s\" (Type: %s) Format: %s\n",
+	if (dvi.d_path)
+	    fprintf(logfile,
+			";  Input disk spec \"%s\" (Type: %s) Format: %s\n",
 				dvi.d_path, mtypstr[dvi.d_isdisk],
 				fmttab[dvi.d_fmt]);
 	fprintf(logfile, "; Output disk spec \"%s\" (Type: %s) Format: %s\n",
 				dvo.d_path, mtypstr[dvo.d_isdisk],
 				fmttab[dvo.d_fmt]);
+	if (dvo.d_bpath)
+	    fprintf(logfile, ";   Overlay on \"%s\" Format: %s\n",
+				dvo.d_bpath, fmttab[dvo.d_bfmt]);
 
 	/* Show config info here */
 	fprintf(logfile, "; Drive type: %s\n", dvi.d_dcf.dcf_name);
@@ -311,17 +330,53 @@ main(int argc, char **argv)
     }
 
     /* Open I/O files as appropriate */
+    if (!dvi.d_path) {		/* Just creating an empty overlay */
+	if (access(dvo.d_path, F_OK) == 0) {
+	    fprintf(logfile, "; \"%s\" already exists, not changed\n",
+			dvo.d_path);
+	    exit(1);
+	}
+	if (!devopen(&dvo, TRUE))
+	    exit(1);
+	fprintf(logfile, "; Created overlay \"%s\" on \"%s\"\n",
+		dvo.d_path, dvo.d_bpath);
+	ret = devclose(&dvo);
+	fclose(logfile);
+	exit(ret ? 0 : 1);
+    }
     if (!devopen(&dvi, FALSE))	/* Open for reading */
 	exit(1);
     if (!devopen(&dvo, TRUE))	/* Open for writing */
 	exit(1);
 
+    /* An overlay on the input's own base only needs what the input
+    ** holds itself.  For any other base, the input's data must be
+    ** compared against that base to see what the overlay needs.
+    */
+#if VDK_SPARSE
+    if (dvo.d_bpath
+      && !(dvi.d_vdk.dk_sbase
+	   && samefile(dvi.d_vdk.dk_sbase->dk_filename, dvo.d_bpath))) {
+	dvb.d_path = dvo.d_bpath;
+	dvb.d_fmt = dvo.d_bfmt;
+	dvb.d_dcf = dvo.d_dcf;
+	dvb.d_totsec = dvo.d_totsec;
+	if (!devopen(&dvb, FALSE))
+	    exit(1);
+	if (sw_verbose)
+	    fprintf(logfile, "; Comparing with base pack \"%s\"\n",
+			dvb.d_path);
+    }
+#endif
+
     /* Do it! */
     fprintf(logfile, "; Copying from \"%s\" to \"%s\"...\n", dvi.d_path,
 		dvo.d_path ? dvo.d_path : NULLDEV);
     if ((ret = docopy()))
 	ret = devclose(&dvo);
     else (void) devclose(&dvo);
+    if (dvb.d_path)
+	(void) devclose(&dvb);
 
     if (!ret) fprintf(logfile, "; Stopped unexpectedly.\n");
 
@@ -348,14 +403,24 @@ int docopy(void)
     int err;
     long nsect = 0;
     w10_t wbuff[512];
+    w10_t bbuff[512];
     int nwrt = 0;
+    int n, nstep = 1;
+
+    /* An overlay is copied a block at a time, so a block of zeros that
+    ** hides data in the base pack doesn't get filled in from it.
+    */
+#if VDK_SPARSE
+    if (dvo.d_bpath && (dvo.d_vdk.dk_sblksec * 128 <= 512))
+	nstep = dvo.d_vdk.dk_sblksec;
+#endif
 
     if (DBGFLG)
 	fprintf(logfile, "; Pages:\n");
 
-    for (; nsect <= dvi.d_totsec;) {
-	
-	err = devread(&dvi, nsect, wbuff);	/* Get a sector  */
+    for (; nsect < dvi.d_totsec;) {
+	n = (nsect + nstep <= dvi.d_totsec) ? nstep : dvi.d_totsec - nsect;
+	err = devread(&dvi, nsect, wbuff, n);	/* Get a sector  */
 	if (!err) {
 	    fprintf(logfile, "; Aborting loop, last err: %s\n", os_strerror(-1));
 	    return 0;
@@ -364,11 +429,25 @@ int docopy(void)
 	/* See whether there's any data in sector or not.
 	** If none, don't write it out!
 	** Later, always write if device is "hard".
+	** For an overlay, write whatever the input pack itself has,
+	** as even a zero sector may be hiding data in the base pack.
+	** On a different base, write whatever the base doesn't match.
 	*/
-	if (!zerosector(wbuff, 128)) {
+#if VDK_SPARSE
+	if (dvb.d_path && !devread(&dvb, nsect, bbuff, n)) {
+	    fprintf(logfile, "; Aborting loop, last err: %s\n", os_strerror(-1));
+	    return 0;
+	}
+	if (dvb.d_path ? !samesector(wbuff, bbuff, 128 * n)
+	    : dvo.d_bpath ? vdk_sisset(&dvi.d_vdk, (uint32)nsect)
+	    : !zerosector(wbuff, 128 * n))
+#else
+	if (!zerosector(wbuff, 128 * n))
+#endif
+	{
 	    /* Copy results to output device */
 	    nwrt++;
-	    err = devwrite(&dvo, nsect, wbuff);	/* Write a sector  */
+	    err = devwrite(&dvo, nsect, wbuff, n);	/* Write a sector  */
 	    if (!err) {
 		fprintf(logfile, "; Aborting loop, last err: %s\n",
 					 os_strerror(-1));
@@ -376,7 +455,7 @@ int docopy(void)
 	    }
 	}
 
-	++nsect;
+	nsect += n;
 
 	/* Hack to show nice pattern, one char per 4-sector page */
 	if (DBGFLG) {
@@ -392,6 +471,24 @@ int docopy(void)
     return TRUE;
 }
 
+int samesector(register w10_t *wp1, register w10_t *wp2, register int nwds)
+{
+    for (; --nwds >= 0; ++wp1, ++wp2)
+	if (LHGET(*wp1) != LHGET(*wp2) || RHGET(*wp1) != RHGET(*wp2))
+	    return FALSE;
+    return TRUE;
+}
+
+/* TRUE if both paths name the same file.
+*/
+int samefile(char *path1, char *path2)
+{
+    struct stat st1, st2;
+
+    return (stat(path1, &st1) == 0) && (stat(path2, &st2) == 0)
+	&& (st1.st_dev == st2.st_dev) && (st1.st_ino == st2.st_ino);
+}
+
 int zerosector(register w10_t *wp, register int nwds)
 {
     for (; --nwds >= 0; ++wp)
@@ -466,6 +563,29 @@ cmdsget(int ac, char **av)
 		    }
 		    continue;
 
+		case 'b':
+		    if (d != &dvo)
+			break;
+		    if (strcmp(cp, "b") == 0) {
+			if (d->d_bpath) {
+			    swerror("Param already specified: \"%s\"", *av);
+			    continue;
+			}
+			d->d_bpath = arg;
+			continue;
+		    }
+		    if (strcmp(cp, "bfmt") != 0)
+			break;
+		    if (d->d_bfmt != -1) {
+			swerror("Param already specified: \"%s\"", *av);
+			continue;
+		    }
+		    if (!parfmt(arg, &(d->d_bfmt))) {
+			swerror("Unknown format: \"%s\"", arg);
+			continue;
+		    }
+		    continue;
+
 		/* Default just drops thru to fail */
 	    }
 	    swerror("Unknown parameter \"%s\"", *av);
@@ -496,10 +616,17 @@ cmdsget(int ac, char **av)
 	dvo.d_dcf = dvi.d_dcf;	/* Copy drive type params */
     else
 	swerror("Drive type must be specified");
-    if (dvi.d_fmt == -1)
+    if (dvi.d_fmt == -1 && dvi.d_path)
 	swerror("Input pack format must be specified");
     if (dvo.d_fmt == -1)
 	swerror("Output pack format must be specified");
+    if (dvo.d_bpath) {
+	if (dvo.d_fmt != VDK_FMT_VDKS)
+	    swerror("Only a VDKS pack can have a base pack");
+	if (dvo.d_bfmt == -1)
+	    swerror("Base pack format must be specified");
+    } else if (!dvi.d_path)
+	swerror("Input pack must be specified");
 
     /* Check for any parameter errors */
     if (swerrs) {
@@ -534,6 +661,10 @@ int devopen(register struct devdk *d, int wrtf)
     d->d_vdk.dk_ntrks = d->d_dcf.dcf_ntrk;
     d->d_vdk.dk_nsecs = d->d_dcf.dcf_nsec;
     d->d_vdk.dk_nwds  = d->d_dcf.dcf_nwds;
+#if VDK_SPARSE
+    d->d_vdk.dk_sbpath = d->d_bpath;	/* Only used if creating VDKS */
+    d->d_vdk.dk_sbfmt = d->d_bfmt;
+#endif
 
     if (!vdk_mount(&(d->d_vdk), path, wrtf)) {
 	fprintf(logfile, "; Cannot mount device \"%s\": %s\n",
@@ -568,7 +699,7 @@ int devclose(struct devdk *d)
 **	Returns 0 if read nothing or error
 */
 
-int devread(struct devdk *d, long int daddr, w10_t *buff)
+int devread(struct devdk *d, long int daddr, w10_t *buff, int n)
 {
     int nsec;
 
@@ -577,10 +708,10 @@ int devread(struct devdk *d, long int daddr, w10_t *buff)
 	fprintf(logfile, "; read daddr=%ld\n", daddr);
 #endif
 
-    nsec = vdk_read(&d->d_vdk, buff, (uint32)daddr, 1);
+    nsec = vdk_read(&d->d_vdk, buff, (uint32)daddr, n);
 
     if (d->d_vdk.dk_err
-      || (nsec != 1)) {
+      || (nsec != n)) {
 	fprintf(logfile, "; read error on %s: %s\n",
 		    d->d_vdk.dk_filename, os_strerror(d->d_vdk.dk_err));
 	return FALSE;
@@ -590,7 +721,7 @@ int devread(struct devdk *d, long int daddr, w10_t *buff)
 
 /* Write to device.
 */
-int devwrite(struct devdk *d, long int daddr, w10_t *buff)
+int devwrite(struct devdk *d, long int daddr, w10_t *buff, int n)
 {
     int nsec;
 
@@ -599,10 +730,10 @@ int devwrite(struct devdk *d, long int daddr, w10_t *buff)
 	fprintf(logfile, "; write daddr=%ld\n", daddr);
 #endif
 
-    nsec = vdk_write(&d->d_vdk, buff, (uint32)daddr, 1);
+    nsec = vdk_write(&d->d_vdk, buff, (uint32)daddr, n);
 
     if (d->d_vdk.dk_err
-      || (nsec != 1)) {
+      || (nsec != n)) {
 	fprintf(logfile, "; write error on %s: %s\n",
 		    d->d_vdk.dk_filename, os_strerror(d->d_vdk.dk_err));
 	return FALSE;
@@ -760,3 +891,70 @@ os_fdwrite(osfd_t fd, char *buf, size_t len, size_t *ares)
     if (ares) *ares = res;
     return TRUE;
 }
+
+/* Positional versions of the above, which do not use or change the
+**	file position, so a transfer is a single call and several threads
+**	may use the same fd.  Otherwise same as os_fdseek then os_fdread
+**	or os_fdwrite.
+*/
+int
+os_fdpread(osfd_t fd,
+	   char *buf,
+	   size_t len, osdaddr_t addr, size_t *ares)
+{
+#if CENV_SYS_UNIX
+    register ssize_t res = pread(fd, buf, len, addr);
+    if (res < 0) {
+	if (ares) *ares = 0;
+	return FALSE;
+    }
+    if (ares) *ares = res;
+    return TRUE;
+#else
+    if (!os_fdseek(fd, addr)) {
+	if (ares) *ares = 0;
+	return FALSE;
+    }
+    return os_fdread(fd, buf, len, ares);
+#endif
+}
+
+int
+os_fdpwrite(osfd_t fd,
+	    char *buf,
+	    size_t len, osdaddr_t addr, size_t *ares)
+{
+#if CENV_SYS_UNIX
+    register ssize_t res = pwrite(fd, buf, len, addr);
+    if (res < 0) {
+	if (ares) *ares = 0;
+	return FALSE;
+    }
+    if (ares) *ares = res;
+    return TRUE;
+#else
+    if (!os_fdseek(fd, addr)) {
+	if (ares) *ares = 0;
+	return FALSE;
+    }
+    return os_fdwrite(fd, buf, len, ares);
+#endif
+}
+
+/* Force data written to FD out to the disk itself, as far as the host
+**	allows, so it is known to be there before anything that depends
+**	on it is written.
+*/
+int
+os_fdsync(osfd_t fd)
+{
+#if CENV_SYS_UNIX
+# if defined(_POSIX_SYNCHRONIZED_IO) && (_POSIX_SYNCHRONIZED_IO > 0)
+    return fdatasync(fd) == 0;
+# else
+    return fsync(fd) == 0;
+# endif
+#else
+    return TRUE;
+#endif
+}
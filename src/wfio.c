@@ -431,14 +431,7 @@ wf_get(register struct wfile *wf, w10_t *wp)
 	cbuf[2] = ((i = getc(f)) == EOF) ? 0 : (i & 0377);
 	cbuf[3] = ((i = getc(f)) == EOF) ? 0 : (i & 0377);
 	cbuf[4] = ((i = getc(f)) == EOF) ? 0 : (i & 0377);
-	XWDPSET(wp,
-		(  ((uint18)cbuf[0] << 10)
-		 | (cbuf[1] << 2)
-		 | (cbuf[2] >> 6)),
-		(  ((uint18)(cbuf[2] & 077) << 12)
-		 | (cbuf[3] << 4)
-		 | (cbuf[4] & 017))	/* Low 4 bits of last byte */
-		);
+	WF_C36FR(cbuf, *wp);	/* Low 4 bits of last byte */
 	break;
 
     case WFT_A36:		/* Ansi-Ascii (7-bit) format */
@@ -578,11 +571,7 @@ wf_put(register struct wfile *wf,
 	break;
 
     case WFT_C36:		/* Core-dump (aka tape) format */
-	cbuf[0] = (LHGET(w)>>10)&0377;
-	cbuf[1] = (LHGET(w)>> 2)&0377;
-	cbuf[2] = (((LHGET(w)&03)<<6) | ((RHGET(w)>>12)&077));
-	cbuf[3] = (RHGET(w)>>4)&0377;
-	cbuf[4] = RHGET(w)&017;		/* Put last 4 bits in low end */
+	WF_C36TO(cbuf, w);	/* Put last 4 bits in low end */
 	n = 5;
 	break;
 
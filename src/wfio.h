@@ -35,6 +35,7 @@
 #include "cenv.h"
 #include <stdio.h>	/* Needed for FILE definition */
 #include <sys/types.h>	/* For off_t until it's in C99 header file */
+#include "word10.h"
 
 #define WF_TYPENAMDEFS \
     wtdef(WFT_U36, "u36"), /* Unixified (Alan Bawden) */\
@@ -89,4 +90,112 @@ extern int wf_put(WFILE *, w10_t);
 
 #define wf_typnam(wf) ((wf)->wftypnam)	/* Return name of WF type */
 
+/* Packing macros for the H36 and C36 byte layouts.
+**	These are shared with the virtual disk code (vdisk.c), whose DBD9
+**	format is byte-for-byte the same as H36.
+**
+**	WF_H36FR2(ucp, w0, w1)	- unpack 9 bytes at ucp into 2 words
+**	WF_H36TO2(ucp, w0, w1)	- pack 2 words into 9 bytes at ucp
+**	WF_C36FR(ucp, w)	- unpack 5 bytes at ucp into 1 word
+**	WF_C36TO(ucp, w)	- pack 1 word into 5 bytes at ucp
+**
+**	When the word model is a plain integer of at least 64 bits, a word
+**	pair is assembled in one 64-bit register; compilers turn the byte
+**	shifts into a single load or store plus byte swap.  Otherwise the
+**	words are built from 18-bit halves.
+*/
+#ifndef WF_CVT64
+# if WORD10_USEINT && defined(WORD10_INT64)
+#  define WF_CVT64 1
+# else
+#  define WF_CVT64 0
+# endif
+#endif
+
+#if WF_CVT64
+
+# define WF_BE64GET(ucp) \
+	(  ((uint64)(ucp)[0] << 56) | ((uint64)(ucp)[1] << 48) \
+	 | ((uint64)(ucp)[2] << 40) | ((uint64)(ucp)[3] << 32) \
+	 | ((uint64)(ucp)[4] << 24) | ((uint64)(ucp)[5] << 16) \
+	 | ((uint64)(ucp)[6] <<  8) |  (uint64)(ucp)[7] )
+# define WF_BE64SET(ucp, v) \
+	((ucp)[0] = (unsigned char)((v) >> 56), \
+	 (ucp)[1] = (unsigned char)((v) >> 48), \
+	 (ucp)[2] = (unsigned char)((v) >> 40), \
+	 (ucp)[3] = (unsigned char)((v) >> 32), \
+	 (ucp)[4] = (unsigned char)((v) >> 24), \
+	 (ucp)[5] = (unsigned char)((v) >> 16), \
+	 (ucp)[6] = (unsigned char)((v) >>  8), \
+	 (ucp)[7] = (unsigned char) (v))
+# define WF_LE64GET(ucp) \
+	(  ((uint64)(ucp)[7] << 56) | ((uint64)(ucp)[6] << 48) \
+	 | ((uint64)(ucp)[5] << 40) | ((uint64)(ucp)[4] << 32) \
+	 | ((uint64)(ucp)[3] << 24) | ((uint64)(ucp)[2] << 16) \
+	 | ((uint64)(ucp)[1] <<  8) |  (uint64)(ucp)[0] )
+# define WF_LE64SET(ucp, v) \
+	((ucp)[7] = (unsigned char)((v) >> 56), \
+	 (ucp)[6] = (unsigned char)((v) >> 48), \
+	 (ucp)[5] = (unsigned char)((v) >> 40), \
+	 (ucp)[4] = (unsigned char)((v) >> 32), \
+	 (ucp)[3] = (unsigned char)((v) >> 24), \
+	 (ucp)[2] = (unsigned char)((v) >> 16), \
+	 (ucp)[1] = (unsigned char)((v) >>  8), \
+	 (ucp)[0] = (unsigned char) (v))
+
+# define WF_H36FR2(ucp, w0, w1) { register uint64 wf_v = WF_BE64GET(ucp); \
+	W10_U36SET(w0, wf_v >> 28); \
+	W10_U36SET(w1, ((wf_v & 01777777777) << 8) | (ucp)[8]); }
+# define WF_H36TO2(ucp, w0, w1) { register uint64 wf_v = W10_U36(w0); \
+	register uint64 wf_v1 = W10_U36(w1); \
+	(ucp)[8] = wf_v1 & 0377; \
+	wf_v = (wf_v << 28) | (wf_v1 >> 8); \
+	WF_BE64SET(ucp, wf_v); }
+
+# define WF_C36FR(ucp, w) \
+	W10_U36SET(w, (  ((w10uint_t)(ucp)[0] << 28) \
+		       | ((w10uint_t)(ucp)[1] << 20) \
+		       | ((w10uint_t)(ucp)[2] << 12) \
+		       | ((w10uint_t)(ucp)[3] <<  4) \
+		       | ((ucp)[4] & 017) ))
+# define WF_C36TO(ucp, w) \
+	((ucp)[0] = (W10_U36(w) >> 28) & 0377, \
+	 (ucp)[1] = (W10_U36(w) >> 20) & 0377, \
+	 (ucp)[2] = (W10_U36(w) >> 12) & 0377, \
+	 (ucp)[3] = (W10_U36(w) >>  4) & 0377, \
+	 (ucp)[4] =  W10_U36(w)        & 017)
+
+#else	/* !WF_CVT64 */
+
+# define WF_H36FR2(ucp, w0, w1) { \
+	LRHSET(w0, \
+	    ((((ucp)[0]&0377)<<10) | (((ucp)[1]&0377)<<2) | (((ucp)[2]>>6)&03)),\
+	    ((((ucp)[2]&077)<<12)  | (((ucp)[3]&0377)<<4) | (((ucp)[4]>>4)&017)));\
+	LRHSET(w1, \
+	    ((((ucp)[4]&017)<<14) | (((ucp)[5]&0377)<<6) | (((ucp)[6]>>2)&077)),\
+	    ((((ucp)[6]&03)<<16)  | (((ucp)[7]&0377)<<8) | ((ucp)[8]&0377))); }
+# define WF_H36TO2(ucp, w0, w1) { \
+	(ucp)[0] = (LHGET(w0) >> 10) & 0377; \
+	(ucp)[1] = (LHGET(w0) >>  2) & 0377; \
+	(ucp)[2] = ((LHGET(w0)&03)<<6) | ((RHGET(w0) >> 12) & 077); \
+	(ucp)[3] = (RHGET(w0) >>  4) & 0377; \
+	(ucp)[4] = ((RHGET(w0)&017)<<4) | ((LHGET(w1) >> 14) & 017); \
+	(ucp)[5] = (LHGET(w1) >>  6) & 0377; \
+	(ucp)[6] = ((LHGET(w1)&077)<<2) | ((RHGET(w1) >> 16) & 03); \
+	(ucp)[7] = (RHGET(w1) >>  8) & 0377; \
+	(ucp)[8] =  RHGET(w1)        & 0377; }
+
+# define WF_C36FR(ucp, w) \
+	LRHSET(w, \
+	    ((((ucp)[0]&0377)<<10) | (((ucp)[1]&0377)<<2) | (((ucp)[2]>>6)&03)),\
+	    ((((ucp)[2]&077)<<12)  | (((ucp)[3]&0377)<<4) | ((ucp)[4]&017)))
+# define WF_C36TO(ucp, w) \
+	((ucp)[0] = (LHGET(w) >> 10) & 0377, \
+	 (ucp)[1] = (LHGET(w) >>  2) & 0377, \
+	 (ucp)[2] = ((LHGET(w)&03)<<6) | ((RHGET(w) >> 12) & 077), \
+	 (ucp)[3] = (RHGET(w) >>  4) & 0377, \
+	 (ucp)[4] =  RHGET(w)        & 017)
+
+#endif	/* !WF_CVT64 */
+
 #endif /* ifndef WFIO_INCLUDED */
@@ -50,6 +50,7 @@ this for all possible variations.
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "rcsid.h"
 #include "word10.h"
@@ -65,14 +66,17 @@ this for all possible variations.
 
 int swprint = 1;
 int swverbose = 0;
+int swbench = 0;
 int nerrors = 0;
 
 /* Misc apparatus */
 
 char usage[] = "\
-Usage: %s -[qvh]\n\
+Usage: %s -[qvbh]\n\
     -q  Quiet\n\
     -v  Verbose\n\
+    -b  Benchmark word operations after testing.  To compare models,\n\
+	rebuild with e.g. -DWORD10_USEHWD=1 vs -DWORD10_USEINT=1\n\
     -h  Help (this stuff)\n";
 
 int dotests(void);
@@ -84,6 +88,7 @@ int test32(void);
 #ifdef WORD10_INT
 int test36(void);
 #endif
+void tbench(void);
 
 int
 main(int argc, char **argv)
@@ -98,6 +103,7 @@ main(int argc, char **argv)
 	for (cp = &argv[1][0]; *++cp; ) switch (*cp) {
 	    case 'q': swprint = 0; break;
 	    case 'v': swprint = swverbose = 1; break;
+	    case 'b': swbench = 1; break;
 	    case 'h': fprintf(stdout, usage, argv[0]);
 		    exit(0);
 	    default:
@@ -107,6 +113,8 @@ main(int argc, char **argv)
     }
 
     dotests();
+    if (swbench)
+	tbench();
     return nerrors;
 } 
 
@@ -846,6 +854,94 @@ testfmt(void)
 
 #undef B0
 
+
+/* Benchmark basic word operations.
+**	Times a few of the word10.h facilities most heavily used by the
+**	emulator, so that the cost of each representation model on a
+**	given host can be compared by rebuilding with a different model.
+**	Only integer arithmetic is used for the reports.
+*/
+
+#define BNWDS	4096		/* Words in benchmark array */
+#define BNPASS	32768		/* Passes over array per test */
+
+static w10_t bwds[BNWDS];
+volatile UINTMAX bsink;		/* Keeps results from being optimized out */
+
+static void
+bnreport(char *name, clock_t ticks)
+{
+    UINTMAX usec, psop;
+    UINTMAX nops = (UINTMAX)BNWDS * BNPASS;
+
+    usec = ((UINTMAX)ticks * 1000000) / CLOCKS_PER_SEC;
+    psop = (usec * 1000000) / nops;	/* Picoseconds per op */
+    printf("  %-22s %6ld ms  %4ld.%03ld ns/op\n", name,
+	   (long)(usec / 1000), (long)(psop / 1000), (long)(psop % 1000));
+}
+
+void
+tbench(void)
+{
+    register int i, j;
+    register UINTMAX sum;
+    clock_t t;
+
+    printf("Benchmark of word10 model %s (%ld ops per test):\n",
+	   WORD10_MODEL, (long)BNWDS * BNPASS);
+    for (i = 0; i < BNWDS; ++i)
+	LRHSET(bwds[i], (i * 0123457) & H10MASK, (i * 0765431) & H10MASK);
+
+    /* Halfword fetch */
+    sum = 0;
+    t = clock();
+    for (j = BNPASS; --j >= 0;)
+	for (i = 0; i < BNWDS; ++i)
+	    sum += LHGET(bwds[i]) + RHGET(bwds[i]);
+    bnreport("LHGET+RHGET", clock() - t);
+    bsink = sum;
+
+    /* Halfword swap, as for MOVS */
+    t = clock();
+    for (j = BNPASS; --j >= 0;)
+	for (i = 0; i < BNWDS; ++i) {
+	    register h10_t lh = LHGET(bwds[i]);
+	    LRHSET(bwds[i], RHGET(bwds[i]), lh);
+	}
+    bnreport("LRHSET swap", clock() - t);
+
+    /* Right half increment, as for AOBJN index updates */
+    t = clock();
+    for (j = BNPASS; --j >= 0;)
+	for (i = 0; i < BNWDS; ++i)
+	    RHSET(bwds[i], (RHGET(bwds[i]) + 1) & H10MASK);
+    bnreport("RHSET increment", clock() - t);
+
+    /* 32-bit conversions */
+    sum = 0;
+    t = clock();
+    for (j = BNPASS; --j >= 0;)
+	for (i = 0; i < BNWDS; ++i) {
+	    sum += W10_U32(bwds[i]);
+	    W10_U32SET(bwds[i], (uint32)sum);
+	}
+    bnreport("W10_U32 get/set", clock() - t);
+    bsink = sum;
+
+#ifdef WORD10_INT
+    /* 36-bit conversions, as for fullword arithmetic */
+    sum = 0;
+    t = clock();
+    for (j = BNPASS; --j >= 0;)
+	for (i = 0; i < BNWDS; ++i) {
+	    sum += W10_U36(bwds[i]);
+	    W10_U36SET(bwds[i], (sum + i) & MASK36);
+	}
+    bnreport("W10_U36 get/set", clock() - t);
+    bsink = sum;
+#endif
+}
+
 
 #if 0 /* Stuff noted for possible future testing */
 